@@ -0,0 +1,443 @@
+/**
+ * @file bench_e2e.cc
+ *
+ * End to end throughput regression harness: runs clang_ast2dot over a
+ * corpus, checks the dot output against golden files and the metrics
+ * against a baseline file.
+ */
+
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/program_options.hpp>
+
+namespace po = boost::program_options;
+
+namespace clang_ast2dot
+{
+    namespace bench
+    {
+        /*
+         * Metrics of a conversion
+         */
+        struct Metrics
+        {
+            // Input throughput (MB/s) and vertices/s
+            double mbps;
+            double nodes_per_s;
+            // Peak RSS (KB)
+            long peak_rss;
+            // Output size and hash
+            unsigned long long output_bytes;
+            unsigned long long output_hash;
+        };
+
+        typedef std::map<std::string, Metrics> Baseline;
+
+        /*
+         * Run a command, stdout and stderr to /dev/null, returning its exit
+         * status and setting its wall time (s) and peak RSS (KB)
+         */
+        static int
+        run(std::vector<std::string> const& args, double& seconds, long& peak_rss)
+        {
+            std::vector<char*> argv;
+            for (size_t a = 0; a < args.size(); a++)
+                argv.push_back(const_cast<char*>(args[a].c_str()));
+            argv.push_back((char*) NULL);
+
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            pid_t pid = fork();
+
+            if (pid < 0)
+                return -1;
+            if (pid == 0)
+                {
+                    int null_fd = open("/dev/null", O_WRONLY);
+                    dup2(null_fd, STDOUT_FILENO);
+                    dup2(null_fd, STDERR_FILENO);
+                    execv(argv[0], &argv[0]);
+                    _exit(127);
+                }
+
+            int status = 0;
+            struct rusage usage;
+            if (wait4(pid, &status, 0, &usage) < 0)
+                return -1;
+
+            seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            peak_rss = usage.ru_maxrss;
+
+            return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+        }
+
+        /*
+         * Read a whole file (false if it can not be read)
+         */
+        static bool
+        read_file(std::string const& path, std::string& data)
+        {
+            std::ifstream ifs(path.c_str(), std::ios::in | std::ios::binary);
+            std::stringstream ss;
+
+            if (!ifs.is_open())
+                return false;
+            ss << ifs.rdbuf();
+            data = ss.str();
+
+            return true;
+        }
+
+        /*
+         * Size, FNV-1a hash and number of lines of a file
+         */
+        static bool
+        scan_file(std::string const& path, unsigned long long& bytes, unsigned long long& hash, unsigned long long& lines)
+        {
+            FILE* f = fopen(path.c_str(), "rb");
+            std::vector<char> buf(1 << 20);
+            size_t n;
+
+            if (!f)
+                return false;
+
+            bytes = 0;
+            lines = 0;
+            hash = 14695981039346656037ULL;
+            while ((n = fread(&buf[0], 1, buf.size(), f)) > 0)
+                {
+                    for (size_t i = 0; i < n; i++)
+                        {
+                            hash = (hash ^ (unsigned char) buf[i]) * 1099511628211ULL;
+                            lines += buf[i] == '\n';
+                        }
+                    bytes += n;
+                }
+            fclose(f);
+
+            return true;
+        }
+
+        /*
+         * Base name of a path
+         */
+        static std::string
+        base_name(std::string const& path)
+        {
+            size_t slash = path.rfind('/');
+
+            return slash == std::string::npos ? path : path.substr(slash + 1);
+        }
+
+        /*
+         * Line of the first difference between two texts
+         */
+        static size_t
+        first_diff_line(std::string const& a, std::string const& b)
+        {
+            size_t line = 1;
+
+            for (size_t i = 0; i < a.size() && i < b.size() && a[i] == b[i]; i++)
+                line += a[i] == '\n';
+
+            return line;
+        }
+
+        /*
+         * Baseline file: one line per input,
+         *   name MB/s vertices/s peak-RSS-KB output-bytes output-hash
+         */
+        static void
+        load_baseline(std::string const& path, Baseline& baseline)
+        {
+            std::ifstream ifs(path.c_str());
+            std::string line;
+
+            while (std::getline(ifs, line))
+                {
+                    std::istringstream ls(line);
+                    std::string name;
+                    Metrics m;
+
+                    if (line.empty() || line[0] == '#')
+                        continue;
+                    if (ls >> name >> m.mbps >> m.nodes_per_s >> m.peak_rss >> m.output_bytes >> std::hex >> m.output_hash)
+                        baseline[name] = m;
+                }
+        }
+
+        static bool
+        save_baseline(std::string const& path, Baseline const& baseline)
+        {
+            std::ofstream ofs(path.c_str());
+
+            if (!ofs.is_open())
+                return false;
+
+            ofs << "# name MB/s vertices/s peak-RSS-KB output-bytes output-hash\n";
+            for (Baseline::const_iterator it = baseline.begin(); it != baseline.end(); ++it)
+                ofs << it->first << " "
+                    << std::fixed << std::setprecision(2) << it->second.mbps << " "
+                    << std::setprecision(0) << it->second.nodes_per_s << " "
+                    << it->second.peak_rss << " "
+                    << it->second.output_bytes << " "
+                    << std::hex << it->second.output_hash << std::dec << "\n";
+
+            return ofs.good();
+        }
+    }
+}
+
+using namespace clang_ast2dot::bench;
+
+int
+main(int argc, char **argv)
+{
+    po::options_description desc("bench_e2e options");
+    po::positional_options_description pos;
+    po::variables_map vm;
+
+    desc.add_options()
+        ("help,h", "Help message")
+        ("binary", po::value<std::string>()->required(), "clang_ast2dot binary")
+        ("arg", po::value<std::vector<std::string> >()->default_value(std::vector<std::string>(), ""), "Extra argument of clang_ast2dot (repeatable)")
+        ("baseline", po::value<std::string>()->required(), "Baseline file")
+        ("golden", po::value<std::string>(), "Directory of the golden dot files of the corpus files")
+        ("work", po::value<std::string>()->default_value("."), "Directory of the outputs and generated dumps")
+        ("gen", po::value<std::string>(), "gen_ast_dump binary, to add generated dumps to the corpus")
+        ("gen-nodes", po::value<unsigned long>()->default_value(1000000), "Vertices of the generated dumps")
+        ("threshold", po::value<double>()->default_value(0.25), "Max regression of a metric (fraction of the baseline)")
+        ("min-bytes", po::value<unsigned long>()->default_value(1 << 20), "Min input size for throughput checks")
+        ("runs", po::value<unsigned>()->default_value(3), "Runs per input, the best one being kept")
+        ("update", "Write the baseline and golden files instead of checking them")
+        ("input", po::value<std::vector<std::string> >()->default_value(std::vector<std::string>(), ""), "Corpus files");
+    pos.add("input", -1);
+
+    try
+        {
+            po::store(po::command_line_parser(argc, argv).options(desc).positional(pos).run(), vm);
+            if (vm.count("help"))
+                {
+                    std::cout << desc;
+                    return 0;
+                }
+            po::notify(vm);
+        }
+    catch (po::error const& e)
+        {
+            std::cerr << "bench_e2e: " << e.what() << "\n" << desc;
+            return 2;
+        }
+
+    std::string work = vm["work"].as<std::string>();
+    double threshold = vm["threshold"].as<double>();
+    bool update = vm.count("update");
+    // Corpus: name, path and golden file
+    std::vector<std::string> names, inputs, goldens;
+    // Generated dumps to remove
+    std::vector<std::string> generated;
+    Baseline baseline, results;
+    int failures = 0;
+
+    std::vector<std::string> const& files = vm["input"].as<std::vector<std::string> >();
+    for (size_t f = 0; f < files.size(); f++)
+        {
+            names.push_back(base_name(files[f]));
+            inputs.push_back(files[f]);
+            goldens.push_back(vm.count("golden") ? vm["golden"].as<std::string>() + "/" + names.back() + ".dot" : "");
+        }
+
+    // Generated dumps: usual shape and long template types
+    if (vm.count("gen"))
+        {
+            unsigned long nodes = vm["gen-nodes"].as<unsigned long>();
+            const char* shapes[][2] = {
+                { "gen_default", "" },
+                { "gen_templates", "--template-rate=0.5" },
+            };
+
+            for (size_t g = 0; g < sizeof(shapes) / sizeof(shapes[0]); g++)
+                {
+                    std::string path = work + "/" + shapes[g][0] + ".ast";
+                    std::vector<std::string> args;
+                    double seconds;
+                    long rss;
+
+                    args.push_back(vm["gen"].as<std::string>());
+                    args.push_back("--seed=1");
+                    args.push_back("--nodes=" + std::to_string(g ? nodes / 5 : nodes));
+                    args.push_back("--output=" + path);
+                    if (*shapes[g][1])
+                        args.push_back(shapes[g][1]);
+
+                    if (run(args, seconds, rss) != 0)
+                        {
+                            std::cerr << "bench_e2e: failed to generate " << path << "\n";
+                            return 2;
+                        }
+                    names.push_back(shapes[g][0]);
+                    inputs.push_back(path);
+                    goldens.push_back("");
+                    generated.push_back(path);
+                }
+        }
+
+    load_baseline(vm["baseline"].as<std::string>(), baseline);
+
+    std::cout << std::left << std::setw(36) << "# input"
+              << std::right << std::setw(10) << "MB/s"
+              << std::setw(14) << "vertices/s"
+              << std::setw(12) << "RSS KB"
+              << std::setw(14) << "out bytes" << "\n";
+
+    for (size_t i = 0; i < inputs.size(); i++)
+        {
+            std::string output = work + "/" + names[i] + ".dot";
+            unsigned long long in_bytes, in_hash, in_lines;
+            unsigned long long out_lines;
+            Metrics m;
+            double best = 0;
+
+            if (!scan_file(inputs[i], in_bytes, in_hash, in_lines))
+                {
+                    std::cerr << "bench_e2e: can not read " << inputs[i] << "\n";
+                    failures++;
+                    continue;
+                }
+
+            m.peak_rss = 0;
+            for (unsigned r = 0; r < vm["runs"].as<unsigned>(); r++)
+                {
+                    std::vector<std::string> args;
+                    double seconds;
+                    long rss;
+
+                    args.push_back(vm["binary"].as<std::string>());
+                    args.push_back("-i");
+                    args.push_back(inputs[i]);
+                    args.push_back("-o");
+                    args.push_back(output);
+                    args.insert(args.end(), vm["arg"].as<std::vector<std::string> >().begin(),
+                                vm["arg"].as<std::vector<std::string> >().end());
+
+                    if (run(args, seconds, rss) != 0)
+                        {
+                            std::cerr << "bench_e2e: " << names[i] << ": conversion failed\n";
+                            failures++;
+                            best = 0;
+                            break;
+                        }
+                    if (r == 0 || seconds < best)
+                        best = seconds;
+                    if (rss > m.peak_rss)
+                        m.peak_rss = rss;
+                }
+            if (best <= 0)
+                continue;
+
+            // One vertex per dump line
+            m.mbps = in_bytes / best / 1e6;
+            m.nodes_per_s = in_lines / best;
+            scan_file(output, m.output_bytes, m.output_hash, out_lines);
+            results[names[i]] = m;
+
+            std::cout << std::left << std::setw(36) << names[i]
+                      << std::right << std::fixed << std::setprecision(2)
+                      << std::setw(10) << m.mbps
+                      << std::setprecision(0) << std::setw(14) << m.nodes_per_s
+                      << std::setw(12) << m.peak_rss
+                      << std::setw(14) << m.output_bytes << "\n";
+
+            // Golden dot file
+            if (!goldens[i].empty())
+                {
+                    std::string got, expected;
+
+                    read_file(output, got);
+                    if (update)
+                        {
+                            std::ofstream ofs(goldens[i].c_str(), std::ios::out | std::ios::binary);
+                            ofs << got;
+                        }
+                    else if (!read_file(goldens[i], expected))
+                        {
+                            std::cerr << "FAIL " << names[i] << ": no golden file " << goldens[i] << "\n";
+                            failures++;
+                        }
+                    else if (got != expected)
+                        {
+                            std::cerr << "FAIL " << names[i] << ": output differs from " << goldens[i]
+                                      << " at line " << first_diff_line(got, expected) << "\n";
+                            failures++;
+                        }
+                }
+            unlink(output.c_str());
+
+            if (update)
+                continue;
+
+            // Baseline metrics
+            Baseline::const_iterator b = baseline.find(names[i]);
+            if (b == baseline.end())
+                {
+                    std::cerr << "FAIL " << names[i] << ": not in baseline\n";
+                    failures++;
+                    continue;
+                }
+            if (m.output_bytes != b->second.output_bytes || m.output_hash != b->second.output_hash)
+                {
+                    std::cerr << "FAIL " << names[i] << ": output size/hash " << m.output_bytes
+                              << " differs from baseline " << b->second.output_bytes << "\n";
+                    failures++;
+                }
+            if (m.peak_rss > b->second.peak_rss * (1 + threshold) + 1024)
+                {
+                    std::cerr << "FAIL " << names[i] << ": peak RSS " << m.peak_rss
+                              << " KB, baseline " << b->second.peak_rss << " KB\n";
+                    failures++;
+                }
+            if (in_bytes >= vm["min-bytes"].as<unsigned long>())
+                {
+                    if (m.mbps < b->second.mbps * (1 - threshold))
+                        {
+                            std::cerr << "FAIL " << names[i] << ": " << m.mbps
+                                      << " MB/s, baseline " << b->second.mbps << " MB/s\n";
+                            failures++;
+                        }
+                    if (m.nodes_per_s < b->second.nodes_per_s * (1 - threshold))
+                        {
+                            std::cerr << "FAIL " << names[i] << ": " << m.nodes_per_s
+                                      << " vertices/s, baseline " << b->second.nodes_per_s << " vertices/s\n";
+                            failures++;
+                        }
+                }
+        }
+
+    for (size_t g = 0; g < generated.size(); g++)
+        unlink(generated[g].c_str());
+
+    if (update && !save_baseline(vm["baseline"].as<std::string>(), results))
+        {
+            std::cerr << "bench_e2e: failed to write baseline\n";
+            return 2;
+        }
+
+    if (failures)
+        std::cerr << failures << " regression(s)\n";
+
+    return failures ? 1 : 0;
+}
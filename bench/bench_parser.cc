@@ -0,0 +1,377 @@
+/**
+ * @file bench_parser.cc
+ *
+ * Benchmarks of the parser hot functions
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "clang_ast_parser.h"
+#include "clang_ast_input.h"
+#include "clang_ast_escape.h"
+
+// Number of heap allocations so far
+static size_t bench_allocs = 0;
+
+/*
+ * Count heap allocations (new[] goes through new)
+ */
+void*
+operator new(size_t size)
+{
+    void* p = malloc(size ? size : 1);
+
+    if (!p)
+        throw std::bad_alloc();
+    bench_allocs++;
+    return p;
+}
+
+void
+operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+namespace clang_ast2dot
+{
+    namespace bench
+    {
+        typedef std::chrono::steady_clock Clock;
+
+        /*
+         * Line mix: dump lines of one shape
+         */
+        struct Mix
+        {
+            std::string name;
+            // Whole lines (relationship string and vertex)
+            std::string dump;
+            // Vertex part of the lines only
+            std::string vertices;
+            std::vector<std::string> lines;
+        };
+
+        /*
+         * Measure: elapsed time and allocations since start
+         */
+        struct Measure
+        {
+            Clock::time_point start;
+            size_t allocs;
+
+            Measure() : start(Clock::now()), allocs(bench_allocs) {}
+
+            double ns(void) const
+            {
+                return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+            }
+        };
+
+        /*
+         * Print the header of the result lines
+         */
+        static void
+        header(std::string const& title)
+        {
+            std::cout << "# " << title << "\n"
+                      << std::left << std::setw(28) << "# function"
+                      << std::setw(10) << "mix"
+                      << std::right << std::setw(12) << "ns/line"
+                      << std::setw(12) << "MB/s"
+                      << std::setw(14) << "allocs/line" << "\n";
+        }
+
+        /*
+         * Print one result line: time and allocations per op, and
+         * throughput if bytes were processed
+         */
+        static void
+        report(std::string const& name, std::string const& mix, size_t ops, size_t bytes, Measure const& m)
+        {
+            double ns = m.ns();
+            size_t allocs = bench_allocs - m.allocs;
+
+            std::cout << std::left << std::setw(28) << name
+                      << std::setw(10) << mix
+                      << std::right << std::fixed
+                      << std::setw(12) << std::setprecision(1) << ns / ops
+                      << std::setw(12) << std::setprecision(1) << (bytes ? bytes * 1e3 / ns : 0.0)
+                      << std::setw(14) << std::setprecision(3) << (double) allocs / ops
+                      << "\n";
+        }
+
+        /*
+         * Relationship string of a line at depth level
+         */
+        static std::string
+        prefix(int level, bool last)
+        {
+            std::string scstr;
+
+            for (int l = 1; l < level; l++)
+                scstr.append(l % 3 ? "| " : "  ");
+            if (level > 0)
+                scstr.append(last ? "`-" : "|-");
+
+            return scstr;
+        }
+
+        /*
+         * Long template type, as in STL instantiations
+         */
+        static std::string
+        template_type(int depth)
+        {
+            std::string type = "int";
+
+            for (int d = 0; d < depth; d++)
+                type = std::string(d % 2 ? "std::vector<" : "std::map<std::basic_string<char, std::char_traits<char>, std::allocator<char> >, ")
+                    .append(type)
+                    .append(d % 2 ? ", std::allocator<" + type + " > >" : ", std::less<std::basic_string<char> > >");
+
+            return type;
+        }
+
+        /*
+         * Build the line mixes: short Stmt lines, very long template type
+         * lines and deep relationship strings
+         */
+        static void
+        build_mixes(size_t lines, std::vector<Mix>& mixes)
+        {
+            const char* stmts[] = {
+                "ImplicitCastExpr 0x55d0c8a1b2c8 <col:10> 'int' <LValueToRValue>",
+                "DeclRefExpr 0x55d0c8a1b2a0 <col:10> 'int' lvalue Var 0x55d0c8a1b0f8 'i' 'int'",
+                "IntegerLiteral 0x55d0c8a1b2e8 <col:14> 'int' 1",
+                "CompoundStmt 0x55d0c8a1b4a0 <line:3:1, line:7:1>",
+                "<<<NULL>>>",
+                "BinaryOperator 0x55d0c8a1b308 <col:10, col:14> 'int' '+'",
+            };
+            const size_t nstmts = sizeof(stmts) / sizeof(stmts[0]);
+            std::string type = template_type(4);
+
+            mixes.resize(3);
+            mixes[0].name = "stmt";
+            mixes[1].name = "template";
+            mixes[2].name = "deep";
+
+            for (size_t i = 0; i < lines; i++)
+                {
+                    // Short lines at usual depths
+                    mixes[0].lines.push_back(prefix(3 + i % 5, i % 4 == 0) + stmts[i % nstmts]);
+
+                    // Long lines
+                    mixes[1].lines.push_back(prefix(2, i % 4 == 0) +
+                                             "CXXMethodDecl 0x55d0c8a1c000 <<invalid sloc>> <line:12:5, col:40> col:10 used find '" +
+                                             type + " (const " + type + " &) const' inline");
+
+                    // Deep lines
+                    mixes[2].lines.push_back(prefix(40 + i % 40, i % 4 == 0) + stmts[i % nstmts]);
+                }
+
+            for (size_t m = 0; m < mixes.size(); m++)
+                for (size_t i = 0; i < mixes[m].lines.size(); i++)
+                    {
+                        std::string const& line = mixes[m].lines[i];
+                        size_t start = line.find_first_not_of("|` -");
+
+                        mixes[m].dump.append(line).append("\n");
+                        mixes[m].vertices.append(line, start, std::string::npos).append("\n");
+                        mixes[m].lines[i].erase(0, start);
+                    }
+        }
+
+        /*
+         * Parser functions over the line mixes
+         */
+        static void
+        bench_lines(size_t lines)
+        {
+            std::vector<Mix> mixes;
+            // Keep results alive
+            size_t sink = 0;
+
+            build_mixes(lines, mixes);
+            header("parser hot functions (line mixes: short Stmt, long template types, deep relationship strings)");
+
+            for (size_t m = 0; m < mixes.size(); m++)
+                {
+                    Mix const& mix = mixes[m];
+                    parser::Ast2DotParser p;
+                    std::string buf;
+
+                    // Relationship string, the rest of each line being skipped
+                    {
+                        parser::Ast2DotMemoryInput in(mix.dump.data(), mix.dump.size());
+                        boost::string_view rest;
+                        Measure t;
+
+                        for (size_t i = 0; i < lines; i++)
+                            {
+                                sink += p.read_sibling_child_string(&in).size();
+                                in.getline(rest);
+                            }
+                        report("read_sibling_child_string", mix.name, lines, mix.dump.size(), t);
+                    }
+
+                    // Special quotes of the vertex part
+                    {
+                        Measure t;
+
+                        for (size_t i = 0; i < lines; i++)
+                            {
+                                std::string* quoted = (std::string*) NULL;
+
+                                buf.assign(mix.lines[i]);
+                                sink += p.quote_special_quotes(buf, "<<", ">>", quoted).size();
+                                delete quoted;
+                            }
+                        report("quote_special_quotes", mix.name, lines, mix.vertices.size(), t);
+                    }
+
+                    // Dot escaping, in place and appended
+                    {
+                        Measure t;
+
+                        for (size_t i = 0; i < lines; i++)
+                            {
+                                buf.assign(mix.lines[i]);
+                                sink += parser::escape_dot_string(buf).size();
+                            }
+                        report("escape_dot_string", mix.name, lines, mix.vertices.size(), t);
+                    }
+                    {
+                        Measure t;
+
+                        for (size_t i = 0; i < lines; i++)
+                            {
+                                buf.clear();
+                                parser::escape_dot_string_append(mix.lines[i], buf);
+                                sink += buf.size();
+                            }
+                        report("escape_dot_string_append", mix.name, lines, mix.vertices.size(), t);
+                    }
+
+                    // Vertex props, as a new string and as a view
+                    {
+                        parser::Ast2DotMemoryInput in(mix.vertices.data(), mix.vertices.size());
+                        Measure t;
+
+                        for (size_t i = 0; i < lines; i++)
+                            {
+                                std::string* props = p.read_vertex_props(&in, &std::cout);
+
+                                sink += props->size();
+                                delete props;
+                            }
+                        report("read_vertex_props", mix.name, lines, mix.vertices.size(), t);
+                    }
+                    {
+                        parser::Ast2DotMemoryInput in(mix.vertices.data(), mix.vertices.size());
+                        Measure t;
+
+                        for (size_t i = 0; i < lines; i++)
+                            sink += p.read_vertex(&in).size();
+                        report("read_vertex", mix.name, lines, mix.vertices.size(), t);
+                    }
+                }
+
+            if (sink == 0)
+                std::cerr << "no result\n";
+        }
+
+        /*
+         * Null and public vertex naming: per node cost once count
+         * vertices were already numbered. It shall stay flat as count grows.
+         */
+        static void
+        bench_naming(size_t max_count, size_t ops)
+        {
+            header("null/public naming (mix = vertices already numbered)");
+
+            for (size_t count = 1000; count <= max_count; count *= 10)
+                {
+                    parser::Ast2DotParser p;
+                    std::string mix = std::to_string(count);
+
+                    // Number count vertices
+                    for (size_t i = 0; i < count; i++)
+                        {
+                            p.null_to_name(-1);
+                            p.public_to_name(-1);
+                        }
+
+                    // Names of the last numbered vertices
+                    std::string null_name = p.null_to_name(count - 1);
+                    std::string public_name = p.public_to_name(count - 1);
+                    // Keep results alive
+                    size_t sink = 0;
+
+                    {
+                        Measure t;
+                        for (size_t i = 0; i < ops; i++)
+                            sink += p.null_to_label(null_name).size();
+                        report("null_to_label", mix, ops, 0, t);
+                    }
+                    {
+                        Measure t;
+                        for (size_t i = 0; i < ops; i++)
+                            sink += p.public_to_label(public_name).size();
+                        report("public_to_label", mix, ops, 0, t);
+                    }
+                    {
+                        Measure t;
+                        for (size_t i = 0; i < ops; i++)
+                            sink += p.public_to_index(public_name).size();
+                        report("public_to_index", mix, ops, 0, t);
+                    }
+                    {
+                        Measure t;
+                        for (size_t i = 0; i < ops; i++)
+                            sink += p.null_to_name(-1).size();
+                        report("null_to_name", mix, ops, 0, t);
+                    }
+
+                    // <<<NULL>>> and public lines through the parser
+                    std::string lines;
+                    for (size_t i = 0; i < ops / 2; i++)
+                        lines.append("<<<NULL>>>\npublic 'struct A'\n");
+                    parser::Ast2DotMemoryInput in(lines.data(), lines.size());
+
+                    {
+                        Measure t;
+                        while (!p.read_vertex(&in).empty())
+                            sink++;
+                        report("read_vertex NULL/public", mix, ops, lines.size(), t);
+                    }
+
+                    if (sink == 0)
+                        std::cerr << "no result\n";
+                }
+        }
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+    // Max number of vertices already numbered
+    size_t max_count = argc > 1 ? strtoul(argv[1], NULL, 10) : 10000000;
+    // Operations per measure
+    size_t ops = argc > 2 ? strtoul(argv[2], NULL, 10) : 1000000;
+    // Lines per mix
+    size_t lines = argc > 3 ? strtoul(argv[3], NULL, 10) : 100000;
+
+    clang_ast2dot::bench::bench_lines(lines);
+    clang_ast2dot::bench::bench_naming(max_count, ops);
+
+    return 0;
+}
@@ -0,0 +1,446 @@
+/**
+ * @file gen_ast_dump.cc
+ *
+ * Generator of synthetic clang -ast-dump text, for scale testing
+ */
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <boost/program_options.hpp>
+
+#include "clang_ast_output.h"
+
+namespace po = boost::program_options;
+
+namespace clang_ast2dot
+{
+    namespace bench
+    {
+        /*
+         * Shape of the generated dump
+         */
+        struct GenOptions
+        {
+            // Number of vertices
+            unsigned long long nodes;
+            // Max children of a vertex
+            unsigned fanout;
+            // Max depth of a vertex (root is 0)
+            unsigned depth;
+            // Rate of <<<NULL>>> children
+            double null_rate;
+            // Rate of public base specifiers among record children
+            double public_rate;
+            // Rate of long template types
+            double template_rate;
+            // Nesting of the template types
+            unsigned template_depth;
+            // Random seed
+            unsigned long seed;
+        };
+
+        /*
+         * Vertex kinds
+         */
+        enum GenKind
+            {
+                RECORD,                 // CXXRecordDecl, may have public children
+                DECL,                   // other declarations with children
+                STMT,                   // statements and expressions with children
+                LEAF,                   // vertices without children
+                NULL_VERTEX,
+                PUBLIC
+            };
+
+        /*
+         * Dump generator: vertices are written in preorder as they are
+         * drawn, with a stack of the children left to each open vertex,
+         * so memory does not depend on the dump size.
+         */
+        class Ast2DotGenerator
+        {
+          public:
+
+            Ast2DotGenerator(GenOptions const& opts, parser::Ast2DotOutput* out)
+                : _opts(opts), _out(out), _rand(opts.seed), _address(0x55d0c8a00000ULL), _line(1)
+            {
+                // A few long template types, drawn once
+                for (int t = 0; t < 16; t++)
+                    _templates.push_back(template_type(opts.template_depth));
+            }
+
+            /*
+             * Write the whole dump (returns the number of vertices)
+             */
+            unsigned long long generate(void)
+            {
+                // Vertices left, one being kept for the last top level one
+                unsigned long long budget = _opts.nodes > 2 ? _opts.nodes - 2 : 0;
+                unsigned long long count = 1;
+
+                _out->write("TranslationUnitDecl ");
+                write_address();
+                _out->write(" <<invalid sloc>> <invalid sloc>\n");
+                if (_opts.nodes < 2)
+                    return count;
+
+                // Top level declarations
+                while (budget > 0)
+                    {
+                        budget--;
+                        count += subtree(budget);
+                    }
+
+                // Last one
+                _out->write("`-");
+                write_vertex(LEAF);
+                count++;
+
+                return count;
+            }
+
+          private:
+
+            /*
+             * Random number in [0, n)
+             */
+            unsigned draw(unsigned n) { return n ? _rand() % n : 0; }
+
+            /*
+             * Random event of rate r
+             */
+            bool event(double r) { return r > 0 && (_rand() >> 11) * (1.0 / 9007199254740992.0) < r; }
+
+            /*
+             * Number of children of a vertex at depth, taken in the budget:
+             * half of the vertices are leaves, others have 1 to fanout
+             * children, so that subtrees stay of moderate size
+             */
+            unsigned children(unsigned depth, unsigned long long& budget)
+            {
+                unsigned c = depth < _opts.depth && draw(2) ? 1 + draw(_opts.fanout) : 0;
+
+                if (c > budget)
+                    c = budget;
+                budget -= c;
+
+                return c;
+            }
+
+            /*
+             * Write a top level declaration and its descendants
+             * (returns the number of vertices)
+             */
+            unsigned long long subtree(unsigned long long& budget)
+            {
+                // Children left and kind of the open vertices
+                std::vector<unsigned> left;
+                std::vector<GenKind> kinds;
+                // Relationship string of the children of the last open vertex
+                std::string prefix;
+                unsigned long long count = 1;
+                unsigned c = children(1, budget);
+                GenKind kind = c == 0 ? LEAF : (draw(3) == 0 ? RECORD : DECL);
+
+                _out->write("|-");
+                write_vertex(kind);
+                if (c == 0)
+                    return count;
+
+                left.push_back(c);
+                kinds.push_back(kind);
+                prefix.assign("| ");
+
+                while (!left.empty())
+                    {
+                        if (left.back() == 0)
+                            {
+                                left.pop_back();
+                                kinds.pop_back();
+                                prefix.resize(prefix.size() - 2);
+                                continue;
+                            }
+
+                        bool last = --left.back() == 0;
+                        unsigned depth = left.size() + 1;
+
+                        // NULL and public children are leaves
+                        if (kinds.back() == RECORD && event(_opts.public_rate))
+                            kind = PUBLIC;
+                        else if (kinds.back() == STMT && event(_opts.null_rate))
+                            kind = NULL_VERTEX;
+                        else
+                            kind = LEAF;
+
+                        c = kind == LEAF ? children(depth, budget) : 0;
+                        if (c > 0)
+                            kind = depth < 3 && draw(4) == 0 ? (draw(2) ? RECORD : DECL) : STMT;
+
+                        _out->write(prefix);
+                        _out->write(last ? "`-" : "|-");
+                        write_vertex(kind);
+                        count++;
+
+                        if (c > 0)
+                            {
+                                left.push_back(c);
+                                kinds.push_back(kind);
+                                prefix.append(last ? "  " : "| ");
+                            }
+                    }
+
+                return count;
+            }
+
+            /*
+             * Write a vertex line (after its relationship string)
+             */
+            void write_vertex(GenKind kind)
+            {
+                switch (kind)
+                    {
+                    case NULL_VERTEX:
+                        _out->write("<<<NULL>>>\n");
+                        return;
+
+                    case PUBLIC:
+                        _out->write("public 'class Base_");
+                        _out->write((unsigned long long) draw(1000));
+                        _out->write("<");
+                        write_type();
+                        _out->write(">'\n");
+                        return;
+
+                    case RECORD:
+                        _out->write("CXXRecordDecl ");
+                        write_address();
+                        write_sloc();
+                        _out->write(" col:7 referenced class Class_");
+                        _out->write((unsigned long long) draw(100000));
+                        _out->write(" definition\n");
+                        return;
+
+                    case DECL:
+                        {
+                            static const char* decls[] = { "FunctionDecl", "CXXMethodDecl", "VarDecl", "FieldDecl" };
+
+                            _out->write(decls[draw(4)]);
+                            _out->write(" ");
+                            write_address();
+                            write_sloc();
+                            _out->write(" col:6 used name_");
+                            _out->write((unsigned long long) draw(100000));
+                            _out->write(" '");
+                            write_type();
+                            _out->write("'\n");
+                        }
+                        return;
+
+                    case STMT:
+                        {
+                            static const char* stmts[] = { "CompoundStmt", "IfStmt", "ReturnStmt", "DeclStmt" };
+                            static const char* exprs[] = { "CallExpr", "ImplicitCastExpr", "BinaryOperator", "MemberExpr" };
+                            bool expr = draw(2);
+
+                            _out->write(expr ? exprs[draw(4)] : stmts[draw(4)]);
+                            _out->write(" ");
+                            write_address();
+                            write_sloc();
+                            if (expr)
+                                {
+                                    _out->write(" '");
+                                    write_type();
+                                    _out->write("' <LValueToRValue>");
+                                }
+                            _out->write("\n");
+                        }
+                        return;
+
+                    default:
+                        switch (draw(4))
+                            {
+                            case 0:
+                                _out->write("IntegerLiteral ");
+                                write_address();
+                                _out->write(" <col:14> 'int' ");
+                                _out->write((unsigned long long) draw(1000));
+                                _out->write("\n");
+                                break;
+
+                            case 1:
+                                _out->write("DeclRefExpr ");
+                                write_address();
+                                _out->write(" <col:10> '");
+                                write_type();
+                                _out->write("' lvalue Var ");
+                                write_address();
+                                _out->write(" 'i' 'int'\n");
+                                break;
+
+                            case 2:
+                                _out->write("ParmVarDecl ");
+                                write_address();
+                                _out->write(" <col:10, col:14> col:14 used x '");
+                                write_type();
+                                _out->write("'\n");
+                                break;
+
+                            default:
+                                _out->write("TypedefDecl ");
+                                write_address();
+                                write_sloc();
+                                _out->write(" col:13 referenced type_t '");
+                                write_type();
+                                _out->write("'\n");
+                                break;
+                            }
+                        return;
+                    }
+            }
+
+            /*
+             * Write a new 0x... address
+             */
+            void write_address(void)
+            {
+                static const char hex[] = "0123456789abcdef";
+                char buf[20];
+                int len = sizeof(buf);
+
+                _address += 0x10 + 0x8 * draw(8);
+                for (unsigned long long a = _address; a; a >>= 4)
+                    buf[--len] = hex[a & 0xf];
+                buf[--len] = 'x';
+                buf[--len] = '0';
+                _out->write(buf + len, sizeof(buf) - len);
+            }
+
+            /*
+             * Write a source range
+             */
+            void write_sloc(void)
+            {
+                _line += draw(3);
+                _out->write(" <line:");
+                _out->write(_line);
+                _out->write(":1, col:");
+                _out->write((unsigned long long) 2 + draw(80));
+                _out->write(">");
+            }
+
+            /*
+             * Write a type: a long template one or a simple one
+             */
+            void write_type(void)
+            {
+                static const char* types[] = { "int", "const char *", "struct A", "unsigned long", "void (int)", "char [16]" };
+
+                if (event(_opts.template_rate))
+                    _out->write(_templates[draw(_templates.size())]);
+                else
+                    _out->write(types[draw(6)]);
+            }
+
+            /*
+             * Long template type, as in STL instantiations
+             */
+            std::string template_type(unsigned depth)
+            {
+                static const char* leaves[] = { "int", "char", "double", "struct A" };
+                std::string type = leaves[draw(4)];
+
+                for (unsigned d = 0; d < depth; d++)
+                    if (draw(2))
+                        type = "std::vector<" + type + ", std::allocator<" + type + " > >";
+                    else
+                        type = "std::map<std::basic_string<char, std::char_traits<char>, std::allocator<char> >, " +
+                            type + ", std::less<std::basic_string<char> > >";
+
+                return type;
+            }
+
+            GenOptions const& _opts;
+            parser::Ast2DotOutput* _out;
+            std::mt19937_64 _rand;
+            unsigned long long _address;
+            unsigned long long _line;
+            std::vector<std::string> _templates;
+        };
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+    clang_ast2dot::bench::GenOptions opts;
+    po::options_description desc("gen_ast_dump options");
+    po::variables_map vm;
+
+    desc.add_options()
+        ("help,h", "Help message")
+        ("output,o", po::value<std::string>()->default_value("-"), "Output dump file name: defaults to '-' that is stdout")
+        ("nodes,n", po::value<unsigned long long>(&opts.nodes)->default_value(1000000), "Number of vertices")
+        ("fanout,f", po::value<unsigned>(&opts.fanout)->default_value(4), "Max children of a vertex")
+        ("depth,d", po::value<unsigned>(&opts.depth)->default_value(12), "Max depth of a vertex")
+        ("null-rate", po::value<double>(&opts.null_rate)->default_value(0.05), "Rate of <<<NULL>>> children of statements")
+        ("public-rate", po::value<double>(&opts.public_rate)->default_value(0.2), "Rate of public base specifiers among record children")
+        ("template-rate", po::value<double>(&opts.template_rate)->default_value(0.05), "Rate of long template types")
+        ("template-depth", po::value<unsigned>(&opts.template_depth)->default_value(3), "Nesting of the long template types")
+        ("seed,s", po::value<unsigned long>(&opts.seed)->default_value(1), "Random seed");
+
+    try
+        {
+            po::store(po::parse_command_line(argc, argv, desc), vm);
+            po::notify(vm);
+        }
+    catch (po::error const& e)
+        {
+            std::cerr << "gen_ast_dump: " << e.what() << "\n" << desc;
+            return 1;
+        }
+
+    if (vm.count("help"))
+        {
+            std::cout << desc;
+            return 0;
+        }
+
+    int fd = STDOUT_FILENO;
+    if (vm["output"].as<std::string>() != "-")
+        {
+            fd = ::open(vm["output"].as<std::string>().c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+            if (fd < 0)
+                {
+                    std::cerr << "gen_ast_dump: failed to open output file '"
+                              << vm["output"].as<std::string>() << "'\n";
+                    return 1;
+                }
+        }
+
+    try
+        {
+            clang_ast2dot::parser::Ast2DotOutput out(fd, 4 * AST2DOT_OUTPUT_BUFFER_SIZE);
+            clang_ast2dot::bench::Ast2DotGenerator gen(opts, &out);
+            unsigned long long count = gen.generate();
+
+            out.flush();
+            std::cerr << "gen_ast_dump: " << count << " vertices, " << out.bytes() << " bytes\n";
+        }
+    catch (clang_ast2dot::parser::Ast2DotOutput::WriteException const& we)
+        {
+            std::cerr << "gen_ast_dump: failed to write output\n";
+            return 1;
+        }
+
+    if (fd != STDOUT_FILENO)
+        ::close(fd);
+
+    return 0;
+}
@@ -13,13 +13,31 @@
 /**
  * C++ System headers
  *
+ * algorithm for max
+ * atomic for the server stopped by signal
+ * csignal for stopping the server
  * cstdlib 
  * fstream for ifstream, ofstream, getline, etc...
  * iostream for cin, cout, etc...
+ * thread for the number of CPUs
  */
+#include <algorithm>
+#include <atomic>
+#include <csignal>
 #include <cstdlib>
 #include <fstream>
 #include <iostream>
+#include <thread>
+
+/**
+ * C System headers
+ *
+ * fcntl.h & unistd.h for output file descriptor
+ * sys/stat.h for the batch output directory
+ */
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 /**
  * Boost tokenizer for parsing ast dump lines
@@ -29,6 +47,16 @@
 // Include our defs
 #include "clang_ast2dot.h"
 #include "clang_ast_parser.h"
+#include "clang_ast_emitter.h"
+#include "clang_ast_dedupe.h"
+#include "clang_ast_cache.h"
+#include "clang_ast_incremental.h"
+#include "clang_ast_jobs.h"
+#include "clang_ast_batch.h"
+#include "clang_ast_server.h"
+#include "clang_ast_decompress.h"
+#include "clang_ast_compress.h"
+#include "clang_ast_stats.h"
 
 /*
  * Constants definitions
@@ -47,6 +75,26 @@
 // Verbose level
 static int opt_verbose = 0;
 
+// Parse flush-every option value
+static bool parse_flush_every(std::string const&, unsigned long&, size_t&);
+
+// Parse output-compress option value
+static bool parse_output_compress(std::string const&, clang_ast2dot::parser::Ast2DotCompressOutput::Format&);
+
+// Split comma separated option values
+static std::vector<std::string> option_list(po::variables_map const&, const char*);
+
+// Conversion settings of the batch and server workers
+static void batch_settings(po::variables_map const&, clang_ast2dot::parser::Ast2DotFilter&,
+                           clang_ast2dot::parser::Ast2DotBatch&);
+
+// Save a parsed graph in a cache file
+static bool write_cache(std::string const&, clang_ast2dot::parser::Ast2DotGraph const&);
+
+// Server stopped by SIGINT/SIGTERM
+static std::atomic<clang_ast2dot::parser::Ast2DotServer*> served((clang_ast2dot::parser::Ast2DotServer*) NULL);
+static void stop_serving(int);
+
 // Use std and boost namespaces
 using namespace std;
 using namespace boost;
@@ -90,97 +138,22 @@ namespace clang_ast2dot
     return _vm;
   }
   
-  /*
-   * Recursively create the .dot file 
-   */
-  int
-  Ast2DotMain::create_dot(std::istream* is, std::ostream* os, std::string const& parent_vertex, int level)
-  {
-    /* 
-     * Cout eventually sends to output file and cin gets from input file
-     */
-    
-    // While not end of file
-    while (!is->eof())
-      {
-        std::string name;
-        
-        // Parse vertex and return the vertex string for the .dot file
-        // Fields in Parser instance are initialized with each part
-        std::string *vertex = _parser.read_vertex_props(is, os);
-
-        // Get the name (= Vertex name + vertex address)
-        if (!vertex->empty())
-          {
-            name = _parser.name();
-            if (!_parser.is_null())
-              name.append(std::string("_").append(_parser.address()));
-          }
-
-        // Out the vertex string
-        *os << *vertex;
-
-        delete vertex;
-
-        // And if some relationship is needed add the directed edge
-        if (!(parent_vertex.empty() || name.empty()))
-          *os << "    " << parent_vertex << " -> " << name << " [style=\"solid\",color=black,weight=100,constraint=true];\n";
-
-        // Let's flush for easier debug
-        os->flush();
-
-        // Start next vertex relationship string
-        std::string scstr;
-        
-        // Read relationship spec string
-        try
-          {
-            // Returns the full string from beginning of line until the dash '-'
-            // ("|-" for a vertex having still sibling or "`-" for a vertex being
-            // the last child)
-            scstr = _parser.read_sibling_child_string(is);
-            // If the string is empty, we could be at end of file
-            if (!scstr.empty())
-              {
-            	// The next vertex level in the tree is hasl the size of the string
-                int new_level = scstr.length() / 2;
-
-                // We goes down deeper in tree, so call again with new_level, parent being current vertex
-                if (new_level > level)
-                  new_level = create_dot(is, os, name, new_level);
-
-                // If we have a sibling vertex, call again with same level and same parent
-                if (new_level == level)
-                  new_level = create_dot(is, os, parent_vertex, level);
-
-                // If level is less, let's go down (return new_level)
-                if (new_level < level)
-                  // Get back up in tree
-                  return new_level;
-              }
-          }
-        catch (ast2dot::Ast2DotParser::UnexpectedEofException const& ueofe)
-          {
-              break;
-          }
-        catch (ast2dot::Ast2DotParser::EmptyScStrException const& esse)
-          {
-              break;
-          }
-        catch (ast2dot::Ast2DotParser::InvalidScStrException const& isse)
-          {
-            break;
-          }
-      }
-    return level;
-  }
-  
   /*
    *
    */
   int
   Ast2DotMain::do_main(int opt_ind)
   {
+    // Many dumps converted in this process (config and options read once)
+    if (_vm.count("batch"))
+      return do_batch(_vm["batch"].as<std::string>());
+
+    // Dumps converted by a server started once, or sent to one
+    if (_vm.count("serve"))
+      return do_serve(_vm["serve"].as<std::string>());
+    if (_vm.count("client"))
+      return do_client(_vm["client"].as<std::string>());
+
     if (opt_verbose >= 2)
       {
         std::cerr << "[do_main] Option input = '"
@@ -189,20 +162,73 @@ namespace clang_ast2dot
                   << _vm["output"].as<std::string>() << "'\n";
       }
 
-    // Opening input/output files with cin/cout
+    // Opening input/output files
     std::streambuf *cin_rdbuf = (std::streambuf *) NULL;
-    std::streambuf *cout_rdbuf = (std::streambuf *) NULL;
-    std::istream *is = (std::istream *) NULL;
-    std::ostream *os = (std::ostream *) NULL;
     std::ifstream *ifs = (std::ifstream *) NULL;
-    std::ofstream *ofs = (std::ofstream *) NULL;
+    ast2dot::Ast2DotInput *in = (ast2dot::Ast2DotInput *) NULL;
+    ast2dot::Ast2DotMmapInput *mmap_in = (ast2dot::Ast2DotMmapInput *) NULL;
+    ast2dot::Ast2DotMmapInput *compressed_map = (ast2dot::Ast2DotMmapInput *) NULL;
+    ast2dot::Ast2DotDecompressInput *decompress_in = (ast2dot::Ast2DotDecompressInput *) NULL;
+    ast2dot::Ast2DotOutput *out = (ast2dot::Ast2DotOutput *) NULL;
+    ast2dot::Ast2DotCompressOutput *compress_out = (ast2dot::Ast2DotCompressOutput *) NULL;
+    ast2dot::Ast2DotCache *cache = (ast2dot::Ast2DotCache *) NULL;
+    int ofd = -1;
+    int ret = 1;
       
     do
       {
+        // A cache is emitted as it was saved, filtered and collapsed by the options of --save-cache
+        if (_vm.count("load-cache") &&
+            (_vm.count("include-kind") || _vm.count("exclude-kind") || _vm.count("only-file") ||
+             _vm.count("max-depth")))
+          {
+            std::cerr << "[do_main] ** Error! --load-cache emits the graph as saved, without "
+                      << "--include-kind, --exclude-kind, --only-file or --max-depth!\n";
+            break;
+          }
+
         // Setup input file or cin if file name is '-'
-        if (_vm["input"].as<std::string>().compare("-") != 0)
+        if (_vm["input"].as<std::string>().compare("-") != 0 &&
+            ast2dot::Ast2DotMmapInput::is_mappable(_vm["input"].as<std::string>()))
           {
-            // If input from file, open it
+            // Regular input file are mapped in memory
+            try
+              {
+                in = mmap_in = new ast2dot::Ast2DotMmapInput(_vm["input"].as<std::string>());
+              }
+            catch (ast2dot::Ast2DotInput::OpenException const& oe)
+              {
+                std::cerr << "[do_main] ** Error! failed to open input file '"
+                          << _vm["input"].as<std::string>() << "'!\n";
+                break;
+              }
+
+            if (opt_verbose >= 2)
+              std::cerr << "[do_main] input file mapped in memory\n";
+
+            // Compressed dump: decompressed while parsed, as a stream
+            ast2dot::Ast2DotDecompressInput::Format format =
+              ast2dot::Ast2DotDecompressInput::detect(mmap_in->data(), mmap_in->size());
+
+            if (format != ast2dot::Ast2DotDecompressInput::NONE)
+              {
+                if (!ast2dot::Ast2DotDecompressInput::supported(format))
+                  {
+                    std::cerr << "[do_main] ** Error! input file '"
+                              << _vm["input"].as<std::string>()
+                              << "' compressed in a format not supported by this build!\n";
+                    break;
+                  }
+                compressed_map = mmap_in;
+                mmap_in = (ast2dot::Ast2DotMmapInput *) NULL;
+                in = decompress_in =
+                  new ast2dot::Ast2DotDecompressInput(compressed_map->data(), compressed_map->size(), format);
+              }
+          }
+
+        else if (_vm["input"].as<std::string>().compare("-") != 0)
+          {
+            // If input from file (fifo, device, ...), open it
             ifs = new std::ifstream(_vm["input"].as<std::string>().c_str(),
                                     std::ifstream::in);
             if (!ifs->is_open() ||
@@ -218,36 +244,342 @@ namespace clang_ast2dot
             // tie to stdout (for auto flushing)
             std::cin.tie(0);
           }
+
+        // Stdin (or not mappable file) is read by blocks from cin, unless
+        // the graph is loaded from a cache (not read, nor waited for)
+        if (!in && !_vm.count("load-cache"))
+          {
+            // Compressed stream told by its magic (read first by the input)
+            std::string magic;
+            ast2dot::Ast2DotDecompressInput::Format format =
+              ast2dot::Ast2DotDecompressInput::detect(&std::cin, magic);
+
+            if (!ast2dot::Ast2DotDecompressInput::supported(format))
+              {
+                std::cerr << "[do_main] ** Error! input compressed in a format"
+                          << " not supported by this build!\n";
+                break;
+              }
+            if (format != ast2dot::Ast2DotDecompressInput::NONE)
+              in = decompress_in = new ast2dot::Ast2DotDecompressInput(&std::cin, format, magic);
+            else
+              in = new ast2dot::Ast2DotStreamInput(&std::cin, magic);
+          }
           
-        // Same for output file or cout
+        // Same for output file or stdout
         if (_vm["output"].as<std::string>().compare("-") != 0)
           {
             // If output to file, open it
-            ofs = new std::ofstream(_vm["output"].as<std::string>().c_str(),
-                                    std::ofstream::out);
-            if (!ofs->is_open() ||
-                (ofs->rdstate() & std::ofstream::failbit) != 0)
+            ofd = ::open(_vm["output"].as<std::string>().c_str(),
+                         O_WRONLY | O_CREAT | O_TRUNC, 0666);
+            if (ofd < 0)
               {
                 std::cerr << "[do_main] ** Error! failed to open output file '"
                           << _vm["output"].as<std::string>() << "'!\n";
                 break;
               }
+          }
+
+        else
+          {
+            // Nothing from cout shall come after our output
+            std::cout.flush();
+            ofd = STDOUT_FILENO;
+          }
+
+        // Compressed as asked, or as told by the output file suffix
+        ast2dot::Ast2DotCompressOutput::Format output_format =
+          ast2dot::Ast2DotCompressOutput::detect(_vm["output"].as<std::string>());
+
+        if (_vm.count("output-compress") &&
+            !parse_output_compress(_vm["output-compress"].as<std::string>(), output_format))
+          {
+            std::cerr << "[do_main] ** Error! invalid output-compress value '"
+                      << _vm["output-compress"].as<std::string>() << "'!\n";
+            break;
+          }
+        if (!ast2dot::Ast2DotDecompressInput::supported(output_format))
+          {
+            std::cerr << "[do_main] ** Error! output compression format"
+                      << " not supported by this build!\n";
+            break;
+          }
+
+        // Buffered output: written only when buffer is full (and compressed
+        // by a thread of its own if asked to)
+        if (output_format != ast2dot::Ast2DotDecompressInput::NONE)
+          out = compress_out = new ast2dot::Ast2DotCompressOutput(ofd, output_format);
+        else
+          out = new ast2dot::Ast2DotOutput(ofd);
+
+        // Unless someone is tailing the output
+        if (_vm.count("flush-every"))
+          {
+            unsigned long nodes = 0;
+            size_t bytes = 0;
+
+            if (!parse_flush_every(_vm["flush-every"].as<std::string>(), nodes, bytes))
+              {
+                std::cerr << "[do_main] ** Error! invalid flush-every value '"
+                          << _vm["flush-every"].as<std::string>() << "'!\n";
+                break;
+              }
+            out->flush_every_nodes(nodes);
+            out->flush_every_bytes(bytes);
+          }
+
+        // Subtrees skipped while parsing
+        ast2dot::Ast2DotFilter filter;
+
+        filter.include_kinds(option_list(_vm, "include-kind"));
+        filter.exclude_kinds(option_list(_vm, "exclude-kind"));
+        filter.only_files(option_list(_vm, "only-file"));
+        _parser.set_filter(filter);
+
+        // Vertices deeper than max depth collapsed in summary vertices
+        int max_depth = _vm.count("max-depth") ? (int) _vm["max-depth"].as<unsigned>() : -1;
+
+        _parser.set_max_depth(max_depth);
 
-            // Replace cout buf stream with file's one and keep it for restoring
-            cout_rdbuf = std::cout.rdbuf(ofs->rdbuf());
+        // Parallel parsing needs the whole dump in memory
+        unsigned jobs = _vm.count("jobs") ? _vm["jobs"].as<unsigned>() : 1;
+
+        if (jobs > 1 && !mmap_in && opt_verbose >= 1)
+          std::cerr << "[do_main] input not mapped in memory, parsing with one job\n";
+
+        // Top level declarations, the parts of the dump, are collapsed together
+        if (jobs > 1 && max_depth == 0)
+          jobs = 1;
+
+        // Identical subtrees are shared inside the whole graph only
+        bool dedupe = _vm.count("dedupe-subtrees");
+
+        if (jobs > 1 && dedupe)
+          {
+            if (opt_verbose >= 1)
+              std::cerr << "[do_main] subtrees deduplicated, parsing with one job\n";
+            jobs = 1;
           }
 
-        // Start a directed graph
-        std::cout << "digraph {\n";
+        // References and redeclarations are linked in dump order, by one emitter
+        bool xref = _vm.count("xref-edges") || _vm.count("redecl-edges");
+
+        if (jobs > 1 && xref)
+          {
+            if (opt_verbose >= 1)
+              std::cerr << "[do_main] cross-reference or redeclaration edges, parsing with one job\n";
+            jobs = 1;
+          }
+
+        // The cache is of the whole graph, and a loaded one is not parsed
+        std::string save_cache = _vm.count("save-cache") ? _vm["save-cache"].as<std::string>() : std::string();
+        std::string load_cache = _vm.count("load-cache") ? _vm["load-cache"].as<std::string>() : std::string();
+
+        if (jobs > 1 && (!save_cache.empty() || !load_cache.empty()))
+          jobs = 1;
+
+        // Chunks of the dump reused from the fragments of previous conversions
+        std::string incremental = _vm.count("incremental") ? _vm["incremental"].as<std::string>() : std::string();
+
+        if (!incremental.empty() &&
+            (!mmap_in || dedupe || xref || !save_cache.empty() || !load_cache.empty() || max_depth == 0))
+          {
+            if (opt_verbose >= 1)
+              std::cerr << "[do_main] input not mapped or whole graph needed, converting without fragments\n";
+            incremental.clear();
+          }
+
+        try
+          {
+            // Start a directed graph
+            out->write("digraph {\n");
+
+            if (!incremental.empty())
+              {
+                // Chunks unchanged since a previous conversion are not parsed
+                ast2dot::Ast2DotIncremental chunks(incremental);
+                std::string salt;
+                size_t vertices;
 
-        // First call for root with all empty/level 0
-        create_dot(&std::cin, &std::cout, "", 0);
+                salt.append("include-kind=");
+                for (std::string const& kind : option_list(_vm, "include-kind"))
+                  salt.append(kind).append(",");
+                salt.append(" exclude-kind=");
+                for (std::string const& kind : option_list(_vm, "exclude-kind"))
+                  salt.append(kind).append(",");
+                salt.append(" only-file=");
+                for (std::string const& glob : option_list(_vm, "only-file"))
+                  salt.append(glob).append(",");
+                salt.append(" max-depth=").append(std::to_string(max_depth));
 
-        // Create vertex in dot file
-        std::cout << "}\n";
+                chunks.set_filter(&filter);
+                chunks.set_max_depth(max_depth);
+                chunks.set_salt(salt);
+                vertices = chunks.convert(mmap_in->data(), mmap_in->size(), out);
+
+                if (opt_verbose >= 1)
+                  std::cerr << "[do_main] " << vertices << " vertices in " << chunks.chunks() << " chunks, "
+                            << chunks.hits() << " from fragments, " << chunks.misses() << " converted\n";
+              }
+
+            else if (jobs > 1 && mmap_in)
+              {
+                // Parse and emit chunks of the mapped dump in parallel
+                ast2dot::Ast2DotJobs workers(jobs);
+                size_t vertices;
+
+                workers.flush_chunks(_vm.count("flush-every"));
+                workers.set_filter(&filter);
+                workers.set_max_depth(max_depth);
+                vertices = workers.convert(mmap_in->data(), mmap_in->size(), out);
+
+                if (opt_verbose >= 1)
+                  std::cerr << "[do_main] " << vertices << " vertices read in "
+                            << workers.chunks() << " chunks by " << jobs << " jobs\n";
+              }
+
+            else
+              {
+                // Parse the dump in the graph model (or map its cache), then emit it: a top
+                // level declaration at a time unless the whole graph is needed
+                bool whole = dedupe || !save_cache.empty() || !load_cache.empty();
+                ast2dot::Ast2DotSymbols cache_symbols;
+                ast2dot::Ast2DotGraph graph(load_cache.empty() ? _parser.symbols() : cache_symbols);
+                ast2dot::Ast2DotEmitter emitter(out);
+                ast2dot::Ast2DotDedupeEmitter dedupe_emitter(out);
+                ast2dot::Ast2DotXref xrefs;
+
+                if (xref)
+                  {
+                    xrefs.enable(ast2dot::Ast2DotXref::REFERENCE, _vm.count("xref-edges"));
+                    xrefs.enable(ast2dot::Ast2DotXref::PREV, _vm.count("redecl-edges"));
+                    xrefs.enable(ast2dot::Ast2DotXref::PARENT, _vm.count("redecl-edges"));
+                    emitter.set_xref(&xrefs);
+                    dedupe_emitter.set_xref(&xrefs);
+                  }
+
+                if (!load_cache.empty())
+                  {
+                    cache = new ast2dot::Ast2DotCache(load_cache);
+                    cache->load(cache_symbols, graph);
+
+                    if (opt_verbose >= 1)
+                      std::cerr << "[do_main] " << graph.size() << " vertices mapped from "
+                                << cache->size() << " bytes of cache\n";
+                  }
+                else if (whole)
+                  {
+                    _parser.read_graph(in, graph);
+
+                    if (opt_verbose >= 1)
+                      std::cerr << "[do_main] " << graph.size() << " vertices read in "
+                                << graph.bytes() << " bytes of graph\n";
+                  }
+                else
+                  {
+                    // Each part emitted (and flushed) once read, the graph holding one only
+                    size_t vertices = 0;
+                    size_t parts = 0;
+                    size_t bytes = 0;
+
+                    for (int level = 0; level >= 0; parts++)
+                      {
+                        graph.clear();
+                        level = _parser.read_part(in, graph, level);
+                        vertices += emitter.emit(graph);
+                        bytes = std::max(bytes, graph.bytes());
+                      }
+
+                    if (opt_verbose >= 1)
+                      std::cerr << "[do_main] " << vertices << " vertices read in " << parts
+                                << " parts, largest graph of " << bytes << " bytes\n";
+                  }
+
+                if (!save_cache.empty() && !write_cache(save_cache, graph))
+                  break;
+
+                if (dedupe)
+                  {
+                    size_t vertices = dedupe_emitter.emit(graph);
+
+                    if (opt_verbose >= 1)
+                      std::cerr << "[do_main] " << vertices << " vertices emitted, "
+                                << dedupe_emitter.shared() << " subtrees shared\n";
+                  }
+                else if (whole)
+                  emitter.emit(graph);
+
+                if (xref)
+                  {
+                    size_t dropped = xrefs.finish();
+
+                    if (opt_verbose >= 1)
+                      std::cerr << "[do_main] " << xrefs.edges(ast2dot::Ast2DotXref::REFERENCE)
+                                << " cross-reference edges, " << xrefs.edges(ast2dot::Ast2DotXref::PREV)
+                                << " prev edges, " << xrefs.edges(ast2dot::Ast2DotXref::PARENT)
+                                << " parent edges, " << dropped << " links not resolved\n";
+                  }
+              }
+
+            // Create vertex in dot file
+            out->write("}\n");
+            out->flush();
+
+            // Compressed stream ended
+            if (compress_out)
+              compress_out->finish();
+          }
+        catch (ast2dot::Ast2DotOutput::WriteException const& we)
+          {
+            std::cerr << "[do_main] ** Error! failed to write output file '"
+                      << _vm["output"].as<std::string>() << "'!\n";
+            break;
+          }
+        catch (ast2dot::Ast2DotCache::OpenException const& oe)
+          {
+            std::cerr << "[do_main] ** Error! failed to open cache file '"
+                      << load_cache << "'!\n";
+            break;
+          }
+        catch (ast2dot::Ast2DotCache::FormatException const& fe)
+          {
+            std::cerr << "[do_main] ** Error! " << fe.what() << " '"
+                      << load_cache << "'!\n";
+            break;
+          }
+        catch (ast2dot::Ast2DotGraph::FormatException const& fe)
+          {
+            std::cerr << "[do_main] ** Error! " << fe.what() << " in cache '"
+                      << load_cache << "'!\n";
+            break;
+          }
+        catch (ast2dot::Ast2DotDecompressInput::DecompressException const& de)
+          {
+            std::cerr << "[do_main] ** Error! " << de.what() << "\n";
+            break;
+          }
+
+        if (decompress_in && opt_verbose >= 1)
+          std::cerr << "[do_main] " << decompress_in->compressed()
+                    << " compressed bytes read\n";
+
+        if (compress_out && opt_verbose >= 1)
+          std::cerr << "[do_main] " << compress_out->compressed()
+                    << " compressed bytes output\n";
+
+        if (opt_verbose >= 1)
+          std::cerr << "[do_main] " << out->bytes() << " bytes output in "
+                    << out->syscalls() << " write syscalls\n";
+
+        ret = 0;
 
       } while (0);
 
+    // Decompression thread stopped before its stream is restored
+    delete in;
+    in = (ast2dot::Ast2DotInput *) NULL;
+    delete compressed_map;
+
     // Restore cin stream buffer if necessary
     if (cin_rdbuf) {
       (void) std::cin.rdbuf(cin_rdbuf);
@@ -255,23 +587,338 @@ namespace clang_ast2dot
       std::cin.tie(0);
     }
 
-    // Restore cout stream buffer if necessary
-    if (cout_rdbuf)
-      (void) std::cout.rdbuf(cin_rdbuf);
-
-    // Close output file if necessary
-    if (ofs)
-      ofs->close();
-
     // Close input file if necessary
     if (ifs)
       ifs->close();
 
+    delete ifs;
+    delete out;
+    delete cache;
+
+    // Close output file if necessary
+    if (ofd >= 0 && ofd != STDOUT_FILENO)
+      ::close(ofd);
+
+    return ret;
+  }
+
+  /*
+   * Convert the dumps of a list file or directory with a pool of jobs,
+   * each one to its own dot file: next to the dump, or in the output
+   * directory if one is given
+   *
+   * @param batch           list file or directory of the dumps
+   *
+   * @return 0 if all the dumps were converted
+   */
+  int
+  Ast2DotMain::do_batch(std::string const& batch)
+  {
+    std::vector<ast2dot::Ast2DotBatch::Item> items;
+    std::string out_dir;
+    unsigned jobs = _vm.count("jobs") ? _vm["jobs"].as<unsigned>() : 1;
+
+    if (_vm["output"].as<std::string>().compare("-") != 0)
+      {
+        out_dir = _vm["output"].as<std::string>();
+        ::mkdir(out_dir.c_str(), 0777);
+      }
+
+    try
+      {
+        ast2dot::Ast2DotBatch::list(batch, out_dir, items);
+      }
+    catch (ast2dot::Ast2DotBatch::ListException const& le)
+      {
+        std::cerr << "[do_batch] ** Error! failed to read dump list '" << batch << "'!\n";
+        return 1;
+      }
+
+    if ((_vm.count("save-cache") || _vm.count("load-cache") || _vm.count("incremental")) && opt_verbose >= 1)
+      std::cerr << "[do_batch] cache and incremental options are for one dump, ignored\n";
+
+    // Same settings for all the dumps
+    ast2dot::Ast2DotFilter filter;
+    ast2dot::Ast2DotBatch workers(jobs);
+
+    batch_settings(_vm, filter, workers);
+    workers.convert(items);
+
+    if (opt_verbose >= 1)
+      for (size_t k = 0; k < items.size(); k++)
+        if (items[k].ok)
+          std::cerr << "[do_batch] '" << items[k].input << "' -> '" << items[k].output << "': "
+                    << items[k].vertices << " vertices, " << items[k].bytes_in << " bytes in "
+                    << items[k].seconds << " s\n";
+
+    // Aggregate throughput
+    double seconds = workers.seconds() > 0 ? workers.seconds() : 1e-9;
+
+    std::cerr << "[do_batch] " << workers.files() - workers.failed() << " dumps converted ("
+              << workers.failed() << " failed) by " << jobs << " jobs in " << workers.seconds() << " s: "
+              << workers.vertices() << " vertices, " << workers.bytes_in() << " bytes read, "
+              << workers.bytes_out() << " bytes written, "
+              << workers.files() / seconds << " dumps/s, "
+              << workers.bytes_in() / seconds / (1024 * 1024) << " MB/s, "
+              << workers.vertices() / seconds << " vertices/s\n";
+
+    return workers.failed() ? 1 : 0;
+  }
+
+  /*
+   * Serve conversions on a local socket until killed, with a pool of
+   * jobs (one per CPU by default) each accepting connections
+   *
+   * @param path            socket path
+   *
+   * @return 1 if the socket cannot be used
+   */
+  int
+  Ast2DotMain::do_serve(std::string const& path)
+  {
+    unsigned jobs = _vm.count("jobs") ? _vm["jobs"].as<unsigned>() : std::thread::hardware_concurrency();
+
+    // Same settings for all the dumps
+    ast2dot::Ast2DotFilter filter;
+    ast2dot::Ast2DotBatch settings(jobs);
+
+    batch_settings(_vm, filter, settings);
+
+    try
+      {
+        ast2dot::Ast2DotServer server(path, settings,
+                                      _vm.count("max-request") ? _vm["max-request"].as<unsigned long>()
+                                                               : AST2DOT_SERVER_MAX_REQUEST_SIZE);
+
+        if (opt_verbose >= 1)
+          std::cerr << "[do_serve] serving on '" << path << "' with " << settings.jobs() << " jobs\n";
+
+        // Stopped on signal, the socket being removed
+        served = &server;
+        ::signal(SIGINT, stop_serving);
+        ::signal(SIGTERM, stop_serving);
+        server.serve();
+        served = (ast2dot::Ast2DotServer*) NULL;
+
+        if (opt_verbose >= 1)
+          std::cerr << "[do_serve] " << server.requests() << " requests served, "
+                    << server.failed() << " failed\n";
+      }
+    catch (ast2dot::Ast2DotServer::SocketException const& se)
+      {
+        std::cerr << "[do_serve] ** Error! failed to listen on socket '" << path << "'!\n";
+        return 1;
+      }
+
     return 0;
   }
 
+  /*
+   * Send the input dump to a server and write the dot file it sends back
+   * to the output
+   *
+   * @param path            socket path of the server
+   *
+   * @return 0 if the dump was converted
+   */
+  int
+  Ast2DotMain::do_client(std::string const& path)
+  {
+    int ifd = STDIN_FILENO;
+    int ofd = STDOUT_FILENO;
+    int ret = 1;
+
+    do
+      {
+        if (_vm["input"].as<std::string>().compare("-") != 0 &&
+            (ifd = ::open(_vm["input"].as<std::string>().c_str(), O_RDONLY)) < 0)
+          {
+            std::cerr << "[do_client] ** Error! failed to open input file '"
+                      << _vm["input"].as<std::string>() << "'!\n";
+            break;
+          }
+
+        if (_vm["output"].as<std::string>().compare("-") != 0 &&
+            (ofd = ::open(_vm["output"].as<std::string>().c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666)) < 0)
+          {
+            std::cerr << "[do_client] ** Error! failed to open output file '"
+                      << _vm["output"].as<std::string>() << "'!\n";
+            break;
+          }
+
+        std::cout.flush();
+
+        try
+          {
+            if (!ast2dot::Ast2DotServer::request(path, ifd, ofd))
+              {
+                std::cerr << "[do_client] ** Error! conversion failed on server '" << path << "'!\n";
+                break;
+              }
+          }
+        catch (ast2dot::Ast2DotServer::SocketException const& se)
+          {
+            std::cerr << "[do_client] ** Error! failed to connect to server '" << path << "'!\n";
+            break;
+          }
+
+        ret = 0;
+
+      } while (0);
+
+    if (ifd >= 0 && ifd != STDIN_FILENO)
+      ::close(ifd);
+    if (ofd >= 0 && ofd != STDOUT_FILENO)
+      ::close(ofd);
+
+    return ret;
+  }
+
 } // namespace clang_ast2dot
 
+/*
+ * Parse the flush-every option value: N vertices, or N bytes with a
+ * b, k or M suffix
+ */
+static bool
+parse_flush_every(std::string const& value, unsigned long& nodes, size_t& bytes)
+{
+  char *end = (char *) NULL;
+  unsigned long n = ::strtoul(value.c_str(), &end, 10);
+
+  nodes = 0;
+  bytes = 0;
+
+  if (end == value.c_str())
+    return false;
+
+  switch (*end) {
+  case '\0':
+    nodes = n;
+    return true;
+  case 'b':
+    bytes = n;
+    break;
+  case 'k':
+    bytes = n * 1024;
+    break;
+  case 'M':
+    bytes = n * 1024 * 1024;
+    break;
+  default:
+    return false;
+  }
+
+  return *(end + 1) == '\0';
+}
+
+/*
+ * Parse the output-compress option value: gzip, zstd or none
+ */
+static bool
+parse_output_compress(std::string const& value, clang_ast2dot::parser::Ast2DotCompressOutput::Format& format)
+{
+  if (value == "gzip")
+    format = clang_ast2dot::parser::Ast2DotDecompressInput::GZIP;
+  else if (value == "zstd")
+    format = clang_ast2dot::parser::Ast2DotDecompressInput::ZSTD;
+  else if (value == "none")
+    format = clang_ast2dot::parser::Ast2DotDecompressInput::NONE;
+  else
+    return false;
+
+  return true;
+}
+
+/*
+ * Values of a repeatable option, each one being a comma separated list
+ */
+static std::vector<std::string>
+option_list(po::variables_map const& vm, const char* name)
+{
+  std::vector<std::string> list;
+
+  if (!vm.count(name))
+    return list;
+
+  std::vector<std::string> const& values = vm[name].as<std::vector<std::string> >();
+  for (size_t v = 0; v < values.size(); v++) {
+    size_t start = 0;
+    size_t comma;
+
+    do {
+      comma = values[v].find(',', start);
+      if (comma != start && start < values[v].size())
+        list.push_back(values[v].substr(start, comma - start));
+      start = comma + 1;
+    } while (comma != std::string::npos);
+  }
+
+  return list;
+}
+
+/*
+ * Conversion settings of the batch and server workers, from the options
+ */
+static void
+batch_settings(po::variables_map const& vm, clang_ast2dot::parser::Ast2DotFilter& filter,
+               clang_ast2dot::parser::Ast2DotBatch& batch)
+{
+  filter.include_kinds(option_list(vm, "include-kind"));
+  filter.exclude_kinds(option_list(vm, "exclude-kind"));
+  filter.only_files(option_list(vm, "only-file"));
+
+  batch.set_filter(&filter);
+  batch.set_max_depth(vm.count("max-depth") ? (int) vm["max-depth"].as<unsigned>() : -1);
+  batch.set_dedupe(vm.count("dedupe-subtrees"));
+  batch.set_xref(vm.count("xref-edges"), vm.count("redecl-edges"));
+}
+
+/*
+ * Stop the server on signal
+ */
+static void
+stop_serving(int /* sig */)
+{
+  clang_ast2dot::parser::Ast2DotServer* server = served.load();
+
+  if (server)
+    server->stop();
+}
+
+/*
+ * Save a parsed graph in a binary cache file
+ */
+static bool
+write_cache(std::string const& path, clang_ast2dot::parser::Ast2DotGraph const& graph)
+{
+  int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  bool ok = true;
+
+  if (fd < 0) {
+    std::cerr << "[write_cache] ** Error! failed to open cache file '" << path << "'!\n";
+    return false;
+  }
+
+  try {
+    clang_ast2dot::parser::Ast2DotOutput out(fd);
+
+    clang_ast2dot::parser::Ast2DotCache::save(graph, &out);
+    out.flush();
+
+    if (opt_verbose >= 1)
+      std::cerr << "[write_cache] " << out.bytes() << " bytes of cache saved\n";
+  }
+  catch (clang_ast2dot::parser::Ast2DotOutput::WriteException const& we) {
+    std::cerr << "[write_cache] ** Error! failed to write cache file '" << path << "'!\n";
+    ok = false;
+  }
+
+  ::close(fd);
+
+  return ok;
+}
+
 static std::string
 var2option_mapper(std::string var_name)
 {
@@ -348,6 +995,25 @@ int main(int argc, char *argv[])
          multitoken()->notifier(compute_verbose), "Verbosity level")
         ("output,o", po::value<std::string>()->default_value(std::string("-")), "Output dot file name: defaults to '-' that is stdout")
         ("input,i", po::value<std::string>()->default_value(std::string("-")), "Input dot file name: defaults to '-' that is stdin")
+        ("output-compress", po::value<std::string>(), "Compress the output: gzip, zstd or none, defaults to the output file suffix (.gz, .zst)")
+        ("flush-every", po::value<std::string>(), "Flush output every N vertices, or every N bytes with a b/k/M suffix: defaults to flush only when output buffer is full")
+        ("jobs,j", po::value<unsigned>(), "Parse a regular input file with N jobs, or convert N dumps at once with --batch: defaults to 1")
+        ("serve", po::value<std::string>(), "Serve conversions on this local socket, with --jobs workers (one per CPU by default)")
+        ("client", po::value<std::string>(), "Convert the input with the server of this local socket")
+        ("max-request", po::value<unsigned long>(), "Largest dump converted by --serve, in bytes (256 MiB by default)")
+        ("batch", po::value<std::string>(), "Convert the dumps listed in this file (one per line) or found in this directory, each to <dump>.dot or to the --output directory")
+        ("include-kind", po::value<std::vector<std::string> >()->composing(), "Keep only the top level declarations of these kinds (comma separated, repeatable)")
+        ("exclude-kind", po::value<std::vector<std::string> >()->composing(), "Skip the subtrees of these kinds (comma separated, repeatable)")
+        ("max-depth", po::value<unsigned>(), "Collapse the vertices deeper than N in one summary vertex per parent")
+        ("dedupe-subtrees", "Emit identical subtrees (but for addresses) once, with their multiplicity")
+        ("xref-edges", "Link DeclRefExpr and MemberExpr vertices to the declarations they reference")
+        ("redecl-edges", "Link declarations to their previous declaration (prev) and semantic parent (parent)")
+        ("save-cache", po::value<std::string>(), "Save the parsed graph in a binary cache file (.a2d)")
+        ("load-cache", po::value<std::string>(), "Emit the graph of a binary cache file instead of parsing the input, as filtered when saved")
+        ("incremental", po::value<std::string>(), "Reuse the dot fragments of the unchanged parts of a mapped dump, kept in this directory")
+        ("only-file", po::value<std::vector<std::string> >()->composing(), "Keep only the top level declarations of source files matching these globs (repeatable)")
+        ("stats", po::value<std::string>()->implicit_value(std::string("text")), "Report the time of the conversion phases and counters at exit, as text or json")
+        ("stats-file", po::value<std::string>(), "Write the --stats report to this file (only the report) rather than to stderr")
         ("param", "Extra parameters");
 
       po::positional_options_description params;
@@ -434,7 +1100,37 @@ int main(int argc, char *argv[])
             std::cout << argv[0] << "version " AST2DOT_VERSION_STRING "\n";
           
           else
-            ret = the_main.do_main(0);
+            {
+              // Phases timed and counted if asked to, reported at exit
+              std::string stats = the_main.vm().count("stats") ? the_main.vm()["stats"].as<std::string>() : std::string();
+
+              if (!stats.empty() && stats != "text" && stats != "json")
+                std::cerr << "Error: invalid stats value '" << stats << "'!\n";
+              else
+                {
+                  if (!stats.empty())
+                    clang_ast2dot::parser::Ast2DotStats::enable();
+
+                  ret = the_main.do_main(0);
+
+                  // Report alone in its file, to be parsed
+                  if (!stats.empty() && the_main.vm().count("stats-file"))
+                    {
+                      std::ofstream sf(the_main.vm()["stats-file"].as<std::string>().c_str());
+
+                      if (sf.is_open())
+                        clang_ast2dot::parser::Ast2DotStats::report(sf, stats == "json");
+                      if (!sf.is_open() || !sf.good())
+                        {
+                          std::cerr << "Error: failed to write stats file '"
+                                    << the_main.vm()["stats-file"].as<std::string>() << "'!\n";
+                          ret = 1;
+                        }
+                    }
+                  else if (!stats.empty())
+                    clang_ast2dot::parser::Ast2DotStats::report(std::cerr, stats == "json");
+                }
+            }
         }
     }
   catch (boost::program_options::error poe)
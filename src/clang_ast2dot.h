@@ -30,6 +30,7 @@
  * Own headers
  */
 #include "clang_ast_parser.h"
+#include "clang_ast_output.h"
 
 using namespace boost;
 namespace po = boost::program_options;
@@ -45,7 +46,9 @@ namespace clang_ast2dot
 
     virtual po::variables_map& vm(void);
     virtual int do_main(int);
-    virtual int create_dot(std::istream *, std::ostream *, std::string const&, int);
+    virtual int do_batch(std::string const&);
+    virtual int do_serve(std::string const&);
+    virtual int do_client(std::string const&);
     
   private:
     clang_ast2dot::parser::Ast2DotParser _parser;
@@ -0,0 +1,82 @@
+/**
+ * @file clang_ast_arena.cc
+ */
+
+// Include our defs
+#include "clang_ast_arena.h"
+
+namespace clang_ast2dot
+{
+  namespace parser
+  {
+    /**
+     * Ast2DotArena Constructor
+     *
+     * @param chunk_size  size of the chunks
+     */
+    Ast2DotArena::Ast2DotArena(size_t chunk_size)
+      : _index(0),
+        _cur((char*)NULL),
+        _end((char*)NULL),
+        _chunk_size(chunk_size),
+        _capacity(0)
+    {
+    }
+
+    /**
+     * Ast2DotArena Destructor
+     */
+    Ast2DotArena::~Ast2DotArena()
+    {
+      for (size_t i = 0; i < _chunks.size(); i++)
+        delete[] _chunks[i];
+    }
+
+    /**
+     * Give back all allocated memory. Chunks are kept for reuse.
+     */
+    void
+    Ast2DotArena::reset(void)
+    {
+      _index = 0;
+      if (_chunks.empty())
+        _cur = _end = (char*)NULL;
+      else
+        {
+          _cur = _chunks[0];
+          _end = _cur + _sizes[0];
+        }
+    }
+
+    /**
+     * Switch to the next chunk having room for n bytes.
+     * Chunks too small are skipped, a new one is allocated if none fits.
+     *
+     * @param n  number of bytes needed
+     */
+    void
+    Ast2DotArena::next_chunk(size_t n)
+    {
+      // Chunks after the current one (kept from before a reset)
+      size_t next = _cur ? _index + 1 : 0;
+
+      while (next < _chunks.size() && _sizes[next] < n)
+        next++;
+
+      if (next == _chunks.size())
+        {
+          // Size of the new chunk
+          size_t size = n > _chunk_size ? n : _chunk_size;
+
+          _chunks.push_back(new char[size]);
+          _sizes.push_back(size);
+          _capacity += size;
+        }
+
+      _index = next;
+      _cur = _chunks[next];
+      _end = _cur + _sizes[next];
+    }
+
+  } // ! parser
+} // ! clang_ast2dot
@@ -0,0 +1,120 @@
+/**
+ * @file clang_ast_arena.h
+ *
+ */
+
+#ifndef _CLANG_AST_ARENA_H_
+#define _CLANG_AST_ARENA_H_
+
+/**
+ * C System headers
+ *
+ * string.h for memcpy
+ */
+#include <string.h>
+
+/**
+ * C++ System headers
+ *
+ * vector for the chunk list
+ */
+#include <vector>
+
+/**
+ * Boost headers
+ */
+#include <boost/utility/string_view.hpp>
+
+// Size of an arena chunk
+#define AST2DOT_ARENA_CHUNK_SIZE                (64 * 1024)
+
+namespace clang_ast2dot
+{
+    namespace parser
+    {
+        /*
+         * Bump allocator for the text of the vertices.
+         * Memory is taken from large chunks and is only given back all at
+         * once by reset(), the chunks being kept for the next allocations.
+         * So once the chunks are allocated, parsing does no heap allocation.
+         */
+        class Ast2DotArena
+        {
+          public:
+
+            /*
+             * Arena explicit constructor
+             */
+            Ast2DotArena(size_t chunk_size = AST2DOT_ARENA_CHUNK_SIZE);
+
+            /*
+             * Arena destructor (free all chunks)
+             */
+            virtual ~Ast2DotArena(void);
+
+            /*
+             * Allocate n bytes
+             */
+            char* allocate(size_t n)
+            {
+              if ((size_t)(_end - _cur) < n)
+                next_chunk(n);
+              char* p = _cur;
+              _cur += n;
+              return p;
+            }
+
+            /*
+             * Copy a string in the arena
+             */
+            boost::string_view copy(boost::string_view const& str)
+            {
+              char* p = allocate(str.size());
+              memcpy(p, str.data(), str.size());
+              return boost::string_view(p, str.size());
+            }
+
+            /*
+             * Give back all memory (chunks are kept)
+             */
+            void reset(void);
+
+            /* Number of chunks allocated */
+            size_t chunks(void) const { return _chunks.size(); }
+
+            /* Bytes allocated from the heap */
+            size_t capacity(void) const { return _capacity; }
+
+          private:
+
+            /*
+             * Go to next chunk (allocating it if needed) for n bytes
+             */
+            void next_chunk(size_t n);
+
+            // Chunks
+            std::vector<char*> _chunks;
+
+            // Chunk sizes
+            std::vector<size_t> _sizes;
+
+            // Current chunk index
+            size_t _index;
+
+            // Current position
+            char* _cur;
+
+            // End of current chunk
+            char* _end;
+
+            // Default chunk size
+            size_t _chunk_size;
+
+            // Total size of the chunks
+            size_t _capacity;
+        };
+
+    } // ! namespace parser
+} // ! namespace clang_ast2dot
+
+#endif /* ! _CLANG_AST_ARENA_H_ */
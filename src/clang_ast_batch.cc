@@ -0,0 +1,375 @@
+/**
+ * @file clang_ast_batch.cc
+ */
+
+/**
+ * C System headers
+ *
+ * fcntl.h, unistd.h, dirent.h & sys/stat.h for the dumps and dot files
+ */
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+/**
+ * C++ System headers
+ *
+ * thread & mutex for the workers, chrono for the wall times
+ * algorithm for sorting a directory
+ */
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+// Include our defs
+#include "clang_ast_batch.h"
+#include "clang_ast_emitter.h"
+#include "clang_ast_dedupe.h"
+#include "clang_ast_xref.h"
+#include "clang_ast_decompress.h"
+#include "clang_ast_stats.h"
+
+namespace clang_ast2dot
+{
+  namespace parser
+  {
+    /**
+     * Shared state of a batch
+     */
+    struct Ast2DotBatchState
+    {
+      std::vector<Ast2DotBatch::Item>* items;
+
+      // Next dump to take
+      size_t next;
+
+      std::mutex mutex;
+    };
+
+    /**
+     * Worker: take the dumps in order and convert them with its own
+     * parser and graph
+     *
+     * @param batch  batch converting the dumps
+     * @param st     batch state
+     */
+    static void
+    work(Ast2DotBatch const* batch, Ast2DotBatchState* st)
+    {
+      Ast2DotStats::Merge merge;
+      Ast2DotParser parser;
+      Ast2DotGraph graph(parser.symbols());
+
+      batch->setup(parser);
+
+      for (;;)
+        {
+          // Dump taken
+          size_t k;
+
+          {
+            std::unique_lock<std::mutex> lock(st->mutex);
+
+            if (st->next >= st->items->size())
+              return;
+            k = st->next++;
+          }
+
+          batch->convert((*st->items)[k], parser, graph);
+        }
+    }
+
+    /**
+     * Ast2DotBatch Constructor
+     *
+     * @param jobs  number of workers
+     */
+    Ast2DotBatch::Ast2DotBatch(unsigned jobs)
+      : _jobs(jobs ? jobs : 1),
+        _filter((Ast2DotFilter const*) NULL),
+        _max_depth(-1),
+        _dedupe(false),
+        _xref_refs(false),
+        _xref_redecls(false),
+        _files(0),
+        _failed(0),
+        _vertices(0),
+        _bytes_in(0),
+        _bytes_out(0),
+        _seconds(0)
+    {
+    }
+
+    /**
+     * Ast2DotBatch Destructor
+     */
+    Ast2DotBatch::~Ast2DotBatch()
+    {
+    }
+
+    /**
+     * List the dumps of a list file, one path per line (empty lines and
+     * lines starting with # skipped), or the regular files of a directory
+     * but the dot files, sorted by name
+     *
+     * @param path     list file or directory
+     * @param out_dir  directory of the dot files (empty for next to the dumps)
+     * @param items    set to the dumps
+     *
+     * @throw ListException if the list cannot be read
+     *
+     * @return number of dumps
+     */
+    size_t
+    Ast2DotBatch::list(std::string const& path, std::string const& out_dir, std::vector<Item>& items)
+    {
+      std::vector<std::string> inputs;
+      struct stat st;
+
+      if (::stat(path.c_str(), &st) != 0)
+        throw ListException(path);
+
+      if (S_ISDIR(st.st_mode))
+        {
+          DIR* dir = ::opendir(path.c_str());
+          struct dirent* entry;
+          static const std::string suffix(AST2DOT_BATCH_OUTPUT_SUFFIX);
+
+          if (!dir)
+            throw ListException(path);
+
+          while ((entry = ::readdir(dir)) != NULL)
+            {
+              std::string name(entry->d_name);
+              std::string file = std::string(path).append("/").append(name);
+
+              if (name.size() >= suffix.size() &&
+                  name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0)
+                continue;
+              if (::stat(file.c_str(), &st) == 0 && S_ISREG(st.st_mode))
+                inputs.push_back(file);
+            }
+          ::closedir(dir);
+
+          std::sort(inputs.begin(), inputs.end());
+        }
+
+      else
+        {
+          std::ifstream ifs(path.c_str(), std::ifstream::in);
+          std::string line;
+
+          if (!ifs.is_open())
+            throw ListException(path);
+
+          while (std::getline(ifs, line))
+            if (!line.empty() && line[0] != '#')
+              inputs.push_back(line);
+        }
+
+      items.clear();
+      for (size_t k = 0; k < inputs.size(); k++)
+        {
+          Item item;
+          size_t slash = inputs[k].rfind('/');
+
+          item.input = inputs[k];
+          if (out_dir.empty())
+            item.output = inputs[k];
+          else
+            item.output = std::string(out_dir).append("/").append(
+              slash == std::string::npos ? inputs[k] : inputs[k].substr(slash + 1));
+          item.output.append(AST2DOT_BATCH_OUTPUT_SUFFIX);
+          item.ok = false;
+          item.vertices = 0;
+          item.bytes_in = 0;
+          item.bytes_out = 0;
+          item.seconds = 0;
+          items.push_back(item);
+        }
+
+      return items.size();
+    }
+
+    /**
+     * Convert the dumps of a list with the workers, then sum their
+     * counters
+     *
+     * @param items  dumps, set to their conversion
+     *
+     * @return number of dumps converted without error
+     */
+    size_t
+    Ast2DotBatch::convert(std::vector<Item>& items)
+    {
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      Ast2DotBatchState st;
+      std::vector<std::thread> workers;
+
+      st.items = &items;
+      st.next = 0;
+
+      for (unsigned j = 0; j < _jobs && j < items.size(); j++)
+        workers.push_back(std::thread(work, this, &st));
+      for (size_t j = 0; j < workers.size(); j++)
+        workers[j].join();
+
+      _files = items.size();
+      _failed = 0;
+      _vertices = 0;
+      _bytes_in = 0;
+      _bytes_out = 0;
+      for (size_t k = 0; k < items.size(); k++)
+        {
+          if (!items[k].ok)
+            _failed++;
+          _vertices += items[k].vertices;
+          _bytes_in += items[k].bytes_in;
+          _bytes_out += items[k].bytes_out;
+        }
+      _seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+      return _files - _failed;
+    }
+
+    /**
+     * Convert one dump: parse it in the graph of the worker, then emit it
+     * in its dot file
+     *
+     * @param item    dump, set to its conversion
+     * @param parser  parser of the worker
+     * @param graph   graph of the worker (cleared)
+     *
+     * @return false on error
+     */
+    bool
+    Ast2DotBatch::convert(Item& item, Ast2DotParser& parser, Ast2DotGraph& graph) const
+    {
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      Ast2DotInput* in = (Ast2DotInput*) NULL;
+      Ast2DotMmapInput* map = (Ast2DotMmapInput*) NULL;
+      std::ifstream ifs;
+      int fd = -1;
+
+      item.ok = false;
+      item.vertices = 0;
+      item.bytes_in = 0;
+      item.bytes_out = 0;
+
+      try
+        {
+          // Regular dumps are mapped in memory (and decompressed while
+          // parsed if compressed), others read by blocks
+          if (Ast2DotMmapInput::is_mappable(item.input))
+            {
+              Ast2DotDecompressInput::Format format;
+
+              in = map = new Ast2DotMmapInput(item.input);
+              format = Ast2DotDecompressInput::detect(map->data(), map->size());
+              if (format != Ast2DotDecompressInput::NONE)
+                in = new Ast2DotDecompressInput(map->data(), map->size(), format);
+            }
+          else
+            {
+              ifs.open(item.input.c_str(), std::ifstream::in);
+              if (!ifs.is_open())
+                throw Ast2DotInput::OpenException(item.input);
+              in = new Ast2DotStreamInput(&ifs);
+            }
+
+          fd = ::open(item.output.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+          if (fd < 0)
+            throw Ast2DotOutput::WriteException();
+
+          Ast2DotOutput out(fd);
+
+          item.vertices = convert(in, &out, parser, graph);
+          out.flush();
+
+          item.bytes_in = in->consumed();
+          item.bytes_out = out.bytes();
+          item.ok = true;
+        }
+      catch (std::exception const& e)
+        {
+          std::cerr << "[batch] ** Error! '" << item.input << "' to '" << item.output << "': " << e.what() << "\n";
+        }
+
+      if (in != map)
+        delete in;
+      delete map;
+      if (fd >= 0)
+        ::close(fd);
+
+      item.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+      return item.ok;
+    }
+
+    /**
+     * Set the filter and max depth of the parser of a worker
+     *
+     * @param parser  parser of the worker
+     */
+    void
+    Ast2DotBatch::setup(Ast2DotParser& parser) const
+    {
+      parser.set_max_depth(_max_depth);
+      if (_filter)
+        parser.set_filter(*_filter);
+    }
+
+    /**
+     * Convert one dump: parse it in the graph of the worker, then emit it
+     * with the emitter of the settings
+     *
+     * @param in      input of the dump
+     * @param out     output of the dot file (not flushed)
+     * @param parser  parser of the worker
+     * @param graph   graph of the worker (cleared)
+     *
+     * @throw Ast2DotOutput::WriteException on write error
+     *
+     * @return number of vertices
+     */
+    size_t
+    Ast2DotBatch::convert(Ast2DotInput* in, Ast2DotOutput* out, Ast2DotParser& parser, Ast2DotGraph& graph) const
+    {
+      Ast2DotEmitter emitter(out);
+      Ast2DotDedupeEmitter dedupe_emitter(out);
+      Ast2DotXref xrefs;
+      // Number of vertices
+      size_t vertices;
+
+      graph.clear();
+      // Dumps start out of any file
+      parser.filter().set_file(std::string());
+
+      if (_xref_refs || _xref_redecls)
+        {
+          xrefs.enable(Ast2DotXref::REFERENCE, _xref_refs);
+          xrefs.enable(Ast2DotXref::PREV, _xref_redecls);
+          xrefs.enable(Ast2DotXref::PARENT, _xref_redecls);
+          emitter.set_xref(&xrefs);
+          dedupe_emitter.set_xref(&xrefs);
+        }
+
+      vertices = parser.read_graph(in, graph);
+
+      out->write("digraph {\n");
+      if (_dedupe)
+        dedupe_emitter.emit(graph);
+      else
+        emitter.emit(graph);
+      xrefs.finish();
+      out->write("}\n");
+
+      return vertices;
+    }
+
+  } // ! parser
+} // ! clang_ast2dot
@@ -0,0 +1,168 @@
+/**
+ * @file clang_ast_batch.h
+ *
+ */
+
+#ifndef _CLANG_AST_BATCH_H_
+#define _CLANG_AST_BATCH_H_
+
+/**
+ * C++ System headers
+ *
+ * stdexcept for the list errors
+ * vector for the list of dumps
+ */
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+ * Own headers
+ */
+#include "clang_ast_parser.h"
+#include "clang_ast_graph.h"
+#include "clang_ast_output.h"
+#include "clang_ast_filter.h"
+
+// Suffix of the dot files (dumps with it are not listed from a directory)
+#define AST2DOT_BATCH_OUTPUT_SUFFIX             ".dot"
+
+namespace clang_ast2dot
+{
+    namespace parser
+    {
+        /*
+         * Conversion of many dumps in one process (one dump per translation
+         * unit of a build).
+         *
+         * The dumps are taken in list order by a pool of workers, each one
+         * with its own parser and graph, reused from one dump to the next
+         * (the symbols interned by a dump are there for the next ones). Each
+         * dump is converted as a single threaded conversion would, to its
+         * own dot file.
+         */
+        class Ast2DotBatch
+        {
+          public:
+
+            /*
+             * Dump of the batch, and its conversion
+             */
+            struct Item
+            {
+              // Dump and dot file
+              std::string input;
+              std::string output;
+
+              // Converted without error
+              bool ok;
+
+              // Vertices, bytes read and written
+              size_t vertices;
+              unsigned long long bytes_in;
+              unsigned long long bytes_out;
+
+              // Wall time (s)
+              double seconds;
+            };
+
+            /*
+             * Batch explicit constructor
+             */
+            Ast2DotBatch(unsigned jobs);
+
+            /*
+             * Batch destructor
+             */
+            virtual ~Ast2DotBatch(void);
+
+            /*
+             * List the dumps of a list file (one path per line) or of a
+             * directory (its regular files, sorted), with their dot file in
+             * an output directory (next to the dump if empty)
+             */
+            static size_t list(std::string const&, std::string const&, std::vector<Item>&);
+
+            /*
+             * Convert the dumps of a list (returns the number of dumps converted)
+             */
+            virtual size_t convert(std::vector<Item>&);
+
+            /*
+             * Convert one dump with the parser and graph of a worker
+             */
+            bool convert(Item&, Ast2DotParser&, Ast2DotGraph&) const;
+
+            /*
+             * Convert one dump from an input to a dot output, with the parser
+             * and graph of a worker (returns the number of vertices)
+             */
+            size_t convert(Ast2DotInput*, Ast2DotOutput*, Ast2DotParser&, Ast2DotGraph&) const;
+
+            /*
+             * Set the filter and max depth of the parser of a worker
+             */
+            void setup(Ast2DotParser&) const;
+
+            /* Number of workers */
+            unsigned jobs(void) const { return _jobs; }
+
+            /* Subtree filter of the parsers */
+            void set_filter(Ast2DotFilter const* filter) { _filter = filter; }
+
+            /* Max depth of the parsers */
+            void set_max_depth(int depth) { _max_depth = depth; }
+
+            /* Emit identical subtrees once */
+            void set_dedupe(bool dedupe) { _dedupe = dedupe; }
+
+            /* Cross-reference and redeclaration edges */
+            void set_xref(bool refs, bool redecls) { _xref_refs = refs; _xref_redecls = redecls; }
+
+            /* Totals of the last conversion */
+            size_t files(void) const { return _files; }
+            size_t failed(void) const { return _failed; }
+            size_t vertices(void) const { return _vertices; }
+            unsigned long long bytes_in(void) const { return _bytes_in; }
+            unsigned long long bytes_out(void) const { return _bytes_out; }
+            double seconds(void) const { return _seconds; }
+
+            /*
+             * Error while reading the list of dumps
+             */
+            class ListException : public ::std::runtime_error
+            {
+              public:
+              ListException(std::string const& path) : ::std::runtime_error(std::string("Cannot read dump list '").append(path).append("'")) {};
+                virtual ~ListException() {};
+            };
+
+          private:
+
+            // Number of workers
+            unsigned _jobs;
+
+            // Subtree filter (none if NULL)
+            Ast2DotFilter const* _filter;
+
+            // Max depth (-1 for all)
+            int _max_depth;
+
+            // Emitter settings
+            bool _dedupe;
+            bool _xref_refs;
+            bool _xref_redecls;
+
+            // Totals of the last conversion
+            size_t _files;
+            size_t _failed;
+            size_t _vertices;
+            unsigned long long _bytes_in;
+            unsigned long long _bytes_out;
+            double _seconds;
+        };
+
+    } // ! namespace parser
+} // ! namespace clang_ast2dot
+
+#endif /* ! _CLANG_AST_BATCH_H_ */
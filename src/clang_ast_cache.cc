@@ -0,0 +1,267 @@
+/**
+ * @file clang_ast_cache.cc
+ */
+
+/**
+ * C System headers
+ *
+ * string.h for memcmp/memset
+ * fcntl.h, unistd.h, sys/stat.h & sys/mman.h for mapping the cache file
+ */
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+// Include our defs
+#include "clang_ast_cache.h"
+
+namespace clang_ast2dot
+{
+  namespace parser
+  {
+    /**
+     * Size of the items of the node table sections
+     */
+    static const size_t column_items[Ast2DotCache::POOL] =
+      {
+        sizeof(Ast2DotGraph::Index),
+        sizeof(Ast2DotGraph::Index),
+        sizeof(Ast2DotGraph::Index),
+        sizeof(Ast2DotSymbols::Id),
+        sizeof(uint64_t),
+        sizeof(uint64_t),
+        sizeof(unsigned char)
+      };
+
+    /**
+     * Offset aligned for the next section
+     */
+    static inline uint64_t
+    align(uint64_t offset)
+    {
+      return (offset + AST2DOT_CACHE_ALIGN - 1) & ~(uint64_t)(AST2DOT_CACHE_ALIGN - 1);
+    }
+
+    /**
+     * Ast2DotCache Constructor
+     *
+     * @param path  path of the cache file
+     *
+     * @throw OpenException if file cannot be open or mapped
+     */
+    Ast2DotCache::Ast2DotCache(std::string const& path)
+      : _map(MAP_FAILED),
+        _size(0)
+    {
+      // Cache file descriptor
+      int fd = ::open(path.c_str(), O_RDONLY);
+      // File status
+      struct stat st;
+
+      if (fd < 0)
+        throw OpenException(path);
+
+      if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0)
+        {
+          ::close(fd);
+          throw OpenException(path);
+        }
+
+      _size = st.st_size;
+
+      // Pages are loaded as the nodes are read
+      _map = ::mmap(NULL, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+      ::close(fd);
+      if (_map == MAP_FAILED)
+        throw OpenException(path);
+    }
+
+    /**
+     * Ast2DotCache Destructor
+     */
+    Ast2DotCache::~Ast2DotCache()
+    {
+      if (_map != MAP_FAILED)
+        ::munmap(_map, _size);
+    }
+
+    /**
+     * Attach a graph to the mapped file
+     *
+     * @param symbols  symbol table of the graph (known symbols only)
+     * @param graph    graph reading the nodes of the file
+     *
+     * @throw FormatException if the file is not a valid cache
+     */
+    void
+    Ast2DotCache::load(Ast2DotSymbols& symbols, Ast2DotGraph& graph) const
+    {
+      load((const char*) _map, _size, symbols, graph);
+    }
+
+    /**
+     * Attach a graph to a cache in memory: the header and sections are
+     * checked, the interned symbols are interned again, then the nodes
+     * are checked
+     *
+     * @param data     cache (aligned on 8 bytes)
+     * @param size     size of the cache
+     * @param symbols  symbol table of the graph (known symbols only)
+     * @param graph    graph reading the nodes of the cache
+     *
+     * @throw FormatException if the data is not a valid cache
+     */
+    void
+    Ast2DotCache::load(const char* data, size_t size, Ast2DotSymbols& symbols, Ast2DotGraph& graph)
+    {
+      // File header
+      Header header;
+      // Node table columns and pool
+      Ast2DotGraph::Columns columns;
+      // Position in the symbols section
+      uint64_t pos;
+
+      if (size < sizeof(header))
+        throw FormatException("truncated header");
+
+      memcpy(&header, data, sizeof(header));
+      if (memcmp(header.magic, AST2DOT_CACHE_MAGIC, sizeof(header.magic)) != 0)
+        throw FormatException("bad magic");
+      if (header.version != AST2DOT_CACHE_VERSION || header.order != AST2DOT_CACHE_ORDER ||
+          header.known != Ast2DotSymbols::known())
+        throw FormatException("other version or host");
+      if (header.size != size || header.nodes >= Ast2DotGraph::NONE)
+        throw FormatException("bad size");
+
+      for (int s = 0; s < SECTIONS; s++)
+        {
+          uint64_t len = s < POOL ? header.nodes * column_items[s] : s == POOL ? header.pool_size : 0;
+
+          if (header.offsets[s] % AST2DOT_CACHE_ALIGN || header.offsets[s] > size ||
+              len > size - header.offsets[s])
+            throw FormatException("bad section");
+        }
+
+      if (symbols.size() != Ast2DotSymbols::known())
+        throw FormatException("symbols already interned");
+
+      // Interned symbols, as length and text, in ID order
+      pos = header.offsets[SYMBOLS];
+      for (uint64_t n = 0; n < header.symbols; n++)
+        {
+          uint32_t len;
+
+          if (size - pos < sizeof(len))
+            throw FormatException("truncated symbols");
+          memcpy(&len, data + pos, sizeof(len));
+          pos += sizeof(len);
+          if (size - pos < len)
+            throw FormatException("truncated symbols");
+          if (symbols.intern(boost::string_view(data + pos, len)) != Ast2DotSymbols::known() + n)
+            throw FormatException("symbols not interned again");
+          pos += len;
+        }
+
+      columns.size = header.nodes;
+      columns.parent = (const Ast2DotGraph::Index*) (data + header.offsets[PARENT]);
+      columns.first_child = (const Ast2DotGraph::Index*) (data + header.offsets[FIRST_CHILD]);
+      columns.next_sibling = (const Ast2DotGraph::Index*) (data + header.offsets[NEXT_SIBLING]);
+      columns.kind = (const Ast2DotSymbols::Id*) (data + header.offsets[KIND]);
+      columns.address = (const uint64_t*) (data + header.offsets[ADDRESS]);
+      columns.props = (const uint64_t*) (data + header.offsets[PROPS]);
+      columns.flags = (const unsigned char*) (data + header.offsets[FLAGS]);
+      columns.pool = data + header.offsets[POOL];
+      columns.pool_size = header.pool_size;
+
+      // Nodes checked as they are read
+      graph.attach(columns, true);
+    }
+
+    /**
+     * Write the cache of a graph: header, columns, pool and interned
+     * symbols (the sections offsets are known from the sizes)
+     *
+     * @param graph  graph to save
+     * @param out    output of the cache file
+     *
+     * @throw Ast2DotOutput::WriteException on write error
+     */
+    void
+    Ast2DotCache::save(Ast2DotGraph const& graph, Ast2DotOutput* out)
+    {
+      Ast2DotGraph::Columns const& columns = graph.columns();
+      Ast2DotSymbols const& symbols = graph.symbols();
+      // Start of the sections
+      const char* sections[POOL + 1];
+      // Padding between sections
+      static const char zeros[AST2DOT_CACHE_ALIGN] = { 0 };
+      // File header
+      Header header;
+      // Current offset
+      uint64_t offset;
+
+      memset(&header, 0, sizeof(header));
+      memcpy(header.magic, AST2DOT_CACHE_MAGIC, sizeof(header.magic));
+      header.version = AST2DOT_CACHE_VERSION;
+      header.order = AST2DOT_CACHE_ORDER;
+      header.known = Ast2DotSymbols::known();
+      header.nodes = columns.size;
+      header.pool_size = columns.pool_size;
+      header.symbols = symbols.size() - Ast2DotSymbols::known();
+
+      sections[PARENT] = (const char*) columns.parent;
+      sections[FIRST_CHILD] = (const char*) columns.first_child;
+      sections[NEXT_SIBLING] = (const char*) columns.next_sibling;
+      sections[KIND] = (const char*) columns.kind;
+      sections[ADDRESS] = (const char*) columns.address;
+      sections[PROPS] = (const char*) columns.props;
+      sections[FLAGS] = (const char*) columns.flags;
+      sections[POOL] = columns.pool;
+
+      offset = align(sizeof(header));
+      for (int s = 0; s < SECTIONS; s++)
+        {
+          header.offsets[s] = offset;
+          if (s < POOL)
+            offset = align(offset + columns.size * column_items[s]);
+          else if (s == POOL)
+            offset = align(offset + columns.pool_size);
+        }
+
+      // Symbols section last, unaligned end
+      header.size = offset;
+      for (Ast2DotSymbols::Id id = Ast2DotSymbols::known(); id < symbols.size(); id++)
+        header.size += sizeof(uint32_t) + symbols.text(id).size();
+
+      out->write((const char*) &header, sizeof(header));
+      offset = sizeof(header);
+      for (int s = 0; s < SECTIONS; s++)
+        {
+          out->write(zeros, header.offsets[s] - offset);
+          offset = header.offsets[s];
+          if (s < POOL)
+            {
+              out->write(sections[s], columns.size * column_items[s]);
+              offset += columns.size * column_items[s];
+            }
+          else if (s == POOL)
+            {
+              out->write(sections[s], columns.pool_size);
+              offset += columns.pool_size;
+            }
+        }
+
+      for (Ast2DotSymbols::Id id = Ast2DotSymbols::known(); id < symbols.size(); id++)
+        {
+          boost::string_view text = symbols.text(id);
+          uint32_t len = text.size();
+
+          out->write((const char*) &len, sizeof(len));
+          out->write(text);
+        }
+    }
+
+  } // ! parser
+} // ! clang_ast2dot
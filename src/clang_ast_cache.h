@@ -0,0 +1,161 @@
+/**
+ * @file clang_ast_cache.h
+ *
+ */
+
+#ifndef _CLANG_AST_CACHE_H_
+#define _CLANG_AST_CACHE_H_
+
+/**
+ * C System headers
+ *
+ * stdint.h for the fixed size header fields
+ */
+#include <stdint.h>
+
+/**
+ * C++ System headers
+ *
+ * stdexcept for the open and format errors
+ */
+#include <stdexcept>
+#include <string>
+
+/**
+ * Own headers
+ */
+#include "clang_ast_graph.h"
+#include "clang_ast_output.h"
+#include "clang_ast_symbols.h"
+
+// Magic of the graph cache files
+#define AST2DOT_CACHE_MAGIC                     "A2DC"
+
+// Version of the graph cache format (changed with any layout change)
+#define AST2DOT_CACHE_VERSION                   1
+
+// Byte order mark, as written by the host
+#define AST2DOT_CACHE_ORDER                     0x01020304
+
+// Alignment of the sections
+#define AST2DOT_CACHE_ALIGN                     8
+
+namespace clang_ast2dot
+{
+    namespace parser
+    {
+        /*
+         * Binary cache of an AST graph (.a2d), to emit a dump again without
+         * parsing it.
+         *
+         * The file is the header followed by the node table columns, the
+         * pool and the interned symbols, each section at an aligned offset
+         * given in the header. The columns are the ones of Ast2DotGraph as is
+         * (parent, first child and next sibling are the edge lists, the pool
+         * is indexed by offsets), so a mapped cache is read in place: only
+         * the pages of the nodes emitted are loaded. Interned symbols are
+         * interned again in the same order, to keep their IDs.
+         *
+         * The header and the section bounds are checked at load time, and
+         * each node (edges, symbols and props within the pool) on its first
+         * access by the graph, so that a bad file is rejected rather than
+         * read out of bounds. Load time is so not the one of the whole node
+         * table, but a bad node is only found while emitting.
+         */
+        class Ast2DotCache
+        {
+          public:
+
+            /*
+             * Sections of the file
+             */
+            enum Section
+              {
+                PARENT = 0,
+                FIRST_CHILD,
+                NEXT_SIBLING,
+                KIND,
+                ADDRESS,
+                PROPS,
+                FLAGS,
+                POOL,
+                SYMBOLS,
+                SECTIONS
+              };
+
+            /*
+             * File header
+             */
+            struct Header
+            {
+              char magic[4];
+              uint32_t version;
+              uint32_t order;
+              uint32_t known;
+              uint64_t nodes;
+              uint64_t pool_size;
+              uint64_t symbols;
+              uint64_t size;
+              uint64_t offsets[SECTIONS];
+            };
+
+            /*
+             * Cache explicit constructor, mapping a cache file
+             */
+            Ast2DotCache(std::string const&);
+
+            /*
+             * Cache destructor (unmap the file)
+             */
+            virtual ~Ast2DotCache(void);
+
+            /*
+             * Attach the graph to the mapped columns, interning the symbols
+             * in a table with known symbols only (valid while mapped)
+             */
+            void load(Ast2DotSymbols&, Ast2DotGraph&) const;
+
+            /*
+             * Same for a cache in memory
+             */
+            static void load(const char*, size_t, Ast2DotSymbols&, Ast2DotGraph&);
+
+            /*
+             * Write the cache of a graph
+             */
+            static void save(Ast2DotGraph const&, Ast2DotOutput*);
+
+            /* Size of the mapped file */
+            size_t size(void) const { return _size; }
+
+            /*
+             * Error while opening or mapping the cache file
+             */
+            class OpenException : public ::std::runtime_error
+            {
+              public:
+              OpenException(std::string const& path) : ::std::runtime_error(std::string("Cannot open cache '").append(path).append("'")) {};
+                virtual ~OpenException() {};
+            };
+
+            /*
+             * Not a cache of this version, or truncated
+             */
+            class FormatException : public ::std::runtime_error
+            {
+              public:
+              FormatException(std::string const& what) : ::std::runtime_error(std::string("Invalid cache: ").append(what)) {};
+                virtual ~FormatException() {};
+            };
+
+          private:
+
+            // Mapped file
+            void* _map;
+            size_t _size;
+        };
+
+    } // ! namespace parser
+} // ! namespace clang_ast2dot
+
+#endif /* ! _CLANG_AST_CACHE_H_ */
@@ -0,0 +1,345 @@
+/**
+ * @file clang_ast_compress.cc
+ */
+
+/**
+ * C System headers
+ *
+ * string.h for memset
+ */
+#include <string.h>
+
+/**
+ * C++ System headers
+ *
+ * iostream for the errors of a compressed stream not finished
+ */
+#include <iostream>
+
+/**
+ * zlib for gzip output, zstd for zstd output (when built with them)
+ */
+#ifdef AST2DOT_WITH_ZLIB
+#include <zlib.h>
+#endif
+#ifdef AST2DOT_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+// Include our defs
+#include "clang_ast_compress.h"
+#include "clang_ast_stats.h"
+
+namespace clang_ast2dot
+{
+  namespace parser
+  {
+    /**
+     * Ast2DotCompressOutput Constructor
+     *
+     * @param fd      file descriptor of the compressed dot file
+     * @param format  compression format
+     * @param size    size of the output buffer (and of the blocks compressed)
+     */
+    Ast2DotCompressOutput::Ast2DotCompressOutput(int fd, Format format, size_t size)
+      : Ast2DotOutput(fd, size),
+        _format(format),
+        _compressed(0),
+        _finish(false),
+        _done(false)
+    {
+      _thread = std::thread(&Ast2DotCompressOutput::compress, this);
+    }
+
+    /**
+     * Ast2DotCompressOutput Destructor: the compressed stream is finished
+     * if it was not, errors are reported (nothing can be thrown)
+     */
+    Ast2DotCompressOutput::~Ast2DotCompressOutput()
+    {
+      try
+        {
+          finish();
+        }
+      catch (std::exception const& e)
+        {
+          std::cerr << "[compress] ** Error! compressed output not finished: " << e.what() << "\n";
+        }
+      catch (...)
+        {
+          std::cerr << "[compress] ** Error! compressed output not finished\n";
+        }
+
+      // Nothing left for the base class to write uncompressed
+      reset(-1);
+    }
+
+    /**
+     * Format of an output file from its suffix
+     *
+     * @param path  output file
+     *
+     * @return GZIP for .gz, ZSTD for .zst, NONE otherwise
+     */
+    Ast2DotCompressOutput::Format
+    Ast2DotCompressOutput::detect(std::string const& path)
+    {
+      if (path.size() > 3 && path.compare(path.size() - 3, 3, ".gz") == 0)
+        return Ast2DotDecompressInput::GZIP;
+      if (path.size() > 4 && path.compare(path.size() - 4, 4, ".zst") == 0)
+        return Ast2DotDecompressInput::ZSTD;
+
+      return Ast2DotDecompressInput::NONE;
+    }
+
+    /**
+     * Flush the output, then wait for the compression thread to compress
+     * the pending blocks and end the compressed stream
+     *
+     * @throw WriteException (or the error of the compression thread) if
+     *        the compressed dot file could not be written
+     */
+    void
+    Ast2DotCompressOutput::finish(void)
+    {
+      std::exception_ptr error;
+
+      if (!_thread.joinable())
+        return;
+
+      try
+        {
+          flush();
+        }
+      catch (...)
+        {
+          error = std::current_exception();
+        }
+
+      {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _finish = true;
+        _cond.notify_all();
+      }
+      _thread.join();
+
+      if (_error)
+        std::rethrow_exception(_error);
+      if (error)
+        std::rethrow_exception(error);
+    }
+
+    /**
+     * Hand a block of the output buffer to the compression thread, once
+     * it is less than the max blocks behind
+     *
+     * @throw WriteException (or the error of the compression thread) if
+     *        the compression stopped
+     */
+    void
+    Ast2DotCompressOutput::write_fd(const char* data, size_t len)
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+
+      while (!_done && _blocks.size() >= AST2DOT_COMPRESS_BLOCKS_IN_FLIGHT)
+        _cond.wait(lock);
+      if (_done || _finish)
+        {
+          if (_error)
+            std::rethrow_exception(_error);
+          throw WriteException();
+        }
+
+      _blocks.push_back(std::vector<char>());
+      if (!_free.empty())
+        {
+          _blocks.back().swap(_free.back());
+          _free.pop_back();
+        }
+      _blocks.back().assign(data, data + len);
+      _cond.notify_all();
+    }
+
+    /**
+     * Compression thread
+     */
+    void
+    Ast2DotCompressOutput::compress(void)
+    {
+      Ast2DotStats::Merge merge;
+
+      try
+        {
+          if (_format == Ast2DotDecompressInput::GZIP)
+            compress_gzip();
+          else if (_format == Ast2DotDecompressInput::ZSTD)
+            compress_zstd();
+          else
+            throw WriteException();
+        }
+      catch (...)
+        {
+          std::unique_lock<std::mutex> lock(_mutex);
+          _error = std::current_exception();
+        }
+
+      std::unique_lock<std::mutex> lock(_mutex);
+      _done = true;
+      _cond.notify_all();
+    }
+
+    /**
+     * Compress the blocks to a gzip member
+     */
+    void
+    Ast2DotCompressOutput::compress_gzip(void)
+    {
+#ifdef AST2DOT_WITH_ZLIB
+      z_stream z;
+      std::vector<char> block;
+      std::vector<char> out(AST2DOT_COMPRESS_WRITE_SIZE);
+
+      memset(&z, 0, sizeof(z));
+      // Window of 15 bits, gzip header
+      if (deflateInit2(&z, AST2DOT_COMPRESS_GZIP_LEVEL, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        throw WriteException();
+
+      try
+        {
+          bool more;
+
+          do
+            {
+              more = pop(block);
+              z.next_in = (Bytef*) (more ? &block[0] : NULL);
+              z.avail_in = more ? block.size() : 0;
+
+              // Until the block is consumed, or the stream ended
+              do
+                {
+                  z.next_out = (Bytef*) &out[0];
+                  z.avail_out = out.size();
+                  if (deflate(&z, more ? Z_NO_FLUSH : Z_FINISH) == Z_STREAM_ERROR)
+                    throw WriteException();
+                  if (out.size() > z.avail_out)
+                    write_compressed(&out[0], out.size() - z.avail_out);
+                }
+              while (z.avail_out == 0);
+            }
+          while (more);
+        }
+      catch (...)
+        {
+          deflateEnd(&z);
+          throw;
+        }
+
+      deflateEnd(&z);
+#else
+      throw WriteException();
+#endif
+    }
+
+    /**
+     * Compress the blocks to a zstd frame
+     */
+    void
+    Ast2DotCompressOutput::compress_zstd(void)
+    {
+#ifdef AST2DOT_WITH_ZSTD
+      ZSTD_CStream* z = ZSTD_createCStream();
+      std::vector<char> block;
+      std::vector<char> out(AST2DOT_COMPRESS_WRITE_SIZE);
+
+      if (!z || ZSTD_isError(ZSTD_initCStream(z, AST2DOT_COMPRESS_ZSTD_LEVEL)))
+        {
+          ZSTD_freeCStream(z);
+          throw WriteException();
+        }
+
+      try
+        {
+          // Bytes of the frame left to write: 0 once ended
+          size_t left = 0;
+
+          while (pop(block))
+            {
+              ZSTD_inBuffer in = { &block[0], block.size(), 0 };
+
+              while (in.pos < in.size)
+                {
+                  ZSTD_outBuffer o = { &out[0], out.size(), 0 };
+
+                  if (ZSTD_isError(ZSTD_compressStream(z, &o, &in)))
+                    throw WriteException();
+                  if (o.pos)
+                    write_compressed(&out[0], o.pos);
+                }
+            }
+
+          do
+            {
+              ZSTD_outBuffer o = { &out[0], out.size(), 0 };
+
+              left = ZSTD_endStream(z, &o);
+              if (ZSTD_isError(left))
+                throw WriteException();
+              if (o.pos)
+                write_compressed(&out[0], o.pos);
+            }
+          while (left);
+        }
+      catch (...)
+        {
+          ZSTD_freeCStream(z);
+          throw;
+        }
+
+      ZSTD_freeCStream(z);
+#else
+      throw WriteException();
+#endif
+    }
+
+    /**
+     * Next block to compress, the previous one being given back for reuse
+     *
+     * @param block  previous block, set to the next one
+     *
+     * @return false once finished and all blocks compressed
+     */
+    bool
+    Ast2DotCompressOutput::pop(std::vector<char>& block)
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+
+      if (block.capacity())
+        {
+          _free.push_back(std::vector<char>());
+          _free.back().swap(block);
+        }
+
+      while (_blocks.empty() && !_finish)
+        _cond.wait(lock);
+      if (_blocks.empty())
+        return false;
+
+      block.swap(_blocks.front());
+      _blocks.pop_front();
+      _cond.notify_all();
+
+      return true;
+    }
+
+    /**
+     * Write a compressed block to the file descriptor
+     */
+    void
+    Ast2DotCompressOutput::write_compressed(const char* data, size_t len)
+    {
+      Ast2DotOutput::write_fd(data, len);
+      _compressed += len;
+    }
+
+  } // ! parser
+} // ! clang_ast2dot
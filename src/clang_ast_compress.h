@@ -0,0 +1,131 @@
+/**
+ * @file clang_ast_compress.h
+ *
+ */
+
+#ifndef _CLANG_AST_COMPRESS_H_
+#define _CLANG_AST_COMPRESS_H_
+
+/**
+ * C++ System headers
+ *
+ * thread, mutex & condition_variable for the compression thread
+ * deque for the blocks to compress
+ * exception for the errors of the compression thread
+ */
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Own headers
+ */
+#include "clang_ast_output.h"
+#include "clang_ast_decompress.h"
+
+// Blocks of the output buffer waiting for the compression thread
+#define AST2DOT_COMPRESS_BLOCKS_IN_FLIGHT       4
+
+// Size of the compressed blocks written to the file descriptor
+#define AST2DOT_COMPRESS_WRITE_SIZE             (256 * 1024)
+
+// Compression levels: the dot syntax repeated by every vertex and edge
+// compresses well even at the fastest levels
+#define AST2DOT_COMPRESS_GZIP_LEVEL             1
+#define AST2DOT_COMPRESS_ZSTD_LEVEL             3
+
+namespace clang_ast2dot
+{
+    namespace parser
+    {
+        /*
+         * Output compressing the dot file (gzip or zstd) to a file descriptor.
+         *
+         * The blocks of the output buffer are handed to a thread of its own
+         * which compresses and writes them, so that compression overlaps
+         * the conversion. The compressed stream is complete once finished
+         * (on destruction at the latest).
+         */
+        class Ast2DotCompressOutput : public Ast2DotOutput
+        {
+          public:
+
+            /* Same formats as the compressed dumps */
+            typedef Ast2DotDecompressInput::Format Format;
+
+            /*
+             * Compress output explicit constructor
+             */
+            Ast2DotCompressOutput(int fd, Format, size_t size = AST2DOT_OUTPUT_BUFFER_SIZE);
+
+            /*
+             * Compress output destructor (finish the compressed stream)
+             */
+            virtual ~Ast2DotCompressOutput(void);
+
+            /*
+             * Flush, compress the pending blocks and end the compressed
+             * stream (nothing can be written after it)
+             */
+            void finish(void);
+
+            /*
+             * Format of an output file from its suffix (.gz or .zst)
+             */
+            static Format detect(std::string const&);
+
+            /* Compressed bytes written (complete once finished) */
+            unsigned long long compressed(void) const { return _compressed; }
+
+          protected:
+            virtual void write_fd(const char*, size_t);
+
+          private:
+
+            /*
+             * Compression thread: blocks compressed until finished
+             */
+            void compress(void);
+            void compress_gzip(void);
+            void compress_zstd(void);
+
+            /*
+             * Next block to compress (returns false once finished and all
+             * blocks compressed)
+             */
+            bool pop(std::vector<char>&);
+
+            /*
+             * Write a compressed block
+             */
+            void write_compressed(const char*, size_t);
+
+            // Format of the output
+            Format _format;
+
+            // Compressed bytes written
+            unsigned long long _compressed;
+
+            // Blocks to compress, and blocks to reuse
+            std::deque<std::vector<char> > _blocks;
+            std::vector<std::vector<char> > _free;
+
+            // No more blocks, and compression over (stream ended or error)
+            bool _finish;
+            bool _done;
+
+            // Compression error, thrown to the writer (none if null)
+            std::exception_ptr _error;
+
+            std::mutex _mutex;
+            std::condition_variable _cond;
+            std::thread _thread;
+        };
+
+    } // ! namespace parser
+} // ! namespace clang_ast2dot
+
+#endif /* ! _CLANG_AST_COMPRESS_H_ */
@@ -0,0 +1,474 @@
+/**
+ * @file clang_ast_decompress.cc
+ */
+
+/**
+ * C System headers
+ *
+ * string.h for memcmp/memcpy/memmove
+ */
+#include <string.h>
+
+/**
+ * zlib for gzip dumps, zstd for zstd dumps (when built with them)
+ */
+#ifdef AST2DOT_WITH_ZLIB
+#include <zlib.h>
+#endif
+#ifdef AST2DOT_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+// Include our defs
+#include "clang_ast_decompress.h"
+
+namespace clang_ast2dot
+{
+  namespace parser
+  {
+    /**
+     * Ast2DotDecompressInput Constructor for a compressed dump in memory
+     *
+     * @param data    compressed dump (mapped file)
+     * @param size    size of the compressed dump
+     * @param format  compression format
+     */
+    Ast2DotDecompressInput::Ast2DotDecompressInput(const char* data, size_t size, Format format)
+      : _format(format),
+        _data(data),
+        _size(size),
+        _is((std::istream*) NULL),
+        _compressed(0),
+        _buf(AST2DOT_INPUT_BUFFER_SIZE),
+        _done(false),
+        _stop(false)
+    {
+      _begin = _cur = _end = &_buf[0];
+      _thread = std::thread(&Ast2DotDecompressInput::decompress, this);
+    }
+
+    /**
+     * Ast2DotDecompressInput Constructor for a compressed stream
+     *
+     * @param is      stream of the compressed dump
+     * @param format  compression format
+     * @param magic   bytes of the dump already read from the stream
+     */
+    Ast2DotDecompressInput::Ast2DotDecompressInput(std::istream* is, Format format, std::string const& magic)
+      : _format(format),
+        _data((const char*) NULL),
+        _size(0),
+        _is(is),
+        _read(AST2DOT_DECOMPRESS_READ_SIZE),
+        _magic(magic),
+        _compressed(0),
+        _buf(AST2DOT_INPUT_BUFFER_SIZE),
+        _done(false),
+        _stop(false)
+    {
+      _begin = _cur = _end = &_buf[0];
+      _thread = std::thread(&Ast2DotDecompressInput::decompress, this);
+    }
+
+    /**
+     * Ast2DotDecompressInput Destructor
+     */
+    Ast2DotDecompressInput::~Ast2DotDecompressInput()
+    {
+      {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _stop = true;
+        _cond.notify_all();
+      }
+      _thread.join();
+    }
+
+    /**
+     * Format of a dump from its magic bytes
+     *
+     * @param data  start of the dump
+     * @param size  size of the dump
+     *
+     * @return GZIP, ZSTD or NONE
+     */
+    Ast2DotDecompressInput::Format
+    Ast2DotDecompressInput::detect(const char* data, size_t size)
+    {
+      if (size >= 2 && memcmp(data, "\x1f\x8b", 2) == 0)
+        return GZIP;
+      if (size >= 4 && memcmp(data, "\x28\xb5\x2f\xfd", 4) == 0)
+        return ZSTD;
+
+      return NONE;
+    }
+
+    /**
+     * Format of a stream from its magic bytes. A stream buffer cannot put
+     * back more than one byte, so the bytes are read and given back to be
+     * read first; they are read only while they can be a magic (a dump
+     * starting with '(' is told from zstd by its second byte).
+     *
+     * @param is     stream of the dump
+     * @param magic  set to the bytes read
+     *
+     * @return GZIP, ZSTD or NONE
+     */
+    Ast2DotDecompressInput::Format
+    Ast2DotDecompressInput::detect(std::istream* is, std::string& magic)
+    {
+      magic.clear();
+
+      while (magic.size() < 4)
+        {
+          int c = is->rdbuf()->sbumpc();
+
+          if (c == EOF)
+            break;
+          magic.push_back((char) c);
+
+          // Prefix of the gzip or zstd magic
+          bool gzip = magic.size() <= 2 && memcmp(magic.data(), "\x1f\x8b", magic.size()) == 0;
+          bool zstd = memcmp(magic.data(), "\x28\xb5\x2f\xfd", magic.size()) == 0;
+
+          if ((!gzip && !zstd) || (gzip && magic.size() == 2))
+            break;
+        }
+
+      return detect(magic.data(), magic.size());
+    }
+
+    /**
+     * Format supported by this build
+     */
+    bool
+    Ast2DotDecompressInput::supported(Format format)
+    {
+      switch (format)
+        {
+#ifdef AST2DOT_WITH_ZLIB
+        case GZIP:
+          return true;
+#endif
+#ifdef AST2DOT_WITH_ZSTD
+        case ZSTD:
+          return true;
+#endif
+        case NONE:
+          return true;
+        default:
+          return false;
+        }
+    }
+
+    /**
+     * Take the next decompressed block after the pending bytes.
+     * One char before _cur is kept for unget.
+     *
+     * @throw DecompressException if the dump is corrupted
+     */
+    bool
+    Ast2DotDecompressInput::refill(void)
+    {
+      std::vector<char> block;
+
+      {
+        std::unique_lock<std::mutex> lock(_mutex);
+
+        while (_blocks.empty() && !_done)
+          _cond.wait(lock);
+
+        if (_blocks.empty())
+          {
+            if (_error)
+              std::rethrow_exception(_error);
+            return false;
+          }
+
+        block.swap(_blocks.front());
+        _blocks.pop_front();
+      }
+
+      // Bytes kept in buffer (pending + one for unget)
+      size_t keep_from = (_cur > _begin) ? (_cur - _begin) - 1 : 0;
+      size_t kept = (_end - _begin) - keep_from;
+      size_t cur_off = (_cur - _begin) - keep_from;
+
+      if (keep_from)
+        memmove(&_buf[0], &_buf[keep_from], kept);
+      _consumed += keep_from;
+
+      // Grow buffer if a line hardly fits
+      while (kept + block.size() > _buf.size())
+        _buf.resize(_buf.size() * 2);
+      memcpy(&_buf[kept], &block[0], block.size());
+
+      _begin = &_buf[0];
+      _cur = _begin + cur_off;
+      _end = _begin + kept + block.size();
+
+      // Block given back for reuse
+      {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _free.push_back(std::vector<char>());
+        _free.back().swap(block);
+        _cond.notify_all();
+      }
+
+      return true;
+    }
+
+    /**
+     * Decompression thread
+     */
+    void
+    Ast2DotDecompressInput::decompress(void)
+    {
+      try
+        {
+          if (_format == GZIP)
+            decompress_gzip();
+          else if (_format == ZSTD)
+            decompress_zstd();
+          else
+            throw DecompressException("unknown format");
+        }
+      catch (...)
+        {
+          std::unique_lock<std::mutex> lock(_mutex);
+          _error = std::current_exception();
+        }
+
+      std::unique_lock<std::mutex> lock(_mutex);
+      _done = true;
+      _cond.notify_all();
+    }
+
+    /**
+     * Decompress gzip members (or zlib streams) until the end of the source
+     */
+    void
+    Ast2DotDecompressInput::decompress_gzip(void)
+    {
+#ifdef AST2DOT_WITH_ZLIB
+      z_stream z;
+      std::vector<char> block(AST2DOT_DECOMPRESS_BLOCK_SIZE);
+      // Compressed bytes
+      const char* in;
+      size_t in_len = 0;
+      // Compressed bytes given to inflate
+      size_t slice;
+      // A member is being decompressed
+      bool member = false;
+      // Output block filled: more output may come without input
+      bool more = false;
+
+      memset(&z, 0, sizeof(z));
+      // Window of 15 bits, gzip or zlib header
+      if (inflateInit2(&z, 15 + 32) != Z_OK)
+        throw DecompressException("zlib initialization");
+
+      z.next_out = (Bytef*) &block[0];
+      z.avail_out = block.size();
+
+      for (;;)
+        {
+          int ret;
+
+          if (!in_len && !more && !source(in, in_len))
+            break;
+
+          // Slices of a mapped dump: avail_in is 32 bits
+          slice = in_len < AST2DOT_DECOMPRESS_READ_SIZE ? in_len : AST2DOT_DECOMPRESS_READ_SIZE;
+          z.next_in = (Bytef*) in;
+          z.avail_in = slice;
+          if (in_len)
+            member = true;
+          ret = inflate(&z, Z_NO_FLUSH);
+          in += slice - z.avail_in;
+          in_len -= slice - z.avail_in;
+          more = z.avail_out == 0;
+
+          if (ret == Z_STREAM_END)
+            {
+              // Next member, if any
+              inflateReset(&z);
+              member = false;
+            }
+          else if (ret != Z_OK && ret != Z_BUF_ERROR)
+            {
+              std::string error(z.msg ? z.msg : "corrupted gzip data");
+
+              inflateEnd(&z);
+              throw DecompressException(error);
+            }
+
+          if (z.avail_out == 0)
+            {
+              if (!push(block))
+                break;
+              z.next_out = (Bytef*) &block[0];
+              z.avail_out = block.size();
+            }
+        }
+
+      inflateEnd(&z);
+
+      block.resize(block.size() - z.avail_out);
+      if (!block.empty())
+        push(block);
+
+      if (member)
+        throw DecompressException("truncated gzip data");
+#else
+      throw DecompressException("gzip support not built");
+#endif
+    }
+
+    /**
+     * Decompress zstd frames until the end of the source
+     */
+    void
+    Ast2DotDecompressInput::decompress_zstd(void)
+    {
+#ifdef AST2DOT_WITH_ZSTD
+      ZSTD_DStream* z = ZSTD_createDStream();
+      std::vector<char> block(AST2DOT_DECOMPRESS_BLOCK_SIZE);
+      ZSTD_outBuffer out = { &block[0], block.size(), 0 };
+      ZSTD_inBuffer in = { NULL, 0, 0 };
+      // Hint of ZSTD_decompressStream: 0 at the end of a frame
+      size_t hint = 0;
+      // Output block filled: more output may come without input
+      bool more = false;
+
+      if (!z || ZSTD_isError(ZSTD_initDStream(z)))
+        {
+          ZSTD_freeDStream(z);
+          throw DecompressException("zstd initialization");
+        }
+
+      for (;;)
+        {
+          if (in.pos == in.size && !more)
+            {
+              const char* data;
+              size_t len;
+
+              if (!source(data, len))
+                break;
+              in.src = data;
+              in.size = len;
+              in.pos = 0;
+            }
+
+          hint = ZSTD_decompressStream(z, &out, &in);
+          if (ZSTD_isError(hint))
+            {
+              std::string error(ZSTD_getErrorName(hint));
+
+              ZSTD_freeDStream(z);
+              throw DecompressException(error);
+            }
+
+          more = out.pos == out.size;
+          if (more)
+            {
+              if (!push(block))
+                break;
+              out.dst = &block[0];
+              out.size = block.size();
+              out.pos = 0;
+            }
+        }
+
+      ZSTD_freeDStream(z);
+
+      block.resize(out.pos);
+      if (!block.empty())
+        push(block);
+
+      if (hint)
+        throw DecompressException("truncated zstd data");
+#else
+      throw DecompressException("zstd support not built");
+#endif
+    }
+
+    /**
+     * Next compressed bytes: the whole dump in memory, or the next block
+     * read from the stream
+     *
+     * @param data  set to the bytes
+     * @param len   set to their number
+     *
+     * @return false at end of the source
+     */
+    bool
+    Ast2DotDecompressInput::source(const char*& data, size_t& len)
+    {
+      if (!_is)
+        {
+          if (_compressed >= _size)
+            return false;
+          data = _data;
+          len = _size;
+          _compressed = _size;
+          return true;
+        }
+
+      // Magic read first
+      size_t kept = _magic.size();
+
+      memcpy(&_read[0], _magic.data(), kept);
+      _magic.clear();
+
+      std::streamsize n = _is->rdbuf()->sgetn(&_read[kept], _read.size() - kept);
+
+      if (n <= 0)
+        {
+          _is->setstate(std::ios_base::eofbit);
+          if (!kept)
+            return false;
+          n = 0;
+        }
+
+      data = &_read[0];
+      len = kept + n;
+      _compressed += len;
+
+      return true;
+    }
+
+    /**
+     * Queue a decompressed block, once the parser is less than the max
+     * blocks behind, and take a block to reuse
+     *
+     * @param block  decompressed block, set to the next block to fill
+     *
+     * @return false if the parser stopped
+     */
+    bool
+    Ast2DotDecompressInput::push(std::vector<char>& block)
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+
+      while (!_stop && _blocks.size() >= AST2DOT_DECOMPRESS_BLOCKS_IN_FLIGHT)
+        _cond.wait(lock);
+      if (_stop)
+        return false;
+
+      _blocks.push_back(std::vector<char>());
+      _blocks.back().swap(block);
+      _cond.notify_all();
+
+      if (!_free.empty())
+        {
+          block.swap(_free.back());
+          _free.pop_back();
+        }
+      block.resize(AST2DOT_DECOMPRESS_BLOCK_SIZE);
+
+      return true;
+    }
+
+  } // ! parser
+} // ! clang_ast2dot
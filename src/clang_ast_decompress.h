@@ -0,0 +1,170 @@
+/**
+ * @file clang_ast_decompress.h
+ *
+ */
+
+#ifndef _CLANG_AST_DECOMPRESS_H_
+#define _CLANG_AST_DECOMPRESS_H_
+
+/**
+ * C++ System headers
+ *
+ * thread, mutex & condition_variable for the decompression thread
+ * atomic for the compressed bytes read by the thread
+ * deque for the decompressed blocks
+ * exception for the errors of the decompression thread
+ */
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Own headers
+ */
+#include "clang_ast_input.h"
+
+// Size of the decompressed blocks handed to the parser
+#define AST2DOT_DECOMPRESS_BLOCK_SIZE           (1024 * 1024)
+
+// Decompressed blocks ahead of the parser
+#define AST2DOT_DECOMPRESS_BLOCKS_IN_FLIGHT     4
+
+// Size of the compressed blocks read from a stream
+#define AST2DOT_DECOMPRESS_READ_SIZE            (256 * 1024)
+
+namespace clang_ast2dot
+{
+    namespace parser
+    {
+        /*
+         * Input decompressing a gzip or zstd dump (compressed file mapped in
+         * memory, or stream).
+         *
+         * The dump is decompressed by a thread of its own, a few blocks
+         * ahead of the parser, so that decompression overlaps parsing. The
+         * parser reads the blocks as it would read a stream. Concatenated
+         * gzip members and zstd frames are read as one dump.
+         */
+        class Ast2DotDecompressInput : public Ast2DotInput
+        {
+          public:
+
+            /*
+             * Compression formats
+             */
+            enum Format
+              {
+                NONE = 0,
+                GZIP,
+                ZSTD
+              };
+
+            /*
+             * Decompress input explicit constructors (compressed dump in
+             * memory, or stream)
+             */
+            Ast2DotDecompressInput(const char*, size_t, Format);
+            Ast2DotDecompressInput(std::istream*, Format, std::string const& magic = std::string());
+
+            /*
+             * Decompress input destructor (stop the decompression thread)
+             */
+            virtual ~Ast2DotDecompressInput(void);
+
+            /*
+             * Format of a dump from its magic bytes
+             */
+            static Format detect(const char*, size_t);
+
+            /*
+             * Format of a stream from its magic bytes (the bytes read are
+             * given back, to be read first by the input of the stream)
+             */
+            static Format detect(std::istream*, std::string&);
+
+            /*
+             * Format supported by this build
+             */
+            static bool supported(Format);
+
+            /* Compressed bytes read so far */
+            unsigned long long compressed(void) const { return _compressed; }
+
+            /*
+             * Corrupted or truncated compressed dump
+             */
+            class DecompressException : public ::std::runtime_error
+            {
+              public:
+              DecompressException(std::string const& what) : ::std::runtime_error(std::string("Cannot decompress input: ").append(what)) {};
+                virtual ~DecompressException() {};
+            };
+
+          protected:
+            virtual bool refill(void);
+
+          private:
+
+            /*
+             * Decompression thread: blocks queued until the end of the dump
+             */
+            void decompress(void);
+            void decompress_gzip(void);
+            void decompress_zstd(void);
+
+            /*
+             * Next compressed bytes (returns false at end of the source)
+             */
+            bool source(const char*&, size_t&);
+
+            /*
+             * Queue a decompressed block (returns false if stopped)
+             */
+            bool push(std::vector<char>&);
+
+            // Format of the dump
+            Format _format;
+
+            // Compressed dump in memory, or stream
+            const char* _data;
+            size_t _size;
+            std::istream* _is;
+
+            // Compressed block read from the stream
+            std::vector<char> _read;
+
+            // Bytes read from the stream by detect, read first
+            std::string _magic;
+
+            // Compressed bytes read (by the decompression thread)
+            std::atomic<unsigned long long> _compressed;
+
+            // Parser buffer
+            std::vector<char> _buf;
+
+            // Decompressed blocks, and blocks to reuse
+            std::deque<std::vector<char> > _blocks;
+            std::vector<std::vector<char> > _free;
+
+            // Decompression over (dump read or error), or stopped by the parser
+            bool _done;
+            bool _stop;
+
+            // Decompression error, thrown to the parser (none if null)
+            std::exception_ptr _error;
+
+            std::mutex _mutex;
+            std::condition_variable _cond;
+            std::thread _thread;
+        };
+
+    } // ! namespace parser
+} // ! namespace clang_ast2dot
+
+#endif /* ! _CLANG_AST_DECOMPRESS_H_ */
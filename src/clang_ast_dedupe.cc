@@ -0,0 +1,301 @@
+/**
+ * @file clang_ast_dedupe.cc
+ */
+
+// Include our defs
+#include "clang_ast_dedupe.h"
+
+namespace clang_ast2dot
+{
+  namespace parser
+  {
+    /**
+     * Mix a 64 bits hash (murmur3 finalizer)
+     */
+    static inline uint64_t
+    mix(uint64_t h)
+    {
+      h ^= h >> 33;
+      h *= 0xff51afd7ed558ccdULL;
+      h ^= h >> 33;
+      h *= 0xc4ceb9fe1a85ec53ULL;
+      h ^= h >> 33;
+
+      return h;
+    }
+
+    /**
+     * Add a value to a hash
+     */
+    static inline uint64_t
+    combine(uint64_t h, uint64_t v)
+    {
+      return mix(h ^ (v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2)));
+    }
+
+    /**
+     * Add a text to a hash (FNV-1a)
+     */
+    static inline uint64_t
+    combine(uint64_t h, boost::string_view const& text)
+    {
+      uint64_t f = 14695981039346656037ULL;
+
+      for (size_t i = 0; i < text.size(); i++)
+        f = (f ^ (unsigned char) text[i]) * 1099511628211ULL;
+
+      return combine(h, f);
+    }
+
+    /**
+     * Is a prop an address (not part of the shape)
+     */
+    static inline bool
+    is_address(Ast2DotGraph::Prop const& prop)
+    {
+      return prop.sym == Ast2DotSymbols::NONE && prop.text.size() > 2 &&
+        prop.text[0] == '0' && prop.text[1] == 'x';
+    }
+
+    /**
+     * Ast2DotDedupeEmitter Constructor
+     *
+     * @param out  output of the dot file
+     */
+    Ast2DotDedupeEmitter::Ast2DotDedupeEmitter(Ast2DotOutput* out)
+      : Ast2DotEmitter(out),
+        _shared(0)
+    {
+    }
+
+    /**
+     * Ast2DotDedupeEmitter Destructor
+     */
+    Ast2DotDedupeEmitter::~Ast2DotDedupeEmitter()
+    {
+    }
+
+    /**
+     * Emit the vertices and edges of a graph, the subtrees of a shape
+     * already emitted being replaced by an edge to the first one. As
+     * nodes are in preorder, the subtree of a node is the range of its
+     * size from it, so skipping it is a jump.
+     *
+     * @param graph  graph to emit
+     *
+     * @return number of vertices
+     */
+    size_t
+    Ast2DotDedupeEmitter::emit(Ast2DotGraph const& graph)
+    {
+      // Ancestors of the current node and their IDs
+      std::vector<Ast2DotGraph::Index> stack;
+      std::vector<std::string> ids;
+      // Number of vertices
+      size_t count = 0;
+
+      hash_subtrees(graph);
+      plan(graph);
+
+      _shared = 0;
+      _shared_ids.clear();
+
+      for (Ast2DotGraph::Index i = 0; i < graph.size(); )
+        {
+          while (!stack.empty() && stack.back() != graph.parent(i))
+            stack.pop_back();
+
+          if (ids.size() <= stack.size())
+            ids.resize(stack.size() + 1);
+
+          // ID of the parent vertex (none for a root)
+          std::string const* parent = stack.empty() ? (std::string const*) NULL : &ids[stack.size() - 1];
+
+          if (_dup[i] != Ast2DotGraph::NONE)
+            {
+              // Edge to the first occurrence instead of the subtree
+              std::string const& shared = _shared_ids[_dup[i]];
+
+              if (parent && !parent->empty() && !shared.empty())
+                {
+                  _out->write(AST2DOT_VERTEX_INDENT);
+                  _out->write(*parent);
+                  _out->write(AST2DOT_EDGE_ARROW);
+                  _out->write(shared);
+                  _out->write(AST2DOT_DEDUPE_EDGE_ATTRS);
+                }
+              _shared++;
+              i += _size[i];
+              continue;
+            }
+
+          // Multiplicity of a shared shape
+          _extra_field.clear();
+          if (_count[i] > 1)
+            _extra_field.assign("x").append(std::to_string(_count[i]));
+
+          emit_vertex(graph, i, ids[stack.size()]);
+          if (parent)
+            emit_edge(*parent, ids[stack.size()]);
+          if (_count[i] > 1)
+            _shared_ids[i] = ids[stack.size()];
+          count++;
+
+          // Flush only if asked to (--flush-every)
+          _out->end_vertex();
+
+          stack.push_back(i);
+          i++;
+        }
+
+      _extra_field.clear();
+
+      return count;
+    }
+
+    /**
+     * Hash the shapes of the subtrees bottom-up: nodes being in preorder,
+     * children come after their parent
+     */
+    void
+    Ast2DotDedupeEmitter::hash_subtrees(Ast2DotGraph const& graph)
+    {
+      _hash.assign(graph.size(), 0);
+      _size.assign(graph.size(), 1);
+
+      for (Ast2DotGraph::Index i = graph.size(); i-- > 0; )
+        {
+          // Shape of the vertex then of the children in order
+          uint64_t h = vertex_hash(graph, i);
+
+          for (Ast2DotGraph::Index c = graph.first_child(i); c != Ast2DotGraph::NONE; c = graph.next_sibling(c))
+            {
+              h = combine(h, _hash[c]);
+              _size[i] += _size[c];
+            }
+          _hash[i] = combine(h, _size[i]);
+        }
+    }
+
+    /**
+     * Walk the graph as it will be emitted, choosing the first occurrence
+     * of each shape and counting the next ones
+     */
+    void
+    Ast2DotDedupeEmitter::plan(Ast2DotGraph const& graph)
+    {
+      // First occurrence of each shape
+      std::unordered_map<uint64_t, Ast2DotGraph::Index> first;
+
+      _dup.assign(graph.size(), Ast2DotGraph::NONE);
+      _count.assign(graph.size(), 0);
+
+      for (Ast2DotGraph::Index i = 0; i < graph.size(); )
+        {
+          if (_size[i] >= AST2DOT_DEDUPE_MIN_NODES && graph.parent(i) != Ast2DotGraph::NONE)
+            {
+              std::pair<std::unordered_map<uint64_t, Ast2DotGraph::Index>::iterator, bool> ins =
+                first.insert(std::make_pair(_hash[i], i));
+
+              if (ins.second)
+                _count[i] = 1;
+              else if (same_subtree(graph, ins.first->second, i))
+                {
+                  _dup[i] = ins.first->second;
+                  _count[_dup[i]]++;
+                  i += _size[i];
+                  continue;
+                }
+            }
+          i++;
+        }
+    }
+
+    /**
+     * Are two subtrees of the same shape: same vertices but for their
+     * addresses, linked the same way
+     */
+    bool
+    Ast2DotDedupeEmitter::same_subtree(Ast2DotGraph const& graph, Ast2DotGraph::Index a, Ast2DotGraph::Index b)
+    {
+      if (_size[a] != _size[b])
+        return false;
+
+      for (Ast2DotGraph::Index k = 0; k < _size[a]; k++)
+        {
+          if (k > 0 && graph.parent(a + k) - a != graph.parent(b + k) - b)
+            return false;
+          if (!same_vertex(graph, a + k, b + k))
+            return false;
+        }
+
+      return true;
+    }
+
+    /**
+     * Are two vertices the same but for their address
+     */
+    bool
+    Ast2DotDedupeEmitter::same_vertex(Ast2DotGraph const& graph, Ast2DotGraph::Index a, Ast2DotGraph::Index b)
+    {
+      // Formatted addresses
+      char buf_a[20];
+      char buf_b[20];
+      unsigned char shape = Ast2DotGraph::EMPTY | Ast2DotGraph::NAME_TEXT | Ast2DotGraph::ADDRESS_TEXT;
+
+      if (graph.kind(a) != graph.kind(b) || (graph.flags(a) & shape) != (graph.flags(b) & shape))
+        return false;
+      if ((graph.flags(a) & Ast2DotGraph::NAME_TEXT) && graph.name(a) != graph.name(b))
+        return false;
+      if ((graph.flags(a) & Ast2DotGraph::ADDRESS_TEXT) && graph.address(a, buf_a) != graph.address(b, buf_b))
+        return false;
+
+      graph.props(a, _props_a);
+      graph.props(b, _props_b);
+      if (_props_a.size() != _props_b.size())
+        return false;
+
+      for (size_t p = 0; p < _props_a.size(); p++)
+        {
+          if (is_address(_props_a[p]) && is_address(_props_b[p]))
+            continue;
+          if (_props_a[p].sym != _props_b[p].sym ||
+              (_props_a[p].sym == Ast2DotSymbols::NONE && _props_a[p].text != _props_b[p].text))
+            return false;
+        }
+
+      return true;
+    }
+
+    /**
+     * Hash of a vertex: kind, name, text address (original namespaces)
+     * and props but the 0x... ones
+     */
+    uint64_t
+    Ast2DotDedupeEmitter::vertex_hash(Ast2DotGraph const& graph, Ast2DotGraph::Index i)
+    {
+      // Formatted address
+      char buf[20];
+      uint64_t h = combine((uint64_t) graph.kind(i), (uint64_t) (graph.flags(i) & Ast2DotGraph::EMPTY));
+
+      if (graph.flags(i) & Ast2DotGraph::NAME_TEXT)
+        h = combine(h, graph.name(i));
+      if (graph.flags(i) & Ast2DotGraph::ADDRESS_TEXT)
+        h = combine(h, graph.address(i, buf));
+
+      graph.props(i, _props_a);
+      for (size_t p = 0; p < _props_a.size(); p++)
+        {
+          if (is_address(_props_a[p]))
+            h = combine(h, (uint64_t) 1);
+          else if (_props_a[p].sym != Ast2DotSymbols::NONE)
+            h = combine(h, ((uint64_t) _props_a[p].sym << 1) | 1);
+          else
+            h = combine(h, _props_a[p].text);
+        }
+
+      return h;
+    }
+
+  } // ! parser
+} // ! clang_ast2dot
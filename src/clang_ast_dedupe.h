@@ -0,0 +1,130 @@
+/**
+ * @file clang_ast_dedupe.h
+ *
+ */
+
+#ifndef _CLANG_AST_DEDUPE_H_
+#define _CLANG_AST_DEDUPE_H_
+
+/**
+ * C System headers
+ *
+ * stdint.h for the hashes
+ */
+#include <stdint.h>
+
+/**
+ * C++ System headers
+ *
+ * unordered_map for the representatives of the shapes
+ */
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Own headers
+ */
+#include "clang_ast_emitter.h"
+
+// Smallest subtree deduplicated (single vertices are always emitted)
+#define AST2DOT_DEDUPE_MIN_NODES                2
+
+// Attributes of the edges to a shared subtree
+#define AST2DOT_DEDUPE_EDGE_ATTRS               " [style=\"dashed\",color=blue,weight=100,constraint=true];\n"
+
+namespace clang_ast2dot
+{
+    namespace parser
+    {
+        /*
+         * Dot emitter sharing structurally identical subtrees.
+         *
+         * The shape of a subtree is hashed bottom-up from the kinds, names
+         * and props of its vertices, without the addresses (0x...). The
+         * first occurrence of a shape is emitted, with its multiplicity as
+         * last field of its root vertex; the next ones (checked equal, not
+         * only by hash) are replaced by a dashed edge from their parent to
+         * the root of the first one.
+         *
+         * Shapes are only shared inside one graph, so NULL_n numbering
+         * can not go on from a graph to the next one as it does when all
+         * vertices are emitted.
+         */
+        class Ast2DotDedupeEmitter : public Ast2DotEmitter
+        {
+          public:
+
+            /*
+             * Dedupe emitter explicit constructor
+             */
+            Ast2DotDedupeEmitter(Ast2DotOutput *);
+
+            /*
+             * Dedupe emitter destructor
+             */
+            virtual ~Ast2DotDedupeEmitter(void);
+
+            /*
+             * Emit the vertices and edges of a graph, sharing identical
+             * subtrees (returns number of vertices)
+             */
+            virtual size_t emit(Ast2DotGraph const&);
+
+            /* Number of subtrees replaced by an edge in the last graph */
+            size_t shared(void) const { return _shared; }
+
+          protected:
+
+            /*
+             * Hash the shapes of all subtrees (and get their sizes)
+             */
+            void hash_subtrees(Ast2DotGraph const&);
+
+            /*
+             * Choose the first occurrence of each shape and count them
+             */
+            void plan(Ast2DotGraph const&);
+
+            /*
+             * Are two subtrees of the same shape
+             */
+            bool same_subtree(Ast2DotGraph const&, Ast2DotGraph::Index, Ast2DotGraph::Index);
+
+            /*
+             * Are two vertices the same but for their address
+             */
+            bool same_vertex(Ast2DotGraph const&, Ast2DotGraph::Index, Ast2DotGraph::Index);
+
+            /*
+             * Hash of a vertex, without its address
+             */
+            uint64_t vertex_hash(Ast2DotGraph const&, Ast2DotGraph::Index);
+
+          private:
+
+            // Shape hash and size of the subtree of each node
+            std::vector<uint64_t> _hash;
+            std::vector<Ast2DotGraph::Index> _size;
+
+            // First occurrence of the shape of each node (NONE if none)
+            std::vector<Ast2DotGraph::Index> _dup;
+
+            // Occurrences of the shapes, counted on their first one
+            std::vector<Ast2DotGraph::Index> _count;
+
+            // Vertex IDs of the first occurrences shared
+            std::unordered_map<Ast2DotGraph::Index, std::string> _shared_ids;
+
+            // Subtrees replaced by an edge
+            size_t _shared;
+
+            // Props of the vertices compared
+            std::vector<Ast2DotGraph::Prop> _props_a;
+            std::vector<Ast2DotGraph::Prop> _props_b;
+        };
+
+    } // ! namespace parser
+} // ! namespace clang_ast2dot
+
+#endif /* ! _CLANG_AST_DEDUPE_H_ */
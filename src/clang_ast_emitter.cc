@@ -0,0 +1,363 @@
+/**
+ * @file clang_ast_emitter.cc
+ */
+
+// Include our defs
+#include "clang_ast_emitter.h"
+#include "clang_ast_escape.h"
+#include "clang_ast_stats.h"
+
+namespace clang_ast2dot
+{
+  namespace parser
+  {
+    /**
+     * Append the decimal form of a number to a string
+     */
+    static void
+    append_number(std::string& str, size_t n)
+    {
+      // Digits, least significant first
+      char digits[24];
+      // Number of digits
+      int len = 0;
+
+      do
+        {
+          digits[len++] = '0' + n % 10;
+          n /= 10;
+        }
+      while (n);
+
+      while (len)
+        str.push_back(digits[--len]);
+    }
+
+    /**
+     * Ast2DotEmitter Constructor
+     *
+     * @param out  output of the dot file
+     */
+    Ast2DotEmitter::Ast2DotEmitter(Ast2DotOutput* out)
+      : _out(out),
+        _xref((Ast2DotXref *) NULL),
+        _nnull(0),
+        _npublic(0),
+        _nsummary(0)
+    {
+    }
+
+    /**
+     * Ast2DotEmitter Destructor
+     */
+    Ast2DotEmitter::~Ast2DotEmitter()
+    {
+    }
+
+    /**
+     * Emit the vertices and edges of a graph. The tree is walked in
+     * preorder (the dump order) with the IDs of the ancestors kept
+     * in a stack.
+     *
+     * @param graph  graph to emit
+     *
+     * @return number of vertices
+     */
+    size_t
+    Ast2DotEmitter::emit(Ast2DotGraph const& graph)
+    {
+      // Current node
+      Ast2DotGraph::Index i = graph.size() ? 0 : Ast2DotGraph::NONE;
+      // Depth of the current node
+      size_t depth = 0;
+      // Number of vertices
+      size_t count = 0;
+
+      while (i != Ast2DotGraph::NONE)
+        {
+          if (depth == _ids.size())
+            _ids.push_back(std::string());
+
+          emit_vertex(graph, i, _ids[depth]);
+          if (depth > 0)
+            emit_edge(_ids[depth - 1], _ids[depth]);
+          else if (graph.flags(i) & Ast2DotGraph::ORPHAN)
+            emit_edge(_top, _ids[depth]);
+          else
+            _top = _ids[depth];
+          count++;
+
+          // Flush only if asked to (--flush-every)
+          _out->end_vertex();
+
+          // Children first, then next sibling of the node or of its ancestors
+          if (graph.first_child(i) != Ast2DotGraph::NONE)
+            {
+              i = graph.first_child(i);
+              depth++;
+              continue;
+            }
+
+          while (i != Ast2DotGraph::NONE && graph.next_sibling(i) == Ast2DotGraph::NONE)
+            {
+              i = graph.parent(i);
+              depth--;
+            }
+
+          if (i != Ast2DotGraph::NONE)
+            i = graph.next_sibling(i);
+        }
+
+      return count;
+    }
+
+    /**
+     * Go on numbering NULL and public vertices as if a graph was
+     * emitted (without any output)
+     *
+     * @param graph  graph not emitted
+     */
+    void
+    Ast2DotEmitter::skip(Ast2DotGraph const& graph)
+    {
+      for (Ast2DotGraph::Index i = 0; i < graph.size(); i++)
+        {
+          if (graph.parent(i) == Ast2DotGraph::NONE &&
+              !(graph.flags(i) & Ast2DotGraph::ORPHAN))
+            {
+              _top.clear();
+              if (vertex_fields(graph, i))
+                vertex_id(graph, i, _top);
+            }
+          else if (graph.flags(i) & Ast2DotGraph::SUMMARY)
+            _nsummary++;
+          else if (graph.kind(i) == Ast2DotSymbols::NULL_VERTEX)
+            _nnull++;
+          else if (graph.kind(i) == Ast2DotSymbols::PUBLIC)
+            _npublic++;
+        }
+    }
+
+    /**
+     * Numbering state
+     */
+    Ast2DotEmitter::State
+    Ast2DotEmitter::state(void) const
+    {
+      State state;
+
+      state.nnull = _nnull;
+      state.npublic = _npublic;
+      state.nsummary = _nsummary;
+      state.top = _top;
+
+      return state;
+    }
+
+    void
+    Ast2DotEmitter::set_state(State const& state)
+    {
+      _nnull = state.nnull;
+      _npublic = state.npublic;
+      _nsummary = state.nsummary;
+      _top = state.top;
+    }
+
+    /**
+     * Set name, label and address of a node. NULL, public and summary
+     * vertices get the next number.
+     *
+     * @param graph  graph of the node
+     * @param i      node
+     *
+     * @return false for an empty line (no vertex)
+     */
+    bool
+    Ast2DotEmitter::vertex_fields(Ast2DotGraph const& graph, Ast2DotGraph::Index i)
+    {
+      // Formatted hex address
+      char buf[20];
+
+      if (graph.flags(i) & Ast2DotGraph::EMPTY)
+        return false;
+
+      _address.clear();
+
+      // Collapsed subtrees, described by their props
+      if (graph.flags(i) & Ast2DotGraph::SUMMARY)
+        {
+          _name.assign("summary_");
+          append_number(_name, _nsummary++);
+          _label = _name;
+          return true;
+        }
+
+      switch (graph.kind(i))
+        {
+        case Ast2DotSymbols::NULL_VERTEX:
+          _name.assign("NULL_");
+          append_number(_name, _nnull++);
+          _label.assign("&lt;&lt;&lt;").append(_name).append("&gt;&gt;&gt;");
+          break;
+
+        case Ast2DotSymbols::PUBLIC:
+          append_number(_address, _npublic++);
+          _name.assign("public_").append(_address);
+          _label = _name;
+          break;
+
+        case Ast2DotSymbols::ORIGINAL:
+          {
+            boost::string_view address = graph.address(i, buf);
+            _address.assign(address.data(), address.size());
+            _name.assign("original").append(_address);
+            _label = _name;
+          }
+          break;
+
+        case Ast2DotSymbols::OVERRIDES:
+          {
+            boost::string_view address = graph.address(i, buf);
+            _address.assign(address.data(), address.size());
+            // Without ':'
+            _name.assign("Overrides");
+            _label = _name;
+          }
+          break;
+
+        default:
+          {
+            boost::string_view name = graph.name(i);
+            boost::string_view address = graph.address(i, buf);
+            _name.assign(name.data(), name.size());
+            _address.assign(address.data(), address.size());
+            _label.clear();
+          }
+          break;
+        }
+
+      return true;
+    }
+
+    /**
+     * Vertex ID of the node of the last vertex_fields call (no address
+     * for NULL and summary vertices)
+     */
+    void
+    Ast2DotEmitter::vertex_id(Ast2DotGraph const& graph, Ast2DotGraph::Index i, std::string& id)
+    {
+      id.append(_name);
+      if (graph.kind(i) != Ast2DotSymbols::NULL_VERTEX &&
+          !(graph.flags(i) & Ast2DotGraph::SUMMARY))
+        id.append("_").append(_address);
+    }
+
+    /**
+     * Vertex string of a node: its ID, then its record label of the name,
+     * address and props. This is the only vertex formatter, the parser
+     * going through it for single lines (read_vertex).
+     *
+     * @param graph  graph of the node
+     * @param i      node
+     *
+     * @return the vertex string (empty for empty lines), valid until next call
+     */
+    boost::string_view
+    Ast2DotEmitter::vertex_string(Ast2DotGraph const& graph, Ast2DotGraph::Index i)
+    {
+      unsigned long long start;
+
+      if (!vertex_fields(graph, i))
+        return boost::string_view();
+
+      start = Ast2DotStats::start(Ast2DotStats::ESCAPE);
+
+      // Vertex ID
+      _vertex.assign(AST2DOT_VERTEX_INDENT);
+      _vertex.append(_name);
+      if (!_address.empty())
+        _vertex.append("_").append(_address);
+
+      // Record label
+      _vertex.append(AST2DOT_VERTEX_ATTRS);
+      if (!_label.empty())
+        escape_dot_string_append(_label, _vertex);
+      else if (graph.kind(i) != Ast2DotSymbols::NONE)
+        _vertex.append(graph.symbols().escaped(graph.kind(i)).data(),
+                       graph.symbols().escaped(graph.kind(i)).size());
+      else
+        escape_dot_string_append(_name, _vertex);
+      _vertex.append(AST2DOT_VERTEX_SEP);
+
+      if (!_address.empty())
+        _vertex.append(_address).append(AST2DOT_VERTEX_SEP);
+
+      // Props, escaped text of the interned ones being copied
+      graph.props(i, _props);
+      for (size_t p = 0; p < _props.size(); p++)
+        {
+          if (_props[p].sym != Ast2DotSymbols::NONE)
+            {
+              boost::string_view esc = graph.symbols().escaped(_props[p].sym);
+              _vertex.append(esc.data(), esc.size());
+            }
+          else
+            escape_dot_string_append(_props[p].text, _vertex);
+          _vertex.append(AST2DOT_VERTEX_SEP);
+        }
+
+      if (!_extra_field.empty())
+        {
+          escape_dot_string_append(_extra_field, _vertex);
+          _vertex.append(AST2DOT_VERTEX_SEP);
+        }
+
+      _vertex.append(AST2DOT_VERTEX_END);
+      Ast2DotStats::stop(Ast2DotStats::ESCAPE, start);
+
+      return boost::string_view(_vertex);
+    }
+
+    /**
+     * Emit the vertex string of a node
+     *
+     * @param graph  graph of the node
+     * @param i      node
+     * @param id     set to the vertex ID (empty for empty lines)
+     */
+    void
+    Ast2DotEmitter::emit_vertex(Ast2DotGraph const& graph, Ast2DotGraph::Index i, std::string& id)
+    {
+      boost::string_view vertex = vertex_string(graph, i);
+
+      id.clear();
+      if (vertex.empty())
+        return;
+
+      _out->write(vertex);
+
+      vertex_id(graph, i, id);
+
+      if (_xref && !id.empty())
+        _xref->add(graph, i, id, _out);
+    }
+
+    /**
+     * Emit the edge from a parent vertex to a child one (none if one of
+     * them is an empty line)
+     */
+    void
+    Ast2DotEmitter::emit_edge(std::string const& parent, std::string const& child)
+    {
+      if (parent.empty() || child.empty())
+        return;
+
+      _out->write(AST2DOT_VERTEX_INDENT);
+      _out->write(parent);
+      _out->write(AST2DOT_EDGE_ARROW);
+      _out->write(child);
+      _out->write(AST2DOT_EDGE_ATTRS);
+    }
+
+  } // ! parser
+} // ! clang_ast2dot
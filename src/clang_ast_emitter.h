@@ -0,0 +1,158 @@
+/**
+ * @file clang_ast_emitter.h
+ *
+ */
+
+#ifndef _CLANG_AST_EMITTER_H_
+#define _CLANG_AST_EMITTER_H_
+
+/**
+ * C++ System headers
+ *
+ * vector for the vertex ID stack
+ */
+#include <string>
+#include <vector>
+
+/**
+ * Own headers
+ */
+#include "clang_ast_graph.h"
+#include "clang_ast_output.h"
+#include "clang_ast_xref.h"
+
+namespace clang_ast2dot
+{
+    namespace parser
+    {
+        /*
+         * Dot emitter of an AST graph: one record vertex per node and one
+         * edge from each node to its children, in dump order.
+         *
+         * NULL_n, public_n and summary_n vertices are numbered in emission order, the
+         * numbering going on from one emitted graph to the next. So a dump
+         * read in parts (each one in its own graph) is emitted as if it was
+         * read at once: orphans (top level vertices of a part) are linked to
+         * the last root vertex emitted.
+         */
+        class Ast2DotEmitter
+        {
+          public:
+
+            /*
+             * Numbering state, carried from one emitted graph to the next
+             */
+            struct State
+            {
+              size_t nnull;
+              size_t npublic;
+              size_t nsummary;
+              std::string top;
+            };
+
+            /*
+             * Emitter explicit constructor
+             */
+            Ast2DotEmitter(Ast2DotOutput *);
+
+            /*
+             * Emitter destructor
+             */
+            virtual ~Ast2DotEmitter(void);
+
+            /*
+             * Emit the vertices and edges of a graph (returns number of vertices)
+             */
+            virtual size_t emit(Ast2DotGraph const&);
+
+            /*
+             * Vertex string of a node, numbering NULL and public ones (empty
+             * for empty lines), valid until the next one
+             */
+            boost::string_view vertex_string(Ast2DotGraph const&, Ast2DotGraph::Index);
+
+            /*
+             * Go on numbering as if a graph was emitted, without output
+             */
+            virtual void skip(Ast2DotGraph const&);
+
+            /*
+             * Restart NULL_n and public_n numbering
+             */
+            void reset(void) { _nnull = 0; _npublic = 0; _nsummary = 0; _top.clear(); }
+
+            /* Numbering state */
+            State state(void) const;
+            void set_state(State const&);
+
+            /* Output of the dot file */
+            void set_output(Ast2DotOutput* out) { _out = out; }
+
+            /* Cross-reference edges of the vertices emitted (none if NULL) */
+            void set_xref(Ast2DotXref* xref) { _xref = xref; }
+
+            /* Number of NULL and public vertices emitted */
+            size_t nulls(void) const { return _nnull; }
+            size_t publics(void) const { return _npublic; }
+
+          protected:
+
+            /*
+             * Set name, label and address of a node, numbering NULL and
+             * public ones. Returns false for empty lines.
+             */
+            bool vertex_fields(Ast2DotGraph const&, Ast2DotGraph::Index);
+
+            /*
+             * Vertex ID of the node of the last vertex_fields call
+             */
+            void vertex_id(Ast2DotGraph const&, Ast2DotGraph::Index, std::string&);
+
+            /*
+             * Emit the vertex string of a node, setting its ID (empty if none)
+             */
+            virtual void emit_vertex(Ast2DotGraph const&, Ast2DotGraph::Index, std::string&);
+
+            /*
+             * Emit the edge from a parent vertex to a child one
+             */
+            virtual void emit_edge(std::string const&, std::string const&);
+
+            // Output of the dot file
+            Ast2DotOutput* _out;
+
+            // Last field of the vertices emitted (none if empty)
+            std::string _extra_field;
+
+            // Cross-reference edges (none if NULL)
+            Ast2DotXref* _xref;
+
+          private:
+
+            // NULL_n, public_n and summary_n numbers
+            size_t _nnull;
+            size_t _npublic;
+            size_t _nsummary;
+
+            // ID of the last root vertex (parent of the orphans)
+            std::string _top;
+
+            // Vertex IDs of the nodes from the root to the current one
+            std::vector<std::string> _ids;
+
+            // Vertex string being built
+            std::string _vertex;
+
+            // Name, label and address of the current node
+            std::string _name;
+            std::string _label;
+            std::string _address;
+
+            // Props of the current node
+            std::vector<Ast2DotGraph::Prop> _props;
+        };
+
+    } // ! namespace parser
+} // ! namespace clang_ast2dot
+
+#endif /* ! _CLANG_AST_EMITTER_H_ */
@@ -0,0 +1,247 @@
+/**
+ * @file clang_ast_escape.cc
+ */
+
+/**
+ * C System headers
+ *
+ * string.h for memcpy
+ * immintrin.h/emmintrin.h for scanning blocks of chars
+ */
+#include <string.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Include our defs
+#include "clang_ast_escape.h"
+
+namespace clang_ast2dot
+{
+  namespace parser
+  {
+    /**
+     * Escape sequences of the special chars, indexed by char
+     */
+    struct EscapeTable
+    {
+      // Escape sequence (NULL if char is output as is)
+      const char* seq[256];
+      // Length of the escape sequence
+      unsigned char len[256];
+
+      EscapeTable()
+      {
+        for (int c = 0; c < 256; c++)
+          {
+            seq[c] = (const char*)NULL;
+            len[c] = 1;
+          }
+        set('<', "&lt;");
+        set('>', "&gt;");
+        set(' ', "&nbsp;");
+        set('\\', "\\\\");
+      }
+
+      void set(unsigned char c, const char* s)
+      {
+        seq[c] = s;
+        len[c] = strlen(s);
+      }
+    };
+
+    static const EscapeTable escape_table;
+
+    /**
+     * Find the first special char in [p, end)
+     *
+     * @return pointer on the special char or end
+     */
+    static inline const char*
+    find_special(const char* p, const char* end)
+    {
+#if defined(__AVX2__)
+      const __m256i lt = _mm256_set1_epi8('<');
+      const __m256i gt = _mm256_set1_epi8('>');
+      const __m256i sp = _mm256_set1_epi8(' ');
+      const __m256i bs = _mm256_set1_epi8('\\');
+
+      for (; end - p >= 32; p += 32)
+        {
+          __m256i v = _mm256_loadu_si256((const __m256i*)p);
+          __m256i m = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, lt),
+                                                       _mm256_cmpeq_epi8(v, gt)),
+                                      _mm256_or_si256(_mm256_cmpeq_epi8(v, sp),
+                                                      _mm256_cmpeq_epi8(v, bs)));
+          unsigned int bits = _mm256_movemask_epi8(m);
+          if (bits)
+            return p + __builtin_ctz(bits);
+        }
+#elif defined(__SSE2__)
+      const __m128i lt = _mm_set1_epi8('<');
+      const __m128i gt = _mm_set1_epi8('>');
+      const __m128i sp = _mm_set1_epi8(' ');
+      const __m128i bs = _mm_set1_epi8('\\');
+
+      for (; end - p >= 16; p += 16)
+        {
+          __m128i v = _mm_loadu_si128((const __m128i*)p);
+          __m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, lt),
+                                                _mm_cmpeq_epi8(v, gt)),
+                                   _mm_or_si128(_mm_cmpeq_epi8(v, sp),
+                                                _mm_cmpeq_epi8(v, bs)));
+          unsigned int bits = _mm_movemask_epi8(m);
+          if (bits)
+            return p + __builtin_ctz(bits);
+        }
+#endif
+
+      // Scalar fallback (and tail of the string)
+      for (; p < end; p++)
+        if (escape_table.seq[(unsigned char)*p])
+          return p;
+
+      return end;
+    }
+
+    /**
+     * Compute the size of a string once escaped
+     *
+     * @param str  string to escape
+     *
+     * @return size of the escaped string
+     */
+    size_t
+    escaped_dot_string_size(boost::string_view const& str)
+    {
+      const char* p = str.data();
+      const char* end = p + str.size();
+      size_t size = str.size();
+
+#if defined(__AVX2__)
+      const __m256i lt = _mm256_set1_epi8('<');
+      const __m256i gt = _mm256_set1_epi8('>');
+      const __m256i sp = _mm256_set1_epi8(' ');
+      const __m256i bs = _mm256_set1_epi8('\\');
+
+      for (; end - p >= 32; p += 32)
+        {
+          __m256i v = _mm256_loadu_si256((const __m256i*)p);
+          unsigned int ltgt = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, lt),
+                                                                   _mm256_cmpeq_epi8(v, gt)));
+          unsigned int spb = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, sp));
+          unsigned int bsb = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, bs));
+          size += 3 * __builtin_popcount(ltgt) + 5 * __builtin_popcount(spb) + __builtin_popcount(bsb);
+        }
+#elif defined(__SSE2__)
+      const __m128i lt = _mm_set1_epi8('<');
+      const __m128i gt = _mm_set1_epi8('>');
+      const __m128i sp = _mm_set1_epi8(' ');
+      const __m128i bs = _mm_set1_epi8('\\');
+
+      for (; end - p >= 16; p += 16)
+        {
+          __m128i v = _mm_loadu_si128((const __m128i*)p);
+          unsigned int ltgt = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, lt),
+                                                             _mm_cmpeq_epi8(v, gt)));
+          unsigned int spb = _mm_movemask_epi8(_mm_cmpeq_epi8(v, sp));
+          unsigned int bsb = _mm_movemask_epi8(_mm_cmpeq_epi8(v, bs));
+          size += 3 * __builtin_popcount(ltgt) + 5 * __builtin_popcount(spb) + __builtin_popcount(bsb);
+        }
+#endif
+
+      // Scalar fallback (and tail of the string)
+      for (; p < end; p++)
+        size += escape_table.len[(unsigned char)*p] - 1;
+
+      return size;
+    }
+
+    /**
+     * Copy a string escaping special chars to a buffer sized for it
+     * (see escaped_dot_string_size)
+     *
+     * @param str  string to escape
+     * @param d    destination buffer
+     *
+     * @return end of the escaped string in d
+     */
+    char*
+    escape_dot_string_copy(boost::string_view const& str, char* d)
+    {
+      const char* p = str.data();
+      const char* end = p + str.size();
+
+      while (p < end)
+        {
+          // Copy up to next special char
+          const char* special = find_special(p, end);
+          memcpy(d, p, special - p);
+          d += special - p;
+          if (special == end)
+            break;
+
+          // Then its escape sequence
+          unsigned char c = *special;
+          memcpy(d, escape_table.seq[c], escape_table.len[c]);
+          d += escape_table.len[c];
+          p = special + 1;
+        }
+
+      return d;
+    }
+
+    /**
+     * Escape utf chars and some special chars for URL/HTML
+     * (or equivalent) output. The output is sized first then filled
+     * in one pass.
+     *
+     * @param str  string to escape
+     * @param out  string the escaped string is appended to
+     */
+    void
+    escape_dot_string_append(boost::string_view const& str, std::string& out)
+    {
+      // Size of the escaped string
+      size_t size = escaped_dot_string_size(str);
+      // Start of output
+      size_t base = out.size();
+
+      // Nothing to escape
+      if (size == str.size())
+        {
+          out.append(str.data(), str.size());
+          return;
+        }
+
+      out.resize(base + size);
+      escape_dot_string_copy(str, &out[base]);
+    }
+
+    /**
+     * Escape a string in place
+     *
+     * @param str  string to escape
+     *
+     * @return str
+     */
+    std::string&
+    escape_dot_string(std::string& str)
+    {
+      // Escaped string is built in a reused buffer
+      static thread_local std::string escaped;
+
+      if (escaped_dot_string_size(str) != str.size())
+        {
+          escaped.clear();
+          escape_dot_string_append(str, escaped);
+          str.swap(escaped);
+        }
+
+      return str;
+    }
+
+  } // ! parser
+} // ! clang_ast2dot
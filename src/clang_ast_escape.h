@@ -0,0 +1,49 @@
+/**
+ * @file clang_ast_escape.h
+ *
+ */
+
+#ifndef _CLANG_AST_ESCAPE_H_
+#define _CLANG_AST_ESCAPE_H_
+
+/**
+ * C++ System headers
+ */
+#include <string>
+
+/**
+ * Boost headers
+ */
+#include <boost/utility/string_view.hpp>
+
+namespace clang_ast2dot
+{
+    namespace parser
+    {
+        /*
+         * Escape vertex properties strings special characters
+         * (ex. < with &lt;). Almost the same as json/html.
+         * The escaped string is appended to out.
+         */
+        void escape_dot_string_append(boost::string_view const&, std::string&);
+
+        /*
+         * Same, escaping the string in place
+         */
+        std::string& escape_dot_string(std::string&);
+
+        /*
+         * Same, copying the escaped string to a buffer large enough
+         * (returns the end of the copy)
+         */
+        char* escape_dot_string_copy(boost::string_view const&, char*);
+
+        /*
+         * Size of a string once escaped
+         */
+        size_t escaped_dot_string_size(boost::string_view const&);
+
+    } // ! namespace parser
+} // ! namespace clang_ast2dot
+
+#endif /* ! _CLANG_AST_ESCAPE_H_ */
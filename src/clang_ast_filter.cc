@@ -0,0 +1,235 @@
+/**
+ * @file clang_ast_filter.cc
+ */
+
+/**
+ * C System headers
+ *
+ * fnmatch.h for the file globs
+ */
+#include <fnmatch.h>
+
+// Include our defs
+#include "clang_ast_filter.h"
+
+namespace clang_ast2dot
+{
+  namespace parser
+  {
+    /**
+     * Is a char a decimal digit
+     */
+    static inline bool
+    is_digit(char c)
+    {
+      return c >= '0' && c <= '9';
+    }
+
+    /**
+     * Ast2DotFilter Constructor
+     */
+    Ast2DotFilter::Ast2DotFilter()
+      : _symbols((Ast2DotSymbols const*) NULL)
+    {
+    }
+
+    /**
+     * Ast2DotFilter Destructor
+     */
+    Ast2DotFilter::~Ast2DotFilter()
+    {
+    }
+
+    /**
+     * Intern the included and excluded kinds in the symbol table the
+     * vertex kinds are looked up in
+     *
+     * @param symbols  symbol table of the parser
+     */
+    void
+    Ast2DotFilter::bind(Ast2DotSymbols& symbols)
+    {
+      _symbols = &symbols;
+
+      _include_ids.clear();
+      for (size_t i = 0; i < _include.size(); i++)
+	_include_ids.push_back(symbols.intern(_include[i]));
+
+      _exclude_ids.clear();
+      for (size_t i = 0; i < _exclude.size(); i++)
+	_exclude_ids.push_back(symbols.intern(_exclude[i]));
+    }
+
+    /**
+     * Should a vertex be kept with its subtree. Only the kind (first
+     * word) is read, and the source locations if files are followed.
+     *
+     * @param level  depth of the vertex
+     * @param line   line of the vertex, without relationship string
+     *
+     * @return false if the vertex and its subtree are to be skipped
+     */
+    bool
+    Ast2DotFilter::accept(int level, boost::string_view const& line)
+    {
+      // Files are followed on every line
+      bool file_ok = follows_files() ? scan_files(line, level == 1) : true;
+      // Kind of the vertex
+      Ast2DotSymbols::Id kind = Ast2DotSymbols::NONE;
+
+      if (_symbols && (!_exclude_ids.empty() || (level == 1 && !_include_ids.empty())))
+	kind = _symbols->find(line.substr(0, line.find(' ')));
+
+      for (size_t i = 0; i < _exclude_ids.size(); i++)
+	if (kind == _exclude_ids[i] && kind != Ast2DotSymbols::NONE)
+	  return false;
+
+      if (level != 1)
+	return true;
+
+      if (!_include_ids.empty())
+	{
+	  bool included = false;
+
+	  for (size_t i = 0; i < _include_ids.size() && !included; i++)
+	    included = kind == _include_ids[i] && kind != Ast2DotSymbols::NONE;
+	  if (!included)
+	    return false;
+	}
+
+      return file_ok;
+    }
+
+    /**
+     * Follow the current file through the source locations of a line:
+     * file:L:C (file changed), line:L:C and col:C (same file) or
+     * <invalid sloc> (no file).
+     *
+     * @param line   line of the dump
+     * @param match  match the file of the first location
+     *
+     * @return true if the file of the first location (the current one
+     *         if the line has no location) matches a glob
+     */
+    bool
+    Ast2DotFilter::scan_files(boost::string_view const& line, bool match)
+    {
+      // First location found
+      bool located = false;
+      // Its file matches
+      bool matched = false;
+      // First '<' (start of the source range)
+      size_t lt = line.find('<');
+
+      if (lt != boost::string_view::npos &&
+	  line.substr(lt + 1).starts_with("<invalid sloc>"))
+	located = true;
+
+      for (size_t i = line.find(':'); i != boost::string_view::npos; i = line.find(':', i + 1))
+	{
+	  if (i + 1 >= line.size() || !is_digit(line[i + 1]))
+	    continue;
+
+	  // Start of the location (<built-in> and <scratch space> are files)
+	  size_t start = i;
+	  if (i > 0 && line[i - 1] == '>')
+	    {
+	      start = line.rfind('<', i - 1);
+	      if (start == boost::string_view::npos)
+		continue;
+	    }
+	  else
+	    while (start > 0 && line[start - 1] != ' ' && line[start - 1] != '<' &&
+		   line[start - 1] != ',')
+	      start--;
+
+	  boost::string_view tok = line.substr(start, i - start);
+	  // End of the first number
+	  size_t end = i + 1;
+	  while (end < line.size() && is_digit(line[end]))
+	    end++;
+
+	  bool same_file = tok == "line" || tok == "col";
+	  bool new_file = !same_file && !tok.empty() && end + 1 < line.size() &&
+	    line[end] == ':' && is_digit(line[end + 1]);
+
+	  if (!same_file && !new_file)
+	    continue;
+
+	  if (!located)
+	    {
+	      located = true;
+	      if (match)
+		{
+		  if (new_file)
+		    _match.assign(tok.data(), tok.size());
+		  else
+		    _match = _file;
+		  matched = match_file(_match);
+		}
+	    }
+
+	  if (new_file)
+	    _file.assign(tok.data(), tok.size());
+
+	  i = end;
+	}
+
+      if (!located && match)
+	matched = match_file(_file);
+
+      return matched;
+    }
+
+    /**
+     * Does a file match one of the globs (fnmatch, '*' matching '/')
+     */
+    bool
+    Ast2DotFilter::match_file(std::string const& file) const
+    {
+      if (file.empty())
+	return false;
+
+      for (size_t g = 0; g < _globs.size(); g++)
+	if (fnmatch(_globs[g].c_str(), file.c_str(), 0) == 0)
+	  return true;
+
+      return false;
+    }
+
+    /**
+     * Current file at the end of a part of a dump: the last file of
+     * the last line giving one
+     *
+     * @param begin  start of the dump
+     * @param end    end of the part
+     *
+     * @return the file (empty if none)
+     */
+    std::string
+    Ast2DotFilter::last_file(const char* begin, const char* end)
+    {
+      Ast2DotFilter filter;
+      // End of the line being scanned
+      const char* eol = end > begin && end[-1] == '\n' ? end - 1 : end;
+
+      while (eol > begin)
+	{
+	  // Start of the line
+	  const char* bol = eol;
+
+	  while (bol > begin && bol[-1] != '\n')
+	    bol--;
+
+	  filter.scan_files(boost::string_view(bol, eol - bol), false);
+	  if (!filter._file.empty())
+	    return filter._file;
+
+	  eol = bol > begin ? bol - 1 : begin;
+	}
+
+      return std::string();
+    }
+
+  } // ! parser
+} // ! clang_ast2dot
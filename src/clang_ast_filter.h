@@ -0,0 +1,131 @@
+/**
+ * @file clang_ast_filter.h
+ *
+ */
+
+#ifndef _CLANG_AST_FILTER_H_
+#define _CLANG_AST_FILTER_H_
+
+/**
+ * C++ System headers
+ *
+ * vector for the kind and glob lists
+ */
+#include <string>
+#include <vector>
+
+/**
+ * Boost headers
+ */
+#include <boost/utility/string_view.hpp>
+
+/**
+ * Own headers
+ */
+#include "clang_ast_symbols.h"
+
+namespace clang_ast2dot
+{
+    namespace parser
+    {
+        /*
+         * Subtree filter of the dump, by node kind and source file.
+         *
+         * A rejected vertex is skipped with its whole subtree, the parser
+         * only comparing the depth of the next lines (no tokenizing):
+         *  - excluded kinds are rejected at any depth,
+         *  - if included kinds are given, top level declarations (children
+         *    of the root) of other kinds are rejected,
+         *  - if file globs are given, top level declarations whose source
+         *    file matches none of them are rejected.
+         *
+         * The dump gives the file of a location only when it changes
+         * (then line:L:C or col:C), so the current file is followed on
+         * every line, skipped ones included.
+         */
+        class Ast2DotFilter
+        {
+          public:
+
+            /*
+             * Filter explicit constructor (accepting all)
+             */
+            Ast2DotFilter(void);
+
+            /*
+             * Filter destructor
+             */
+            virtual ~Ast2DotFilter(void);
+
+            /* Filter settings (kinds as in the dump, shell globs of files) */
+            void include_kinds(std::vector<std::string> const& kinds) { _include = kinds; }
+            void exclude_kinds(std::vector<std::string> const& kinds) { _exclude = kinds; }
+            void only_files(std::vector<std::string> const& globs) { _globs = globs; }
+
+            /* Is some vertex possibly rejected */
+            bool active(void) const { return !_include.empty() || !_exclude.empty() || !_globs.empty(); }
+
+            /* Is the current file followed */
+            bool follows_files(void) const { return !_globs.empty(); }
+
+            /*
+             * Intern the kinds in the symbol table of the parser
+             */
+            void bind(Ast2DotSymbols&);
+
+            /*
+             * Should the vertex of a line (without relationship string)
+             * at depth level be kept with its subtree
+             */
+            bool accept(int level, boost::string_view const& line);
+
+            /*
+             * Follow the current file through a line that is skipped
+             */
+            void skip(boost::string_view const& line) { if (follows_files()) scan_files(line, false); }
+
+            /* Current file */
+            std::string const& file(void) const { return _file; }
+            void set_file(std::string const& file) { _file = file; }
+
+            /*
+             * Current file at the end of a part of a dump (for a dump
+             * read from the middle, as by the parallel parsing)
+             */
+            static std::string last_file(const char* begin, const char* end);
+
+          private:
+
+            /*
+             * Follow the file through the locations of a line, returning
+             * whether the file of the first location matches the globs
+             * (only computed if asked to)
+             */
+            bool scan_files(boost::string_view const& line, bool match);
+
+            /*
+             * Does a file match one of the globs
+             */
+            bool match_file(std::string const&) const;
+
+            // Settings
+            std::vector<std::string> _include;
+            std::vector<std::string> _exclude;
+            std::vector<std::string> _globs;
+
+            // Kinds interned in the symbol table of the parser
+            Ast2DotSymbols const* _symbols;
+            std::vector<Ast2DotSymbols::Id> _include_ids;
+            std::vector<Ast2DotSymbols::Id> _exclude_ids;
+
+            // Current file of the dump
+            std::string _file;
+
+            // File of a location being matched
+            std::string _match;
+        };
+
+    } // ! namespace parser
+} // ! namespace clang_ast2dot
+
+#endif /* ! _CLANG_AST_FILTER_H_ */
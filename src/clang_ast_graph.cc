@@ -0,0 +1,519 @@
+/**
+ * @file clang_ast_graph.cc
+ */
+
+// Include our defs
+#include "clang_ast_graph.h"
+
+namespace clang_ast2dot
+{
+  namespace parser
+  {
+    const Ast2DotGraph::Index Ast2DotGraph::NONE;
+
+    /**
+     * Value of a 0x... address as printed by clang (lower case, no
+     * leading zero)
+     *
+     * @param str    address token
+     * @param value  set to the address value (unchanged if not one)
+     *
+     * @return false if token is not such an address
+     */
+    bool
+    Ast2DotGraph::parse_address(boost::string_view const& str, uint64_t& value)
+    {
+      // Value parsed so far
+      uint64_t v = 0;
+
+      if (str.size() < 3 || str.size() > 18 || str[0] != '0' || str[1] != 'x' ||
+          (str[2] == '0' && str.size() > 3))
+        return false;
+
+      for (size_t i = 2; i < str.size(); i++)
+        {
+          char c = str[i];
+          if (c >= '0' && c <= '9')
+            v = (v << 4) | (c - '0');
+          else if (c >= 'a' && c <= 'f')
+            v = (v << 4) | (c - 'a' + 10);
+          else
+            return false;
+        }
+
+      value = v;
+      return true;
+    }
+
+    /**
+     * Ast2DotGraph Constructor
+     *
+     * @param symbols  symbol table of the kinds and props
+     */
+    Ast2DotGraph::Ast2DotGraph(Ast2DotSymbols const& symbols)
+      : _symbols(symbols),
+        _last_root(NONE),
+        _checked_to(NONE)
+    {
+      sync();
+    }
+
+    /**
+     * Ast2DotGraph Destructor
+     */
+    Ast2DotGraph::~Ast2DotGraph()
+    {
+    }
+
+    /**
+     * Remove all nodes (memory is kept)
+     */
+    void
+    Ast2DotGraph::clear(void)
+    {
+      _parent.clear();
+      _first_child.clear();
+      _next_sibling.clear();
+      _kind.clear();
+      _address.clear();
+      _props.clear();
+      _flags.clear();
+      _pool.clear();
+      _stack.clear();
+      _levels.clear();
+      _last_child.clear();
+      _last_root = NONE;
+      _checked.clear();
+      _checked_to = NONE;
+      sync();
+    }
+
+    /**
+     * Read the nodes from columns kept elsewhere (a mapped cache file),
+     * until clear(). Nodes of columns not trusted are checked on their
+     * first access rather than all at once, so that the time is the one
+     * of the nodes read, a bit per node being kept. Nodes are mostly read
+     * in order: the ones before the first node not checked are known
+     * checked without reading their bit.
+     *
+     * @param columns  node table columns and pool
+     * @param check    check the nodes before reading them
+     */
+    void
+    Ast2DotGraph::attach(Columns const& columns, bool check)
+    {
+      clear();
+      _col = columns;
+      if (check)
+        {
+          _checked.assign(columns.size, false);
+          _checked_to = 0;
+        }
+    }
+
+    /**
+     * Point the columns to the vectors (after they are changed)
+     */
+    void
+    Ast2DotGraph::sync(void)
+    {
+      _col.size = _kind.size();
+      _col.parent = _parent.data();
+      _col.first_child = _first_child.data();
+      _col.next_sibling = _next_sibling.data();
+      _col.kind = _kind.data();
+      _col.address = _address.data();
+      _col.props = _props.data();
+      _col.flags = _flags.data();
+      _col.pool = _pool.data();
+      _col.pool_size = _pool.size();
+    }
+
+    /**
+     * Add a node. Its parent is the last node added with a lesser depth,
+     * as for the tree relationship strings of the dump.
+     *
+     * @param level  depth of the node in the dump
+     * @param kind   kind of the node (symbol ID, NONE if name is text)
+     * @param flags  node flags
+     *
+     * @return index of the node
+     */
+    Ast2DotGraph::Index
+    Ast2DotGraph::add_node(int level, Ast2DotSymbols::Id kind, unsigned char flags)
+    {
+      // New node
+      Index i = _kind.size();
+
+      // Pop nodes that can't be parent of this one
+      while (!_stack.empty() && _levels.back() >= level)
+        {
+          _stack.pop_back();
+          _levels.pop_back();
+          _last_child.pop_back();
+        }
+
+      if (_stack.empty())
+        {
+          // Part of a dump (split in chunks): parent is in a previous part
+          if (level > 0)
+            flags |= ORPHAN;
+
+          _parent.push_back(NONE);
+          if (_last_root != NONE)
+            _next_sibling[_last_root] = i;
+          _last_root = i;
+        }
+      else
+        {
+          _parent.push_back(_stack.back());
+          if (_last_child.back() == NONE)
+            _first_child[_stack.back()] = i;
+          else
+            _next_sibling[_last_child.back()] = i;
+          _last_child.back() = i;
+        }
+
+      _first_child.push_back(NONE);
+      _next_sibling.push_back(NONE);
+      _kind.push_back(kind);
+      _address.push_back(0);
+      _props.push_back(_pool.size());
+      _flags.push_back(flags);
+
+      _stack.push_back(i);
+      _levels.push_back(level);
+      _last_child.push_back(NONE);
+
+      sync();
+
+      return i;
+    }
+
+    /**
+     * Set the address of the last node
+     *
+     * @param address  address token (0x... value kept in the table,
+     *                 other text in the pool)
+     */
+    void
+    Ast2DotGraph::set_address(boost::string_view const& address)
+    {
+      if (address.empty())
+        return;
+
+      if (parse_address(address, _address.back()))
+        _flags.back() |= ADDRESS_HEX;
+      else
+        {
+          _flags.back() |= ADDRESS_TEXT;
+          put_text(address);
+        }
+
+      sync();
+    }
+
+    /**
+     * Set the name of the last node when it is not its kind
+     *
+     * @param name  name of the node
+     */
+    void
+    Ast2DotGraph::add_name(boost::string_view const& name)
+    {
+      _flags.back() |= NAME_TEXT;
+      put_text(name);
+
+      sync();
+    }
+
+    /**
+     * Append a prop to the last node
+     *
+     * @param sym   symbol of the prop (NONE if not interned)
+     * @param text  text of the prop (if not interned)
+     */
+    void
+    Ast2DotGraph::add_prop(Ast2DotSymbols::Id sym, boost::string_view const& text)
+    {
+      if (sym != Ast2DotSymbols::NONE)
+        put_varint((uint64_t)sym << 1);
+      else
+        put_text(text);
+
+      sync();
+    }
+
+    /**
+     * Name of a node as in the dump
+     */
+    boost::string_view
+    Ast2DotGraph::name(Index i) const
+    {
+      check(i);
+      if (_col.flags[i] & NAME_TEXT)
+        {
+          uint64_t pos = _col.props[i];
+          return get_text(pos);
+        }
+
+      return _symbols.text(_col.kind[i]);
+    }
+
+    /**
+     * Address of a node as in the dump
+     *
+     * @param i    node
+     * @param buf  buffer for formatting hex addresses
+     *
+     * @return address (empty if node has none)
+     */
+    boost::string_view
+    Ast2DotGraph::address(Index i, char buf[20]) const
+    {
+      check(i);
+      if (_col.flags[i] & ADDRESS_HEX)
+        {
+          static const char hex[] = "0123456789abcdef";
+          // Address value
+          uint64_t value = _col.address[i];
+          // Digits
+          char* p = buf + 20;
+
+          do
+            {
+              *--p = hex[value & 15];
+              value >>= 4;
+            }
+          while (value);
+          *--p = 'x';
+          *--p = '0';
+
+          return boost::string_view(p, buf + 20 - p);
+        }
+
+      if (_col.flags[i] & ADDRESS_TEXT)
+        {
+          uint64_t pos = _col.props[i];
+          if (_col.flags[i] & NAME_TEXT)
+            get_text(pos);
+          return get_text(pos);
+        }
+
+      return boost::string_view();
+    }
+
+    /**
+     * Props of a node
+     *
+     * @param i      node
+     * @param props  filled with the props
+     *
+     * @return number of props
+     */
+    size_t
+    Ast2DotGraph::props(Index i, std::vector<Prop>& props) const
+    {
+      check(i);
+
+      // Position in pool
+      uint64_t pos = _col.props[i];
+      // End of the node props
+      uint64_t end = i + 1 < _col.size ? _col.props[i + 1] : _col.pool_size;
+
+      props.clear();
+
+      if (_col.flags[i] & NAME_TEXT)
+        get_text(pos);
+      if (_col.flags[i] & ADDRESS_TEXT)
+        get_text(pos);
+
+      while (pos < end)
+        {
+          // Position of the item
+          uint64_t item = pos;
+          // Symbol or text length
+          uint64_t v = get_varint(pos);
+          Prop prop;
+
+          if (v & 1)
+            {
+              prop.sym = Ast2DotSymbols::NONE;
+              prop.text = get_text(item);
+              pos = item;
+            }
+          else
+            {
+              prop.sym = v >> 1;
+              prop.text = _symbols.text(prop.sym);
+            }
+          props.push_back(prop);
+        }
+
+      return props.size();
+    }
+
+    /**
+     * Bytes used by the node table and the pool
+     */
+    size_t
+    Ast2DotGraph::bytes(void) const
+    {
+      return _col.size * (3 * sizeof(Index) + sizeof(Ast2DotSymbols::Id) +
+                             2 * sizeof(uint64_t) + 1) +
+        _col.pool_size;
+    }
+
+    void
+    Ast2DotGraph::put_varint(uint64_t v)
+    {
+      while (v >= 0x80)
+        {
+          _pool.push_back((char)(v | 0x80));
+          v >>= 7;
+        }
+      _pool.push_back((char)v);
+    }
+
+    void
+    Ast2DotGraph::put_text(boost::string_view const& text)
+    {
+      put_varint(((uint64_t)text.size() << 1) | 1);
+      _pool.insert(_pool.end(), text.begin(), text.end());
+    }
+
+    uint64_t
+    Ast2DotGraph::get_varint(uint64_t& pos) const
+    {
+      uint64_t v = 0;
+      int shift = 0;
+      unsigned char c;
+
+      do
+        {
+          c = _col.pool[pos++];
+          v |= (uint64_t)(c & 0x7f) << shift;
+          shift += 7;
+        }
+      while (c & 0x80);
+
+      return v;
+    }
+
+    boost::string_view
+    Ast2DotGraph::get_text(uint64_t& pos) const
+    {
+      // Text length
+      uint64_t len = get_varint(pos) >> 1;
+      boost::string_view text(_col.pool + pos, len);
+
+      pos += len;
+      return text;
+    }
+
+    /**
+     * Check a node of attached columns: edges of a preorder tree, kind
+     * and props symbols interned, props items within the pool
+     *
+     * @param i  node
+     *
+     * @throw FormatException if the node is not valid
+     */
+    void
+    Ast2DotGraph::check_node(Index i) const
+    {
+      if (i >= _col.size)
+        throw FormatException("no such node");
+      if (_checked[i])
+        return;
+
+      // Props of the node
+      uint64_t pos = _col.props[i];
+      uint64_t end = i + 1 < _col.size ? _col.props[i + 1] : _col.pool_size;
+      unsigned char flags = _col.flags[i];
+
+      // Parents before, children and siblings after (no cycle)
+      if ((_col.parent[i] != NONE && _col.parent[i] >= i) ||
+          (_col.first_child[i] != NONE &&
+           (_col.first_child[i] <= i || _col.first_child[i] >= _col.size)) ||
+          (_col.next_sibling[i] != NONE &&
+           (_col.next_sibling[i] <= i || _col.next_sibling[i] >= _col.size)))
+        throw FormatException("bad edges");
+
+      // Kind interned, unless the name is text or there is no vertex
+      if (_col.kind[i] >= _symbols.size() &&
+          (_col.kind[i] != Ast2DotSymbols::NONE || !(flags & (NAME_TEXT | EMPTY | SUMMARY))))
+        throw FormatException("bad kind");
+
+      if (pos > end || end > _col.pool_size)
+        throw FormatException("bad props");
+
+      if (flags & NAME_TEXT)
+        check_text(pos, end);
+      if (flags & ADDRESS_TEXT)
+        check_text(pos, end);
+
+      while (pos < end)
+        {
+          // Position of the item
+          uint64_t item = pos;
+          // Symbol or text length
+          uint64_t v = check_varint(pos, end);
+
+          if (v & 1)
+            {
+              pos = item;
+              check_text(pos, end);
+            }
+          else if ((v >> 1) >= _symbols.size())
+            throw FormatException("bad props");
+        }
+
+      _checked[i] = true;
+      while (_checked_to < _col.size && _checked[_checked_to])
+        _checked_to++;
+    }
+
+    /**
+     * Read a varint of the pool, within the props of a node
+     *
+     * @param pos  position of the varint, set after it
+     * @param end  end of the props of the node
+     *
+     * @throw FormatException if the varint is not within the props
+     */
+    uint64_t
+    Ast2DotGraph::check_varint(uint64_t& pos, uint64_t end) const
+    {
+      uint64_t v = 0;
+      int shift = 0;
+      unsigned char c;
+
+      do
+        {
+          if (pos >= end || shift > 63)
+            throw FormatException("bad props");
+          c = _col.pool[pos++];
+          v |= (uint64_t)(c & 0x7f) << shift;
+          shift += 7;
+        }
+      while (c & 0x80);
+
+      return v;
+    }
+
+    /**
+     * Skip a text of the pool, within the props of a node
+     */
+    void
+    Ast2DotGraph::check_text(uint64_t& pos, uint64_t end) const
+    {
+      uint64_t v = check_varint(pos, end);
+
+      if (!(v & 1) || (v >> 1) > end - pos)
+        throw FormatException("bad props");
+      pos += v >> 1;
+    }
+
+  } // ! parser
+} // ! clang_ast2dot
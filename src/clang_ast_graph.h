@@ -0,0 +1,286 @@
+/**
+ * @file clang_ast_graph.h
+ *
+ */
+
+#ifndef _CLANG_AST_GRAPH_H_
+#define _CLANG_AST_GRAPH_H_
+
+/**
+ * C System headers
+ *
+ * stdint.h for fixed size indices
+ */
+#include <stdint.h>
+
+/**
+ * C++ System headers
+ *
+ * stdexcept for the exception of a bad node
+ * vector for the node table columns and the pool
+ */
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+ * Boost headers
+ */
+#include <boost/utility/string_view.hpp>
+
+/**
+ * Own headers
+ */
+#include "clang_ast_symbols.h"
+
+namespace clang_ast2dot
+{
+    namespace parser
+    {
+        /*
+         * AST graph model, filled by the parser in one pass and consumed by
+         * the emitters.
+         *
+         * Nodes are numbered in dump order (a preorder of the tree) and kept
+         * in a structure of arrays, one column per field:
+         *
+         *   parent, first child, next sibling   3 x 4 bytes
+         *   kind (symbol ID)                    4 bytes
+         *   address (0x... value)               8 bytes
+         *   start of the props in the pool      8 bytes
+         *   flags                               1 byte
+         *
+         * that is 33 bytes per node, plus the props in the pool: an interned
+         * prop takes its symbol ID as a varint (1 to 3 bytes), others their
+         * length as a varint and their text. A 50M-node dump takes ~1.6GB of
+         * node table, plus ~10 bytes of pool per node for usual dumps.
+         *
+         * The columns are read through pointers, either to the vectors filled
+         * by the parser or to columns kept elsewhere (a mapped cache file).
+         */
+        class Ast2DotGraph
+        {
+          public:
+
+            // Node index
+            typedef uint32_t Index;
+
+            // No node (no parent, no child or no sibling)
+            static const Index NONE = (Index)-1;
+
+            /*
+             * Node flags
+             */
+            enum Flags
+              {
+                EMPTY = 1,              // empty line (no vertex output)
+                NAME_TEXT = 2,          // name not interned, first in pool
+                ADDRESS_HEX = 4,        // address is the 0x... value
+                ADDRESS_TEXT = 8,       // address is not 0x..., in pool after name
+                ORPHAN = 16,            // parent is before the part of the dump read
+                SUMMARY = 32            // collapsed subtrees (--max-depth), props are the summary
+              };
+
+            /*
+             * Prop of a node: interned symbol or text
+             */
+            struct Prop
+            {
+              Ast2DotSymbols::Id sym;
+              boost::string_view text;
+            };
+
+            /*
+             * Node table columns and pool, read only
+             */
+            struct Columns
+            {
+              size_t size;
+              const Index* parent;
+              const Index* first_child;
+              const Index* next_sibling;
+              const Ast2DotSymbols::Id* kind;
+              const uint64_t* address;
+              const uint64_t* props;
+              const unsigned char* flags;
+              const char* pool;
+              size_t pool_size;
+            };
+
+            /*
+             * Graph explicit constructor (kinds and props are symbols of the table)
+             */
+            Ast2DotGraph(Ast2DotSymbols const&);
+
+            /*
+             * Graph destructor
+             */
+            virtual ~Ast2DotGraph(void);
+
+            /*
+             * Add a node at a depth of the dump, its parent being the last node
+             * added with a lesser depth. Fields are set by the following calls.
+             */
+            Index add_node(int level, Ast2DotSymbols::Id kind, unsigned char flags);
+
+            /*
+             * Set the address of the last node (0x... or text)
+             */
+            void set_address(boost::string_view const&);
+
+            /*
+             * Append the name text of the last node (NAME_TEXT, before address)
+             */
+            void add_name(boost::string_view const&);
+
+            /*
+             * Append a prop to the last node
+             */
+            void add_prop(Ast2DotSymbols::Id, boost::string_view const&);
+
+            /*
+             * Remove all nodes (and detach the columns)
+             */
+            void clear(void);
+
+            /*
+             * Read the nodes from columns kept elsewhere, valid until
+             * clear() (no node can be added). Columns not trusted (a cache
+             * file) are checked a node at a time, on its first access.
+             */
+            void attach(Columns const&, bool check = false);
+
+            /* Columns of the nodes */
+            Columns const& columns(void) const { return _col; }
+
+            /* Number of nodes */
+            size_t size(void) const { return _col.size; }
+
+            /* Node fields */
+            Index parent(Index i) const { check(i); return _col.parent[i]; }
+            Index first_child(Index i) const { check(i); return _col.first_child[i]; }
+            Index next_sibling(Index i) const { check(i); return _col.next_sibling[i]; }
+            Ast2DotSymbols::Id kind(Index i) const { check(i); return _col.kind[i]; }
+            unsigned char flags(Index i) const { check(i); return _col.flags[i]; }
+
+            /* Is the node a <<<NULL>>> one */
+            bool is_null(Index i) const { check(i); return _col.kind[i] == Ast2DotSymbols::NULL_VERTEX; }
+
+            /*
+             * Name of the node as in the dump (kind or text)
+             */
+            boost::string_view name(Index) const;
+
+            /*
+             * Address of the node as in the dump (empty if none)
+             * (hex addresses are formatted in buf)
+             */
+            boost::string_view address(Index, char buf[20]) const;
+
+            /* Address value of the node (0 if not a 0x... one) */
+            uint64_t address_value(Index i) const { check(i); return _col.address[i]; }
+
+            /*
+             * Props of the node (views valid until next add)
+             */
+            size_t props(Index, std::vector<Prop>&) const;
+
+            /* Symbol table */
+            Ast2DotSymbols const& symbols(void) const { return _symbols; }
+
+            /*
+             * Value of a 0x... address token (false if not one)
+             */
+            static bool parse_address(boost::string_view const&, uint64_t&);
+
+            /* Bytes used by the node table and the pool */
+            size_t bytes(void) const;
+
+            /*
+             * Node of attached columns not valid
+             */
+            class FormatException : public ::std::runtime_error
+            {
+              public:
+              FormatException(std::string const& what) : ::std::runtime_error(std::string("Invalid node: ").append(what)) {};
+                virtual ~FormatException() {};
+            };
+
+          private:
+
+            /*
+             * Check a node of attached columns not trusted, the first time
+             */
+            void check(Index i) const { if (i >= _checked_to) check_node(i); }
+
+            /*
+             * Check the edges, kind and props of a node if not done yet
+             * (throws FormatException if not valid)
+             */
+            void check_node(Index) const;
+
+            /*
+             * Read a varint/text in the pool at pos, checked within end
+             */
+            uint64_t check_varint(uint64_t& pos, uint64_t end) const;
+            void check_text(uint64_t& pos, uint64_t end) const;
+
+            /*
+             * Point the columns to the vectors
+             */
+            void sync(void);
+
+            /*
+             * Append a varint to the pool
+             */
+            void put_varint(uint64_t);
+
+            /*
+             * Append a text (length and chars) to the pool
+             */
+            void put_text(boost::string_view const&);
+
+            /*
+             * Read a varint/text in the pool at pos
+             */
+            uint64_t get_varint(uint64_t& pos) const;
+            boost::string_view get_text(uint64_t& pos) const;
+
+            // Symbol table of the kinds and props
+            Ast2DotSymbols const& _symbols;
+
+            // Node table columns
+            std::vector<Index> _parent;
+            std::vector<Index> _first_child;
+            std::vector<Index> _next_sibling;
+            std::vector<Ast2DotSymbols::Id> _kind;
+            std::vector<uint64_t> _address;
+            std::vector<uint64_t> _props;
+            std::vector<unsigned char> _flags;
+
+            // Names, addresses and props text
+            std::vector<char> _pool;
+
+            // Columns read (vectors or attached ones)
+            Columns _col;
+
+            // Nodes that can still get children, and their depth
+            std::vector<Index> _stack;
+            std::vector<int> _levels;
+
+            // Last child of the nodes in the stack
+            std::vector<Index> _last_child;
+
+            // Last node without parent
+            Index _last_root;
+
+            // Nodes of attached columns checked so far, all the ones before
+            // _checked_to (NONE if the columns are trusted) and others in order
+            mutable std::vector<bool> _checked;
+            mutable Index _checked_to;
+        };
+
+    } // ! namespace parser
+} // ! namespace clang_ast2dot
+
+#endif /* ! _CLANG_AST_GRAPH_H_ */
@@ -0,0 +1,775 @@
+/**
+ * @file clang_ast_incremental.cc
+ */
+
+/**
+ * C System headers
+ *
+ * stdio.h for the fragment header, string.h for memchr/memcpy
+ * fcntl.h, unistd.h & sys/stat.h for the fragment files
+ */
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/**
+ * C++ System headers
+ *
+ * algorithm for std::fill
+ */
+#include <algorithm>
+#include <iostream>
+
+// Include our defs
+#include "clang_ast_incremental.h"
+#include "clang_ast_parser.h"
+#include "clang_ast_graph.h"
+
+// Mark of the parent of the orphans in the templates
+#define AST2DOT_INCREMENTAL_TOP_MARK            "0xgtg"
+
+namespace clang_ast2dot
+{
+  namespace parser
+  {
+    /**
+     * FNV-1a hash of bytes, going on from h
+     */
+    static inline uint64_t
+    fnv1a(uint64_t h, const char* data, size_t len)
+    {
+      for (size_t i = 0; i < len; i++)
+        h = (h ^ (unsigned char) data[i]) * 1099511628211ULL;
+
+      return h;
+    }
+
+    /**
+     * Hash of bytes a word at a time, going on from h (chunks are hashed
+     * on every run, hit or miss)
+     */
+    static inline uint64_t
+    hash_words(uint64_t h, const char* data, size_t len)
+    {
+      uint64_t w;
+      size_t i;
+
+      for (i = 0; i + sizeof(w) <= len; i += sizeof(w))
+        {
+          memcpy(&w, data + i, sizeof(w));
+          h = (h ^ w) * 0x9e3779b97f4a7c15ULL;
+          h ^= h >> 32;
+        }
+
+      w = 0;
+      memcpy(&w, data + i, len - i);
+      h = (h ^ w ^ ((uint64_t) len << 56)) * 0x9e3779b97f4a7c15ULL;
+
+      return h ^ (h >> 29);
+    }
+
+    static inline bool
+    is_digit(char c)
+    {
+      return c >= '0' && c <= '9';
+    }
+
+    static inline bool
+    is_hex(char c)
+    {
+      return is_digit(c) || (c >= 'a' && c <= 'f');
+    }
+
+    /**
+     * Length of the 0x... address at p (0 if none)
+     */
+    static inline size_t
+    address_length(const char* p, const char* end)
+    {
+      const char* q = p + 2;
+
+      if (end - p < 3 || p[0] != '0' || p[1] != 'x')
+        return 0;
+      while (q < end && is_hex(*q))
+        q++;
+
+      return q - p > 2 ? q - p : 0;
+    }
+
+    /**
+     * Base of the template number at p, an 18 digits number from one of
+     * the bases (0 if none)
+     */
+    static inline uint64_t
+    number_base(const char* p, const char* begin, const char* end)
+    {
+      if (end - p < 18 || p[0] != '9' || p[1] < '1' || p[1] > '3' ||
+          p[2] != '0' || p[3] != '0' || p[4] != '0' || p[5] != '0' ||
+          (p > begin && is_digit(p[-1])) || (end - p > 18 && is_digit(p[18])))
+        return 0;
+      for (int i = 6; i < 18; i++)
+        if (!is_digit(p[i]))
+          return 0;
+
+      return p[1] == '1' ? AST2DOT_INCREMENTAL_NULL_BASE :
+        p[1] == '2' ? AST2DOT_INCREMENTAL_PUBLIC_BASE : AST2DOT_INCREMENTAL_SUMMARY_BASE;
+    }
+
+    /**
+     * Append the decimal form of a number to a string
+     */
+    static void
+    append_number(std::string& str, uint64_t n)
+    {
+      char digits[24];
+      int len = 0;
+
+      do
+        {
+          digits[len++] = '0' + n % 10;
+          n /= 10;
+        }
+      while (n);
+
+      while (len)
+        str.push_back(digits[--len]);
+    }
+
+    /**
+     * Ast2DotIncremental Constructor
+     *
+     * @param dir  cache directory of the fragments (created if needed)
+     */
+    Ast2DotIncremental::Ast2DotIncremental(std::string const& dir)
+      : _dir(dir),
+        _filter((Ast2DotFilter const*) NULL),
+        _max_depth(-1),
+        _chunks(0),
+        _hits(0),
+        _misses(0)
+    {
+      ::mkdir(_dir.c_str(), 0777);
+    }
+
+    /**
+     * Ast2DotIncremental Destructor
+     */
+    Ast2DotIncremental::~Ast2DotIncremental()
+    {
+    }
+
+    /**
+     * Split a dump at top level declarations (lines starting with |- or
+     * `- at column 0). A chunk ends before a declaration whose first line
+     * hash, without digits, is a multiple of the cut divisor, once it is
+     * at least the min size (or before any one past the max size).
+     *
+     * @param data    dump
+     * @param size    size of the dump
+     * @param starts  set to the start of the chunks
+     *
+     * @return number of chunks
+     */
+    size_t
+    Ast2DotIncremental::split(const char* data, size_t size, std::vector<size_t>& starts)
+    {
+      const char* end = data + size;
+      const char* p = data;
+      // Start of the current chunk
+      const char* chunk = data;
+
+      starts.clear();
+      starts.push_back(0);
+
+      while ((p = (const char*) memchr(p, '\n', end - p)) != NULL)
+        {
+          // Start of the next line
+          const char* line = ++p;
+
+          if (end - line < 3 || (line[0] != '|' && line[0] != '`') || line[1] != '-' ||
+              (size_t)(line - chunk) < AST2DOT_INCREMENTAL_MIN_CHUNK)
+            continue;
+
+          if ((size_t)(line - chunk) < AST2DOT_INCREMENTAL_MAX_CHUNK)
+            {
+              // Hash of the line without addresses, line and column numbers
+              const char* eol = (const char*) memchr(line, '\n', end - line);
+              uint64_t h = 14695981039346656037ULL;
+
+              if (!eol)
+                eol = end;
+              for (const char* c = line; c < eol; c++)
+                {
+                  size_t len = address_length(c, eol);
+
+                  if (len)
+                    c += len - 1;
+                  else if (!is_digit(*c))
+                    h = (h ^ (unsigned char) *c) * 1099511628211ULL;
+                }
+
+              if ((h >> 32) % AST2DOT_INCREMENTAL_CUT_DIVISOR)
+                continue;
+            }
+
+          chunk = line;
+          starts.push_back(line - data);
+        }
+
+      return starts.size();
+    }
+
+    /**
+     * Convert a dump in memory: chunks are written from their fragment
+     * if the cache has one, or converted (and their fragment saved)
+     *
+     * @param data  dump
+     * @param size  size of the dump
+     * @param out   output of the vertices and edges
+     *
+     * @return number of vertices
+     */
+    size_t
+    Ast2DotIncremental::convert(const char* data, size_t size, Ast2DotOutput* out)
+    {
+      std::vector<size_t> starts;
+      // Numbering state of the conversion
+      Ast2DotEmitter::State state;
+      // Normalized chunk and its addresses by rank
+      std::string norm;
+      std::vector<boost::string_view> addresses;
+      // Fragment of the chunk
+      Fragment fragment;
+      // Dot text of the chunks converted as is
+      std::string text;
+      // Number of vertices
+      size_t vertices = 0;
+
+      _chunks = split(data, size, starts);
+      _hits = 0;
+      _misses = 0;
+
+      state.nnull = 0;
+      state.npublic = 0;
+      state.nsummary = 0;
+
+      for (size_t k = 0; k < _chunks; k++)
+        {
+          size_t begin = starts[k];
+          size_t end = k + 1 < _chunks ? starts[k + 1] : size;
+          // Current file where the chunk starts
+          std::string file;
+          // Parsing reached the end of the chunk
+          bool complete = true;
+          // Key of the fragment: chunk and conversion settings
+          uint64_t key = 0;
+
+          if (k > 0 && _filter && _filter->follows_files())
+            file = Ast2DotFilter::last_file(data, data + begin);
+
+          if (normalize(boost::string_view(data + begin, end - begin), norm, addresses))
+            {
+              char flags[2] = { (char)(k == 0), (char)state.top.empty() };
+
+              key = hash_words(14695981039346656037ULL, norm.data(), norm.size());
+              key = fnv1a(key, flags, sizeof(flags));
+              key = fnv1a(key, file.data(), file.size() + 1);
+              key = fnv1a(key, _salt.data(), _salt.size());
+            }
+
+          if (norm.empty() || (!load(key, norm.size(), fragment) && reserved(norm)))
+            {
+              // Converted as is
+              vertices += parse(data + begin, end - begin, k == 0, file, state, text, complete);
+              out->write(text);
+              _misses++;
+              if (!complete)
+                break;
+              continue;
+            }
+
+          if (fragment.buffer.empty())
+            {
+              // Not in the cache: parsed from the bases
+              Ast2DotEmitter::State base;
+              std::string dot;
+
+              base.nnull = AST2DOT_INCREMENTAL_NULL_BASE;
+              base.npublic = AST2DOT_INCREMENTAL_PUBLIC_BASE;
+              base.nsummary = AST2DOT_INCREMENTAL_SUMMARY_BASE;
+              if (!state.top.empty())
+                base.top = AST2DOT_INCREMENTAL_TOP_MARK;
+
+              Ast2DotEmitter::State end_state = base;
+
+              fragment.vertices = parse(norm.data(), norm.size(), k == 0, file, end_state, dot, complete);
+              fragment.nnull = end_state.nnull - base.nnull;
+              fragment.npublic = end_state.npublic - base.npublic;
+              fragment.nsummary = end_state.nsummary - base.nsummary;
+
+              fragment.buffer.clear();
+              if (end_state.top != base.top)
+                fragment.buffer = end_state.top;
+              fragment.buffer.append(dot);
+              fragment.top = boost::string_view(fragment.buffer.data(), fragment.buffer.size() - dot.size());
+              fragment.dot = boost::string_view(fragment.buffer.data() + fragment.top.size(), dot.size());
+              find_marks(fragment.dot, fragment.marks);
+
+              if (complete)
+                store(key, norm.size(), fragment);
+              _misses++;
+            }
+          else
+            _hits++;
+
+          instantiate(fragment.dot, fragment.marks, addresses, state, out);
+          vertices += fragment.vertices;
+
+          // Numbering state after the chunk
+          if (!fragment.top.empty())
+            {
+              Ast2DotMemoryOutput top;
+
+              find_marks(fragment.top, _marks);
+              instantiate(fragment.top, _marks, addresses, state, &top);
+              top.flush();
+              state.top.swap(top.data());
+            }
+          state.nnull += fragment.nnull;
+          state.npublic += fragment.npublic;
+          state.nsummary += fragment.nsummary;
+          fragment.buffer.clear();
+
+          if (!complete)
+            break;
+        }
+
+      return vertices;
+    }
+
+    /**
+     * Replace the addresses of a chunk by their rank in the chunk
+     * (0xgNg), keeping them by rank. Addresses of more than 16 digits
+     * are kept as is.
+     *
+     * @param chunk      part of the dump
+     * @param norm       set to the normalized chunk (empty if false)
+     * @param addresses  set to the addresses by rank
+     *
+     * @return false if the chunk holds an address mark
+     */
+    bool
+    Ast2DotIncremental::normalize(boost::string_view const& chunk, std::string& norm,
+                                  std::vector<boost::string_view>& addresses)
+    {
+      const char* p = chunk.data();
+      const char* end = p + chunk.size();
+      // Start of the bytes not copied yet
+      const char* copy = p;
+
+      norm.clear();
+      addresses.clear();
+      if (_ranks.empty())
+        _ranks.resize(AST2DOT_INCREMENTAL_RANK_SLOTS);
+      else
+        std::fill(_ranks.begin(), _ranks.end(), std::make_pair((uint64_t) 0, (uint32_t) 0));
+
+      // Addresses found from their x
+      while ((p = (const char*) memchr(p, 'x', end - p)) != NULL)
+        {
+          const char* address = p - 1;
+          const char* q = ++p;
+          uint64_t value = 0;
+
+          if (address < copy || *address != '0' || p == end)
+            continue;
+          if (*p == 'g')
+            {
+              norm.clear();
+              return false;
+            }
+
+          for (; q < end && is_hex(*q); q++)
+            value = (value << 4) | (uint64_t)(is_digit(*q) ? *q - '0' : *q - 'a' + 10);
+          p = q;
+          if (q == address + 2 || q - address > 18)
+            continue;
+
+          // Rank of the address, in the open addressing table of the chunk
+          size_t len = q - address;
+          size_t mask = _ranks.size() - 1;
+          size_t s = (size_t)((value * 0x9e3779b97f4a7c15ULL) >> 32) & mask;
+          uint32_t rank;
+
+          while (_ranks[s].second &&
+                 (_ranks[s].first != value || addresses[_ranks[s].second - 1].size() != len))
+            s = (s + 1) & mask;
+
+          if (_ranks[s].second)
+            rank = _ranks[s].second - 1;
+          else
+            {
+              rank = addresses.size();
+              addresses.push_back(boost::string_view(address, len));
+              _ranks[s] = std::make_pair(value, rank + 1);
+
+              if (addresses.size() * 2 > _ranks.size())
+                {
+                  std::vector<std::pair<uint64_t, uint32_t> > ranks(_ranks.size() * 2);
+
+                  ranks.swap(_ranks);
+                  mask = _ranks.size() - 1;
+                  for (size_t r = 0; r < ranks.size(); r++)
+                    if (ranks[r].second)
+                      {
+                        s = (size_t)((ranks[r].first * 0x9e3779b97f4a7c15ULL) >> 32) & mask;
+                        while (_ranks[s].second)
+                          s = (s + 1) & mask;
+                        _ranks[s] = ranks[r];
+                      }
+                }
+            }
+
+          norm.append(copy, address);
+          norm.append("0xg", 3);
+          append_number(norm, rank);
+          norm.push_back('g');
+          copy = q;
+        }
+      norm.append(copy, end);
+
+      return true;
+    }
+
+    /**
+     * Does a normalized chunk hold a number from the bases (the numbers
+     * are not changed by the normalization, so this is only checked for
+     * chunks not in the cache)
+     *
+     * @param norm  normalized chunk
+     *
+     * @return true if the chunk cannot be a template
+     */
+    bool
+    Ast2DotIncremental::reserved(boost::string_view const& norm)
+    {
+      const char* p = norm.data();
+      const char* end = p + norm.size();
+
+      while ((p = (const char*) memchr(p, '9', end - p)) != NULL)
+        {
+          if (number_base(p, norm.data(), end))
+            return true;
+          p++;
+        }
+
+      return false;
+    }
+
+    /**
+     * Find the marks of a template: address ranks, orphans mark and
+     * numbers from the bases
+     *
+     * @param tpl    template
+     * @param marks  set to the marks, in template order
+     */
+    void
+    Ast2DotIncremental::find_marks(boost::string_view const& tpl, std::vector<Mark>& marks)
+    {
+      const char* p = tpl.data();
+      const char* end = p + tpl.size();
+      // Mark of the parent of the orphans
+      static const size_t top_len = sizeof(AST2DOT_INCREMENTAL_TOP_MARK) - 1;
+
+      marks.clear();
+
+      while (p < end)
+        {
+          Mark mark;
+
+          mark.offset = p - tpl.data();
+          if (*p == '0' && end - p > 3 && p[1] == 'x' && p[2] == 'g')
+            {
+              if ((size_t)(end - p) >= top_len && memcmp(p, AST2DOT_INCREMENTAL_TOP_MARK, top_len) == 0)
+                {
+                  mark.type = TOP_MARK;
+                  mark.value = 0;
+                  p += top_len;
+                }
+              else
+                {
+                  mark.type = ADDRESS_MARK;
+                  mark.value = 0;
+                  for (p += 3; p < end && is_digit(*p); p++)
+                    mark.value = mark.value * 10 + (*p - '0');
+                  // Closing g
+                  p++;
+                }
+              mark.length = p - tpl.data() - mark.offset;
+              marks.push_back(mark);
+              continue;
+            }
+
+          if (*p == '9')
+            {
+              uint64_t base = number_base(p, tpl.data(), end);
+
+              if (base)
+                {
+                  mark.type = base == AST2DOT_INCREMENTAL_NULL_BASE ? NULL_MARK :
+                    base == AST2DOT_INCREMENTAL_PUBLIC_BASE ? PUBLIC_MARK : SUMMARY_MARK;
+                  mark.value = 0;
+                  for (int i = 0; i < 18; i++)
+                    mark.value = mark.value * 10 + (p[i] - '0');
+                  mark.value -= base;
+                  mark.length = 18;
+                  marks.push_back(mark);
+                  p += 18;
+                  continue;
+                }
+            }
+          p++;
+        }
+    }
+
+    /**
+     * Parse a chunk in a graph and emit it in memory
+     *
+     * @param text      chunk (normalized or not)
+     * @param len       size of the chunk
+     * @param first     chunk is the first one (no relationship string)
+     * @param file      current file where the chunk starts (file filter)
+     * @param state     numbering state, set to the one after the chunk
+     * @param dot       set to the dot text of the chunk
+     * @param complete  set to false if parsing stopped before the end
+     *
+     * @return number of vertices
+     */
+    size_t
+    Ast2DotIncremental::parse(const char* text, size_t len, bool first, std::string const& file,
+                              Ast2DotEmitter::State& state, std::string& dot, bool& complete)
+    {
+      Ast2DotMemoryInput in(text, len);
+      Ast2DotParser parser;
+      Ast2DotGraph graph(parser.symbols());
+      Ast2DotMemoryOutput out;
+      Ast2DotEmitter emitter(&out);
+      // Depth of the first vertex
+      int level = 0;
+      // Number of vertices
+      size_t vertices = 0;
+
+      parser.set_max_depth(_max_depth);
+      if (_filter)
+        {
+          parser.set_filter(*_filter);
+          if (!first && _filter->follows_files())
+            parser.filter().set_file(file);
+        }
+
+      try
+        {
+          // Chunks but the first start with a relationship string
+          if (!first)
+            level = parser.read_sibling_child_string(&in).length() / 2;
+          vertices = parser.read_graph(&in, graph, level);
+          complete = in.consumed() == len;
+        }
+      catch (std::exception const& e)
+        {
+          std::cerr << "[incremental] ** Error! " << e.what() << "\n";
+          complete = false;
+        }
+
+      emitter.set_state(state);
+      emitter.emit(graph);
+      out.flush();
+      state = emitter.state();
+      dot.swap(out.data());
+
+      return vertices;
+    }
+
+    /**
+     * Write a template: address ranks are replaced by the addresses of
+     * the chunk, numbers from the bases by the numbers from the state,
+     * the orphans mark by the ID of the last root
+     *
+     * @param tpl        template
+     * @param marks      marks of the template
+     * @param addresses  addresses of the chunk by rank
+     * @param state      numbering state at the start of the chunk
+     * @param out        output of the dot text
+     */
+    void
+    Ast2DotIncremental::instantiate(boost::string_view const& tpl, std::vector<Mark> const& marks,
+                                    std::vector<boost::string_view> const& addresses,
+                                    Ast2DotEmitter::State const& state, Ast2DotOutput* out)
+    {
+      // Start of the bytes not written yet
+      size_t copy = 0;
+
+      for (std::vector<Mark>::const_iterator m = marks.begin(); m != marks.end(); ++m)
+        {
+          out->write(tpl.data() + copy, m->offset - copy);
+          switch (m->type)
+            {
+            case ADDRESS_MARK:
+              if (m->value < addresses.size())
+                out->write(addresses[m->value]);
+              break;
+            case TOP_MARK:
+              out->write(state.top);
+              break;
+            case NULL_MARK:
+              out->write((unsigned long long)(state.nnull + m->value));
+              break;
+            case PUBLIC_MARK:
+              out->write((unsigned long long)(state.npublic + m->value));
+              break;
+            default:
+              out->write((unsigned long long)(state.nsummary + m->value));
+              break;
+            }
+          copy = m->offset + m->length;
+        }
+      out->write(tpl.data() + copy, tpl.size() - copy);
+    }
+
+    /**
+     * Read the fragment file of a key
+     *
+     * @param key       key of the chunk
+     * @param len       size of the normalized chunk (checked)
+     * @param fragment  set to the fragment (empty buffer if false)
+     *
+     * @return false if there is no valid fragment
+     */
+    bool
+    Ast2DotIncremental::load(uint64_t key, size_t len, Fragment& fragment)
+    {
+      int fd = ::open(path(key).c_str(), O_RDONLY);
+      struct stat st;
+      std::string& file = fragment.buffer;
+      // Header fields
+      unsigned version;
+      unsigned long long size, nnull, npublic, nsummary, nvertices, top_len, dot_len, nmarks;
+      size_t header_len;
+
+      file.clear();
+      if (fd < 0)
+        return false;
+
+      if (::fstat(fd, &st) != 0)
+        {
+          ::close(fd);
+          return false;
+        }
+
+      file.resize(st.st_size);
+      if (::read(fd, &file[0], file.size()) != (ssize_t) file.size())
+        {
+          ::close(fd);
+          file.clear();
+          return false;
+        }
+      ::close(fd);
+
+      // Header line
+      header_len = file.find('\n') + 1;
+      if (!header_len ||
+          sscanf(file.c_str(), "A2DF %u %llu %llu %llu %llu %llu %llu %llu %llu",
+                 &version, &size, &nnull, &npublic, &nsummary, &nvertices, &top_len, &dot_len, &nmarks) != 9 ||
+          version != AST2DOT_INCREMENTAL_VERSION || size != len ||
+          file.size() != header_len + top_len + dot_len + nmarks * sizeof(Mark))
+        {
+          file.clear();
+          return false;
+        }
+
+      fragment.nnull = nnull;
+      fragment.npublic = npublic;
+      fragment.nsummary = nsummary;
+      fragment.vertices = nvertices;
+      fragment.top = boost::string_view(file.data() + header_len, top_len);
+      fragment.dot = boost::string_view(file.data() + header_len + top_len, dot_len);
+      fragment.marks.resize(nmarks);
+      if (nmarks)
+        memcpy(&fragment.marks[0], file.data() + header_len + top_len + dot_len, nmarks * sizeof(Mark));
+
+      return true;
+    }
+
+    /**
+     * Write the fragment file of a key (in a temporary file renamed, so
+     * that concurrent conversions only see whole fragments). Errors only
+     * lose the fragment.
+     *
+     * @param key       key of the chunk
+     * @param len       size of the normalized chunk
+     * @param fragment  fragment of the chunk
+     */
+    void
+    Ast2DotIncremental::store(uint64_t key, size_t len, Fragment const& fragment)
+    {
+      std::string final_path = path(key);
+      std::string tmp_path = final_path;
+      char header[256];
+      int fd;
+
+      // Marks offsets are 32 bits
+      if (fragment.dot.size() > UINT32_MAX)
+        return;
+
+      tmp_path.append(".").append(std::to_string(::getpid()));
+      fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+      if (fd < 0)
+        return;
+
+      snprintf(header, sizeof(header), "A2DF %u %llu %llu %llu %llu %llu %llu %llu %llu\n",
+               AST2DOT_INCREMENTAL_VERSION, (unsigned long long) len,
+               (unsigned long long) fragment.nnull, (unsigned long long) fragment.npublic,
+               (unsigned long long) fragment.nsummary, (unsigned long long) fragment.vertices,
+               (unsigned long long) fragment.top.size(), (unsigned long long) fragment.dot.size(),
+               (unsigned long long) fragment.marks.size());
+
+      try
+        {
+          Ast2DotOutput out(fd);
+
+          out.write(header);
+          out.write(fragment.top);
+          out.write(fragment.dot);
+          if (!fragment.marks.empty())
+            out.write((const char*) &fragment.marks[0], fragment.marks.size() * sizeof(Mark));
+          out.flush();
+        }
+      catch (Ast2DotOutput::WriteException const& we)
+        {
+          ::close(fd);
+          ::unlink(tmp_path.c_str());
+          return;
+        }
+
+      ::close(fd);
+      if (::rename(tmp_path.c_str(), final_path.c_str()) != 0)
+        ::unlink(tmp_path.c_str());
+    }
+
+    /**
+     * Path of the fragment file of a key
+     */
+    std::string
+    Ast2DotIncremental::path(uint64_t key) const
+    {
+      char name[32];
+
+      snprintf(name, sizeof(name), "/%016llx.a2f", (unsigned long long) key);
+
+      return std::string(_dir).append(name);
+    }
+
+  } // ! parser
+} // ! clang_ast2dot
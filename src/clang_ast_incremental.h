@@ -0,0 +1,233 @@
+/**
+ * @file clang_ast_incremental.h
+ *
+ */
+
+#ifndef _CLANG_AST_INCREMENTAL_H_
+#define _CLANG_AST_INCREMENTAL_H_
+
+/**
+ * C System headers
+ *
+ * stdint.h for the hashes
+ */
+#include <stdint.h>
+
+/**
+ * C++ System headers
+ *
+ * vector for the chunk list and the addresses of a chunk
+ */
+#include <string>
+#include <vector>
+
+/**
+ * Boost headers
+ */
+#include <boost/utility/string_view.hpp>
+
+/**
+ * Own headers
+ */
+#include "clang_ast_output.h"
+#include "clang_ast_filter.h"
+#include "clang_ast_emitter.h"
+
+// Chunks are at least this size (bytes), unless at the end of the dump
+#define AST2DOT_INCREMENTAL_MIN_CHUNK           (16 * 1024)
+
+// Chunks are at most this size (bytes), if top level declarations allow
+#define AST2DOT_INCREMENTAL_MAX_CHUNK           (1024 * 1024)
+
+// One top level declaration out of this many ends a chunk (past the min size)
+#define AST2DOT_INCREMENTAL_CUT_DIVISOR         8
+
+// Initial slots of the table of the address ranks of a chunk (power of 2)
+#define AST2DOT_INCREMENTAL_RANK_SLOTS          1024
+
+// Version of the fragment files (changed with any change of the dot output)
+#define AST2DOT_INCREMENTAL_VERSION             2
+
+// Numbers of the NULL_n, public_n and summary_n vertices of the fragments
+#define AST2DOT_INCREMENTAL_NULL_BASE           910000000000000000ULL
+#define AST2DOT_INCREMENTAL_PUBLIC_BASE         920000000000000000ULL
+#define AST2DOT_INCREMENTAL_SUMMARY_BASE        930000000000000000ULL
+
+namespace clang_ast2dot
+{
+    namespace parser
+    {
+        /*
+         * Incremental conversion of a dump in memory (mapped file), reusing
+         * the dot fragments of the chunks converted by previous runs.
+         *
+         * The dump is split in chunks at top level declarations, the cuts
+         * depending on the declarations themselves and not on their
+         * position, so that a change in a declaration only changes its chunk.
+         * The addresses of a chunk are replaced by their rank in the chunk
+         * (0xgNg), and the chunk is hashed with the conversion settings
+         * into the name of its fragment file in the cache directory.
+         *
+         * A chunk is parsed in that normalized form and emitted with NULL_n,
+         * public_n and summary_n numbers from fixed bases, so its dot text is
+         * a template: ranks, numbers and the ID of the parent of the orphans
+         * are replaced when it is written. The marks are found once, when the
+         * fragment is saved, so an unchanged chunk is only normalized, hashed
+         * and copied from its fragment. Chunks holding text that looks like
+         * a template mark are converted without fragment.
+         */
+        class Ast2DotIncremental
+        {
+          public:
+
+            /*
+             * Incremental explicit constructor (cache directory)
+             */
+            Ast2DotIncremental(std::string const&);
+
+            /*
+             * Incremental destructor
+             */
+            virtual ~Ast2DotIncremental(void);
+
+            /*
+             * Convert a dump in memory, writing vertices and edges to the output
+             * (returns the number of vertices)
+             */
+            virtual size_t convert(const char *, size_t, Ast2DotOutput *);
+
+            /*
+             * Split a dump in chunks at top level declarations (returns the
+             * number of chunks)
+             */
+            static size_t split(const char *, size_t, std::vector<size_t>&);
+
+            /* Subtree filter of the parser of the chunks */
+            void set_filter(Ast2DotFilter const* filter) { _filter = filter; }
+
+            /* Max depth of the parser of the chunks */
+            void set_max_depth(int depth) { _max_depth = depth; }
+
+            /* Other settings of the conversion, part of the fragment keys */
+            void set_salt(std::string const& salt) { _salt = salt; }
+
+            /* Chunks of the last conversion, written from their fragment or converted */
+            size_t chunks(void) const { return _chunks; }
+            size_t hits(void) const { return _hits; }
+            size_t misses(void) const { return _misses; }
+
+          protected:
+
+            /*
+             * Mark of a template: position, type and value (rank of an
+             * address, or number from a base)
+             */
+            enum MarkType
+              {
+                ADDRESS_MARK = 1,
+                TOP_MARK,
+                NULL_MARK,
+                PUBLIC_MARK,
+                SUMMARY_MARK
+              };
+
+            struct Mark
+            {
+              uint32_t offset;
+              uint16_t length;
+              uint16_t type;
+              uint64_t value;
+            };
+
+            /*
+             * Fragment of a chunk
+             */
+            struct Fragment
+            {
+              // Numbers used, from the bases
+              size_t nnull;
+              size_t npublic;
+              size_t nsummary;
+
+              // Vertices of the chunk
+              size_t vertices;
+
+              // Template of the ID of the last root (empty if none)
+              boost::string_view top;
+
+              // Template of the dot text and its marks
+              boost::string_view dot;
+              std::vector<Mark> marks;
+
+              // Fragment file, or parsed templates
+              std::string buffer;
+            };
+
+            /*
+             * Replace the addresses of a chunk by their rank (returns false
+             * if the chunk holds an address mark)
+             */
+            bool normalize(boost::string_view const&, std::string&, std::vector<boost::string_view>&);
+
+            /*
+             * Does a normalized chunk hold a number from the bases
+             */
+            static bool reserved(boost::string_view const&);
+
+            /*
+             * Find the marks of a template
+             */
+            static void find_marks(boost::string_view const&, std::vector<Mark>&);
+
+            /*
+             * Parse and emit a chunk (normalized or not) from a numbering state
+             */
+            size_t parse(const char*, size_t, bool, std::string const&, Ast2DotEmitter::State&, std::string&, bool&);
+
+            /*
+             * Write a template, replacing ranks, numbers and parent of orphans
+             */
+            void instantiate(boost::string_view const&, std::vector<Mark> const&,
+                             std::vector<boost::string_view> const&, Ast2DotEmitter::State const&, Ast2DotOutput*);
+
+            /*
+             * Read/write the fragment file of a key
+             */
+            bool load(uint64_t, size_t, Fragment&);
+            void store(uint64_t, size_t, Fragment const&);
+
+            /*
+             * Path of the fragment file of a key
+             */
+            std::string path(uint64_t) const;
+
+          private:
+
+            // Ranks of the addresses of a chunk (address value, rank + 1)
+            std::vector<std::pair<uint64_t, uint32_t> > _ranks;
+
+            // Marks of the top of a fragment
+            std::vector<Mark> _marks;
+
+            // Cache directory
+            std::string _dir;
+
+            // Subtree filter (none if NULL)
+            Ast2DotFilter const* _filter;
+
+            // Max depth (-1 for all)
+            int _max_depth;
+
+            // Other settings of the conversion
+            std::string _salt;
+
+            // Chunks, hits and misses of the last conversion
+            size_t _chunks;
+            size_t _hits;
+            size_t _misses;
+        };
+
+    } // ! namespace parser
+} // ! namespace clang_ast2dot
+
+#endif /* ! _CLANG_AST_INCREMENTAL_H_ */
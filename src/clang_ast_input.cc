@@ -0,0 +1,259 @@
+/**
+ * @file clang_ast_input.cc
+ */
+
+/**
+ * C System headers
+ *
+ * string.h for memchr/memmove
+ * fcntl.h, unistd.h, sys/stat.h & sys/mman.h for mapping the input file
+ */
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+// Include our defs
+#include "clang_ast_input.h"
+#include "clang_ast_stats.h"
+
+namespace clang_ast2dot
+{
+  namespace parser
+  {
+    /**
+     * Ast2DotInput Constructor
+     */
+    Ast2DotInput::Ast2DotInput()
+      : _begin((const char*)NULL),
+        _cur((const char*)NULL),
+        _end((const char*)NULL),
+        _consumed(0),
+        _eof(false),
+        _last_eof(false)
+    {
+    }
+
+    /**
+     * Ast2DotInput Destructor
+     */
+    Ast2DotInput::~Ast2DotInput()
+    {
+      Ast2DotStats::count(Ast2DotStats::BYTES_IN, consumed());
+    }
+
+    /**
+     * Get the next line of the dump as a view in the input buffer
+     *
+     * @param line  view set on the line (without the trailing '\n')
+     *
+     * @return false if end of dump was reached before any char was read
+     */
+    bool
+    Ast2DotInput::getline(boost::string_view& line)
+    {
+      // Offset from _cur already searched for a '\n'
+      size_t searched = 0;
+      // Found end of line
+      const char* nl = (const char*)NULL;
+      unsigned long long start = Ast2DotStats::start(Ast2DotStats::LINE);
+
+      for (;;)
+        {
+          if (_cur + searched < _end &&
+              (nl = (const char*)memchr(_cur + searched, '\n', (_end - _cur) - searched)) != NULL)
+            break;
+
+          searched = _end - _cur;
+          if (!refill())
+            {
+              // Last line without '\n'
+              _eof = true;
+              line = boost::string_view(_cur, _end - _cur);
+              _cur = _end;
+              Ast2DotStats::stop(Ast2DotStats::LINE, start);
+              Ast2DotStats::count(Ast2DotStats::LINES, !line.empty());
+              return !line.empty();
+            }
+        }
+
+      line = boost::string_view(_cur, nl - _cur);
+      _cur = nl + 1;
+      _last_eof = false;
+      Ast2DotStats::stop(Ast2DotStats::LINE, start);
+      Ast2DotStats::count(Ast2DotStats::LINES);
+
+      return true;
+    }
+
+    /**
+     * Ast2DotStreamInput Constructor
+     *
+     * @param is     stream to read the dump from
+     * @param magic  bytes of the dump already read from the stream (to
+     *               tell a compressed one), read first
+     */
+    Ast2DotStreamInput::Ast2DotStreamInput(std::istream* is, std::string const& magic)
+      : _is(is),
+        _buf(AST2DOT_INPUT_BUFFER_SIZE)
+    {
+      _begin = _cur = &_buf[0];
+      memcpy(&_buf[0], magic.data(), magic.size());
+      _end = _begin + magic.size();
+    }
+
+    /**
+     * Ast2DotStreamInput Destructor
+     */
+    Ast2DotStreamInput::~Ast2DotStreamInput()
+    {
+    }
+
+    /**
+     * Read next block of the stream after the pending bytes.
+     * One char before _cur is kept for unget.
+     */
+    bool
+    Ast2DotStreamInput::refill(void)
+    {
+      if (!_is->good())
+        return false;
+
+      // Bytes kept in buffer (pending + one for unget)
+      size_t keep_from = (_cur > _begin) ? (_cur - _begin) - 1 : 0;
+      size_t kept = (_end - _begin) - keep_from;
+      size_t cur_off = (_cur - _begin) - keep_from;
+
+      // Move kept bytes at start of the buffer
+      if (keep_from)
+        memmove(&_buf[0], &_buf[keep_from], kept);
+      _consumed += keep_from;
+
+      // Grow buffer if a line hardly fits
+      if (kept * 2 > _buf.size())
+        _buf.resize(_buf.size() * 2);
+
+      // Bulk read from the stream buffer
+      std::streamsize n = _is->rdbuf()->sgetn(&_buf[kept], _buf.size() - kept);
+      if (n <= 0)
+        _is->setstate(std::ios_base::eofbit);
+
+      _begin = &_buf[0];
+      _cur = _begin + cur_off;
+      _end = _begin + kept + (n > 0 ? n : 0);
+
+      return n > 0;
+    }
+
+    /**
+     * Ast2DotMemoryInput Constructor
+     *
+     * @param data  start of the dump
+     * @param size  size of the dump
+     */
+    Ast2DotMemoryInput::Ast2DotMemoryInput(const char* data, size_t size)
+    {
+      _begin = _cur = data;
+      _end = data + size;
+    }
+
+    /**
+     * Ast2DotMemoryInput Destructor
+     */
+    Ast2DotMemoryInput::~Ast2DotMemoryInput()
+    {
+    }
+
+    /**
+     * The whole dump is already in the buffer
+     */
+    bool
+    Ast2DotMemoryInput::refill(void)
+    {
+      return false;
+    }
+
+    /**
+     * Ast2DotMmapInput Constructor
+     *
+     * @param path  path of a regular file holding the dump
+     *
+     * @throw OpenException if file cannot be open or mapped
+     */
+    Ast2DotMmapInput::Ast2DotMmapInput(std::string const& path)
+      : _map(MAP_FAILED),
+        _size(0)
+    {
+      // Input file descriptor
+      int fd = ::open(path.c_str(), O_RDONLY);
+      // File status
+      struct stat st;
+
+      if (fd < 0)
+        throw OpenException(path);
+
+      if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+        {
+          ::close(fd);
+          throw OpenException(path);
+        }
+
+      _size = st.st_size;
+
+      // An empty file can't be mapped
+      if (_size > 0)
+        {
+          _map = ::mmap(NULL, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+          if (_map == MAP_FAILED)
+            {
+              ::close(fd);
+              throw OpenException(path);
+            }
+          // We read it once from start to end
+          ::madvise(_map, _size, MADV_SEQUENTIAL);
+          _begin = (const char*)_map;
+        }
+
+      // The mapping stays valid after close
+      ::close(fd);
+
+      _cur = _begin;
+      _end = _begin + _size;
+    }
+
+    /**
+     * Ast2DotMmapInput Destructor
+     */
+    Ast2DotMmapInput::~Ast2DotMmapInput()
+    {
+      if (_map != MAP_FAILED)
+        ::munmap(_map, _size);
+    }
+
+    /**
+     * The whole file is already in the buffer
+     */
+    bool
+    Ast2DotMmapInput::refill(void)
+    {
+      return false;
+    }
+
+    /**
+     * Check if a path can be mapped
+     *
+     * @param path  path of the input file
+     *
+     * @return true if path is a regular file
+     */
+    bool
+    Ast2DotMmapInput::is_mappable(std::string const& path)
+    {
+      struct stat st;
+
+      return ::stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode);
+    }
+
+  } // ! parser
+} // ! clang_ast2dot
@@ -0,0 +1,204 @@
+/**
+ * @file clang_ast_input.h
+ *
+ */
+
+#ifndef _CLANG_AST_INPUT_H_
+#define _CLANG_AST_INPUT_H_
+
+/**
+ * C System headers
+ *
+ * stdio.h for EOF
+ */
+#include <stdio.h>
+
+/**
+ * C++ System headers
+ *
+ * vector for the stream input buffer
+ */
+#include <string>
+#include <iostream>
+#include <vector>
+#include <stdexcept>
+
+/**
+ * Boost headers
+ *
+ * string_view for handing out lines without copying them
+ */
+#include <boost/utility/string_view.hpp>
+
+// Size of the read buffer of a stream input (grows for longer lines)
+#define AST2DOT_INPUT_BUFFER_SIZE               (1024 * 1024)
+
+namespace clang_ast2dot
+{
+    namespace parser
+    {
+        /*
+         * Input source of the AST dump.
+         * The dump is walked with pointers in a buffer [_cur, _end).
+         * Derived classes only provide the way to (re)fill the buffer.
+         */
+        class Ast2DotInput
+        {
+          public:
+
+            /*
+             * Input explicit constructor
+             */
+            Ast2DotInput(void);
+
+            /*
+             * Input destructor
+             */
+            virtual ~Ast2DotInput(void);
+
+            /*
+             * Get next char of the dump (EOF at end of the dump)
+             */
+            int get(void)
+            {
+              if (_cur == _end && !refill())
+                {
+                  _eof = true;
+                  _last_eof = true;
+                  return EOF;
+                }
+              _last_eof = false;
+              return (unsigned char)*_cur++;
+            }
+
+            /*
+             * Put back the last char got (no-op if it was EOF)
+             */
+            void unget(void)
+            {
+              if (!_last_eof && _cur > _begin)
+                _cur--;
+              _last_eof = false;
+            }
+
+            /*
+             * Get next line as a view in the buffer (without the '\n').
+             * The view is only valid until the next read.
+             * Return false if nothing was left to read.
+             */
+            bool getline(boost::string_view&);
+
+            /* End of dump reached */
+            bool eof(void) const { return _eof; }
+
+            /* Number of bytes consumed since start */
+            unsigned long long consumed(void) const { return _consumed + (_cur - _begin); }
+
+            /*
+             * Error while opening the input
+             */
+            class OpenException : public ::std::runtime_error
+            {
+              public:
+              OpenException(std::string const& path) : ::std::runtime_error(std::string("Cannot open input '").append(path).append("'")) {};
+                virtual ~OpenException() {};
+            };
+
+          protected:
+
+            /*
+             * Make more bytes available after _end, keeping [_cur, _end).
+             * Return false if no more bytes can be read.
+             */
+            virtual bool refill(void) = 0;
+
+            // Start of the buffer
+            const char* _begin;
+
+            // Current position
+            const char* _cur;
+
+            // End of valid bytes
+            const char* _end;
+
+            // Bytes dropped from the buffer by refills
+            unsigned long long _consumed;
+
+          private:
+
+            // End of dump reached
+            bool _eof;
+
+            // Last get returned EOF
+            bool _last_eof;
+        };
+
+        /*
+         * Input reading from a std::istream (used for stdin and non regular files).
+         * Bytes are read by large blocks, never one at a time.
+         */
+        class Ast2DotStreamInput : public Ast2DotInput
+        {
+          public:
+            Ast2DotStreamInput(std::istream *is = &std::cin, std::string const& magic = std::string());
+            virtual ~Ast2DotStreamInput(void);
+
+          protected:
+            virtual bool refill(void);
+
+          private:
+            // Stream read
+            std::istream *_is;
+
+            // Read buffer
+            std::vector<char> _buf;
+        };
+
+        /*
+         * Input reading a dump already in memory (as a part of a mapped file)
+         */
+        class Ast2DotMemoryInput : public Ast2DotInput
+        {
+          public:
+            Ast2DotMemoryInput(const char *, size_t);
+            virtual ~Ast2DotMemoryInput(void);
+
+          protected:
+            virtual bool refill(void);
+        };
+
+        /*
+         * Input mapping a regular file in memory: the whole file is the buffer
+         */
+        class Ast2DotMmapInput : public Ast2DotInput
+        {
+          public:
+            Ast2DotMmapInput(std::string const&);
+            virtual ~Ast2DotMmapInput(void);
+
+            /* Size of the mapped file */
+            size_t size(void) const { return _size; }
+
+            /* Start of the mapped file */
+            const char* data(void) const { return _begin; }
+
+            /*
+             * Return true if path is a regular file that can be mapped
+             */
+            static bool is_mappable(std::string const&);
+
+          protected:
+            virtual bool refill(void);
+
+          private:
+            // Mapped area
+            void* _map;
+
+            // Mapped size
+            size_t _size;
+        };
+
+    } // ! namespace parser
+} // ! namespace clang_ast2dot
+
+#endif /* ! _CLANG_AST_INPUT_H_ */
@@ -0,0 +1,368 @@
+/**
+ * @file clang_ast_jobs.cc
+ */
+
+/**
+ * C System headers
+ *
+ * string.h for memchr
+ */
+#include <string.h>
+
+/**
+ * C++ System headers
+ *
+ * thread, mutex & condition_variable for the workers
+ */
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+// Include our defs
+#include "clang_ast_jobs.h"
+#include "clang_ast_parser.h"
+#include "clang_ast_emitter.h"
+#include "clang_ast_stats.h"
+
+namespace clang_ast2dot
+{
+  namespace parser
+  {
+    /**
+     * Chunk of a dump, from parsing to writing
+     */
+    struct Ast2DotChunk
+    {
+      // Part of the dump
+      size_t begin;
+      size_t end;
+
+      // Numbering state once emitted (ready when parsed)
+      Ast2DotEmitter::State state;
+      bool parsed;
+
+      // Dot text of the chunk (ready when emitted)
+      std::string dot;
+      bool emitted;
+
+      // Parsing reached the end of the chunk
+      bool complete;
+
+      // Number of vertices
+      size_t vertices;
+    };
+
+    /**
+     * Shared state of a conversion
+     */
+    struct Ast2DotJobsState
+    {
+      const char* data;
+      std::vector<Ast2DotChunk> chunks;
+
+      // Subtree filter (none if NULL)
+      Ast2DotFilter const* filter;
+
+      // Max depth (-1 for all)
+      int max_depth;
+
+      // Next chunk to take
+      size_t next;
+
+      // Chunks written
+      size_t written;
+
+      // Max chunks in flight
+      size_t in_flight;
+
+      // Stop taking chunks
+      bool stop;
+
+      std::mutex mutex;
+      std::condition_variable cond;
+    };
+
+    /**
+     * Worker: take the chunks in order, parse them, then emit them
+     * once the numbering state of the previous chunk is known
+     *
+     * @param st  conversion state
+     */
+    static void
+    work(Ast2DotJobsState* st)
+    {
+      Ast2DotStats::Merge merge;
+
+      for (;;)
+        {
+          // Chunk taken
+          size_t k;
+
+          {
+            std::unique_lock<std::mutex> lock(st->mutex);
+
+            while (!st->stop && st->next < st->chunks.size() &&
+                   st->next >= st->written + st->in_flight)
+              st->cond.wait(lock);
+
+            if (st->stop || st->next >= st->chunks.size())
+              return;
+            k = st->next++;
+          }
+
+          Ast2DotChunk& chunk = st->chunks[k];
+          Ast2DotMemoryInput in(st->data + chunk.begin, chunk.end - chunk.begin);
+          Ast2DotParser parser;
+          Ast2DotGraph graph(parser.symbols());
+          Ast2DotMemoryOutput out;
+          Ast2DotEmitter emitter(&out);
+          // Numbering state of the previous chunk
+          Ast2DotEmitter::State start;
+          // Depth of the first vertex
+          int level = 0;
+
+          parser.set_max_depth(st->max_depth);
+          if (st->filter)
+            {
+              parser.set_filter(*st->filter);
+              // Current file where the chunk starts
+              if (k > 0 && st->filter->follows_files())
+                parser.filter().set_file(Ast2DotFilter::last_file(st->data, st->data + chunk.begin));
+            }
+
+          try
+            {
+              // Chunks but the first start with a relationship string
+              if (k > 0)
+                level = parser.read_sibling_child_string(&in).length() / 2;
+              chunk.vertices = parser.read_graph(&in, graph, level);
+              chunk.complete = in.consumed() == chunk.end - chunk.begin;
+            }
+          catch (std::exception const& e)
+            {
+              std::cerr << "[jobs] ** Error! chunk " << k << ": " << e.what() << "\n";
+              chunk.vertices = 0;
+              chunk.complete = false;
+            }
+
+          // Numbering state once this chunk is emitted
+          {
+            std::unique_lock<std::mutex> lock(st->mutex);
+
+            while (k > 0 && !st->chunks[k - 1].parsed)
+              st->cond.wait(lock);
+            if (k > 0)
+              start = st->chunks[k - 1].state;
+            else
+              start = emitter.state();
+          }
+
+          emitter.set_state(start);
+          emitter.skip(graph);
+
+          {
+            std::unique_lock<std::mutex> lock(st->mutex);
+            chunk.state = emitter.state();
+            chunk.parsed = true;
+            st->cond.notify_all();
+          }
+
+          // Then emitted in memory
+          emitter.set_state(start);
+          emitter.emit(graph);
+          out.flush();
+
+          {
+            std::unique_lock<std::mutex> lock(st->mutex);
+            chunk.dot.swap(out.data());
+            chunk.emitted = true;
+            st->cond.notify_all();
+          }
+        }
+    }
+
+    /**
+     * Ast2DotJobs Constructor
+     *
+     * @param jobs        number of workers
+     * @param chunk_size  size of the chunks a dump is split in (0 for
+     *                    one from the size of the dump)
+     */
+    Ast2DotJobs::Ast2DotJobs(unsigned jobs, size_t chunk_size)
+      : _jobs(jobs ? jobs : 1),
+        _chunk_size(chunk_size),
+        _flush_chunks(false),
+        _chunks(0),
+        _filter((Ast2DotFilter const*) NULL),
+        _max_depth(-1)
+    {
+    }
+
+    /**
+     * Ast2DotJobs Destructor
+     */
+    Ast2DotJobs::~Ast2DotJobs()
+    {
+    }
+
+    /**
+     * Split a dump at top level declarations, the children of the root
+     * (lines starting with |- or `- at column 0)
+     *
+     * @param data        dump
+     * @param size        size of the dump
+     * @param chunk_size  minimal size of a chunk
+     * @param starts      set to the start of the chunks
+     *
+     * @return number of chunks
+     */
+    size_t
+    Ast2DotJobs::split(const char* data, size_t size, size_t chunk_size, std::vector<size_t>& starts)
+    {
+      // Start of the next chunk
+      size_t pos = 0;
+
+      starts.clear();
+      starts.push_back(0);
+
+      while (size - pos > chunk_size)
+        {
+          // Search after target
+          const char* p = data + pos + chunk_size;
+          const char* end = data + size;
+
+          for (;;)
+            {
+              p = (const char*) memchr(p, '\n', end - p);
+              if (!p || end - p < 3)
+                return starts.size();
+              p++;
+              if ((p[0] == '|' || p[0] == '`') && p[1] == '-')
+                break;
+            }
+
+          pos = p - data;
+          starts.push_back(pos);
+        }
+
+      return starts.size();
+    }
+
+    /**
+     * Size of the chunks of a dump: a few chunks per job, so that a dump
+     * of a few MB keeps all the workers busy, and a large one is not
+     * held in memory by a few huge chunks
+     *
+     * @param size  size of the dump
+     * @param jobs  number of workers
+     *
+     * @return size of the chunks
+     */
+    size_t
+    Ast2DotJobs::chunk_size(size_t size, unsigned jobs)
+    {
+      size_t chunk_size = size / ((jobs ? jobs : 1) * AST2DOT_JOBS_CHUNKS_PER_JOB);
+
+      if (chunk_size < AST2DOT_JOBS_MIN_CHUNK_SIZE)
+        return AST2DOT_JOBS_MIN_CHUNK_SIZE;
+      if (chunk_size > AST2DOT_JOBS_MAX_CHUNK_SIZE)
+        return AST2DOT_JOBS_MAX_CHUNK_SIZE;
+
+      return chunk_size;
+    }
+
+    /**
+     * Convert a dump in memory with the workers
+     *
+     * @param data  dump
+     * @param size  size of the dump
+     * @param out   output of the vertices and edges
+     *
+     * @return number of vertices
+     */
+    size_t
+    Ast2DotJobs::convert(const char* data, size_t size, Ast2DotOutput* out)
+    {
+      Ast2DotJobsState st;
+      std::vector<size_t> starts;
+      std::vector<std::thread> workers;
+      // Number of vertices
+      size_t vertices = 0;
+
+      _chunks = split(data, size, _chunk_size ? _chunk_size : chunk_size(size, _jobs), starts);
+
+      st.data = data;
+      st.filter = _filter;
+      st.max_depth = _max_depth;
+      st.chunks.resize(_chunks);
+      for (size_t k = 0; k < _chunks; k++)
+        {
+          st.chunks[k].begin = starts[k];
+          st.chunks[k].end = k + 1 < _chunks ? starts[k + 1] : size;
+          st.chunks[k].parsed = false;
+          st.chunks[k].emitted = false;
+          st.chunks[k].complete = false;
+          st.chunks[k].vertices = 0;
+        }
+      st.next = 0;
+      st.written = 0;
+      st.in_flight = _jobs * AST2DOT_JOBS_CHUNKS_IN_FLIGHT;
+      st.stop = false;
+
+      for (unsigned j = 0; j < _jobs && j < _chunks; j++)
+        workers.push_back(std::thread(work, &st));
+
+      try
+        {
+          for (size_t k = 0; k < _chunks; k++)
+            {
+              Ast2DotChunk& chunk = st.chunks[k];
+              // Dot text of the chunk
+              std::string dot;
+
+              {
+                std::unique_lock<std::mutex> lock(st.mutex);
+                while (!chunk.emitted)
+                  st.cond.wait(lock);
+                dot.swap(chunk.dot);
+              }
+
+              out->write(dot);
+              if (_flush_chunks)
+                out->flush();
+              vertices += chunk.vertices;
+
+              {
+                std::unique_lock<std::mutex> lock(st.mutex);
+                st.written++;
+                // The single threaded parsing would have stopped here
+                if (!chunk.complete)
+                  st.stop = true;
+                st.cond.notify_all();
+              }
+
+              if (!chunk.complete)
+                break;
+            }
+        }
+      catch (...)
+        {
+          {
+            std::unique_lock<std::mutex> lock(st.mutex);
+            st.stop = true;
+            st.cond.notify_all();
+          }
+          for (size_t j = 0; j < workers.size(); j++)
+            workers[j].join();
+          throw;
+        }
+
+      for (size_t j = 0; j < workers.size(); j++)
+        workers[j].join();
+
+      return vertices;
+    }
+
+  } // ! parser
+} // ! clang_ast2dot
@@ -0,0 +1,116 @@
+/**
+ * @file clang_ast_jobs.h
+ *
+ */
+
+#ifndef _CLANG_AST_JOBS_H_
+#define _CLANG_AST_JOBS_H_
+
+/**
+ * C++ System headers
+ *
+ * vector for the chunk list
+ */
+#include <string>
+#include <vector>
+
+/**
+ * Own headers
+ */
+#include "clang_ast_output.h"
+#include "clang_ast_filter.h"
+
+// Chunks a dump is split in per job, so that the workers keep busy
+// while the chunks are written in order
+#define AST2DOT_JOBS_CHUNKS_PER_JOB             4
+
+// Bounds of the size of the chunks (bytes)
+#define AST2DOT_JOBS_MIN_CHUNK_SIZE             (64 * 1024)
+#define AST2DOT_JOBS_MAX_CHUNK_SIZE             (8 * 1024 * 1024)
+
+// Chunks in flight (parsed or emitted but not written yet) per job
+#define AST2DOT_JOBS_CHUNKS_IN_FLIGHT           2
+
+namespace clang_ast2dot
+{
+    namespace parser
+    {
+        /*
+         * Parallel conversion of a dump in memory (mapped file).
+         *
+         * The dump is split in chunks at top level declarations (lines starting
+         * with |- or `- at column 0). Each chunk is parsed in its own graph by a
+         * worker, with its own parser, then emitted in memory by the same
+         * worker once the numbering state of the previous chunk is known.
+         * Chunks are written in dump order, so the output is the same as the
+         * one of a single threaded conversion.
+         */
+        class Ast2DotJobs
+        {
+          public:
+
+            /*
+             * Jobs explicit constructor
+             */
+            Ast2DotJobs(unsigned jobs, size_t chunk_size = 0);
+
+            /*
+             * Jobs destructor
+             */
+            virtual ~Ast2DotJobs(void);
+
+            /*
+             * Convert a dump in memory, writing vertices and edges to the output
+             * (returns the number of vertices)
+             */
+            virtual size_t convert(const char *, size_t, Ast2DotOutput *);
+
+            /*
+             * Split a dump in chunks at top level declarations, about
+             * chunk_size bytes each (returns the number of chunks)
+             */
+            static size_t split(const char *, size_t, size_t chunk_size, std::vector<size_t>&);
+
+            /*
+             * Size of the chunks of a dump for a number of jobs (a few
+             * chunks per job, within the bounds)
+             */
+            static size_t chunk_size(size_t, unsigned jobs);
+
+            /* Flush the output after each chunk */
+            void flush_chunks(bool flush) { _flush_chunks = flush; }
+
+            /* Subtree filter of the parsers of the chunks */
+            void set_filter(Ast2DotFilter const* filter) { _filter = filter; }
+
+            /* Max depth of the parsers of the chunks (at least 1, top level declarations being split) */
+            void set_max_depth(int depth) { _max_depth = depth; }
+
+            /* Number of chunks of the last conversion */
+            size_t chunks(void) const { return _chunks; }
+
+          private:
+
+            // Number of workers
+            unsigned _jobs;
+
+            // Chunk size (0 for one from the size of the dump)
+            size_t _chunk_size;
+
+            // Flush after each chunk
+            bool _flush_chunks;
+
+            // Number of chunks
+            size_t _chunks;
+
+            // Subtree filter (none if NULL)
+            Ast2DotFilter const* _filter;
+
+            // Max depth (-1 for all)
+            int _max_depth;
+        };
+
+    } // ! namespace parser
+} // ! namespace clang_ast2dot
+
+#endif /* ! _CLANG_AST_JOBS_H_ */
@@ -0,0 +1,184 @@
+/**
+ * @file clang_ast_output.cc
+ */
+
+/**
+ * C System headers
+ *
+ * unistd.h for write
+ * errno.h for EINTR
+ */
+#include <unistd.h>
+#include <errno.h>
+
+// Include our defs
+#include "clang_ast_output.h"
+#include "clang_ast_stats.h"
+
+namespace clang_ast2dot
+{
+  namespace parser
+  {
+    /**
+     * Ast2DotOutput Constructor
+     *
+     * @param fd    file descriptor to write to
+     * @param size  size of the output buffer
+     */
+    Ast2DotOutput::Ast2DotOutput(int fd, size_t size)
+      : _fd(fd),
+        _buf(size),
+        _flush_nodes(0),
+        _flush_bytes(0),
+        _nodes_since_flush(0),
+        _syscalls(0),
+        _bytes(0)
+    {
+      _begin = _cur = &_buf[0];
+      _end = _begin + _buf.size();
+    }
+
+    /**
+     * Ast2DotOutput Destructor
+     */
+    Ast2DotOutput::~Ast2DotOutput()
+    {
+      try
+        {
+          flush();
+        }
+      catch (WriteException const& we)
+        {
+        }
+    }
+
+    /**
+     * Append a decimal number
+     *
+     * @param n  number to output
+     */
+    void
+    Ast2DotOutput::write(unsigned long long n)
+    {
+      // Digits, built from the end
+      char digits[24];
+      char* p = digits + sizeof(digits);
+
+      do
+        {
+          *--p = '0' + (n % 10);
+          n /= 10;
+        }
+      while (n);
+
+      write(p, digits + sizeof(digits) - p);
+    }
+
+    /**
+     * Write pending bytes and reset the buffer
+     */
+    void
+    Ast2DotOutput::flush(void)
+    {
+      if (_cur > _begin)
+        {
+          write_fd(_begin, _cur - _begin);
+          _bytes += _cur - _begin;
+          _cur = _begin;
+        }
+      _nodes_since_flush = 0;
+    }
+
+    /**
+     * Write to another file descriptor (output reused by a server worker)
+     *
+     * @param fd  file descriptor
+     */
+    void
+    Ast2DotOutput::reset(int fd)
+    {
+      _fd = fd;
+      _cur = _begin;
+      _nodes_since_flush = 0;
+      _syscalls = 0;
+      _bytes = 0;
+    }
+
+    /**
+     * Append bytes that don't fit in the remaining buffer
+     */
+    void
+    Ast2DotOutput::write_large(const char* data, size_t len)
+    {
+      flush();
+
+      // Too large for the buffer: write directly
+      if (len >= _buf.size())
+        {
+          write_fd(data, len);
+          _bytes += len;
+        }
+
+      else
+        write(data, len);
+    }
+
+    /**
+     * Write a block to the file descriptor, handling short writes
+     *
+     * @throw WriteException on write error
+     */
+    void
+    Ast2DotOutput::write_fd(const char* data, size_t len)
+    {
+      unsigned long long start = Ast2DotStats::start(Ast2DotStats::OUTPUT);
+
+      Ast2DotStats::count(Ast2DotStats::BYTES_OUT, len);
+      while (len > 0)
+        {
+          ssize_t n = ::write(_fd, data, len);
+          _syscalls++;
+
+          if (n < 0)
+            {
+              if (errno == EINTR)
+                continue;
+              throw WriteException();
+            }
+
+          data += n;
+          len -= n;
+        }
+      Ast2DotStats::stop(Ast2DotStats::OUTPUT, start);
+    }
+
+    /**
+     * Ast2DotMemoryOutput Constructor
+     *
+     * @param size  size of the output buffer
+     */
+    Ast2DotMemoryOutput::Ast2DotMemoryOutput(size_t size)
+      : Ast2DotOutput(-1, size)
+    {
+    }
+
+    /**
+     * Ast2DotMemoryOutput Destructor
+     */
+    Ast2DotMemoryOutput::~Ast2DotMemoryOutput()
+    {
+      // Nothing left for the base class to write
+      flush();
+    }
+
+    /**
+     * Keep a block in memory
+     */
+    void
+    Ast2DotMemoryOutput::write_fd(const char* data, size_t len)
+    {
+      _data.append(data, len);
+    }
+
+  } // ! parser
+} // ! clang_ast2dot
@@ -0,0 +1,206 @@
+/**
+ * @file clang_ast_output.h
+ *
+ */
+
+#ifndef _CLANG_AST_OUTPUT_H_
+#define _CLANG_AST_OUTPUT_H_
+
+/**
+ * C System headers
+ *
+ * string.h for memcpy
+ */
+#include <string.h>
+
+/**
+ * C++ System headers
+ *
+ * vector for the output buffer
+ */
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+/**
+ * Boost headers
+ */
+#include <boost/utility/string_view.hpp>
+
+// Size of the output buffer
+#define AST2DOT_OUTPUT_BUFFER_SIZE              (1024 * 1024)
+
+/*
+ * Dot syntax of the vertices (record with the label, address and props
+ * separated by AST2DOT_VERTEX_SEP) and of the edges
+ */
+#define AST2DOT_VERTEX_INDENT                   "    "
+#define AST2DOT_VERTEX_ATTRS                    " [shape=record,style=filled,fillcolor=lightgrey,label=\"{ "
+#define AST2DOT_VERTEX_SEP                      "| "
+#define AST2DOT_VERTEX_END                      "}\"];\n"
+#define AST2DOT_EDGE_ARROW                      " -> "
+#define AST2DOT_EDGE_ATTRS                      " [style=\"solid\",color=black,weight=100,constraint=true];\n"
+
+namespace clang_ast2dot
+{
+    namespace parser
+    {
+        /*
+         * Output sink of the dot file.
+         * Everything is appended to a large buffer which is written to the
+         * file descriptor only when full (or when the flush policy asks for it).
+         */
+        class Ast2DotOutput
+        {
+          public:
+
+            /*
+             * Output explicit constructor
+             */
+            Ast2DotOutput(int fd, size_t size = AST2DOT_OUTPUT_BUFFER_SIZE);
+
+            /*
+             * Output destructor (flush pending bytes)
+             */
+            virtual ~Ast2DotOutput(void);
+
+            /*
+             * Append bytes to the output
+             */
+            void write(const char* data, size_t len)
+            {
+              if (_end - _cur < (ptrdiff_t)len)
+                {
+                  write_large(data, len);
+                  return;
+                }
+              memcpy(_cur, data, len);
+              _cur += len;
+              if (_flush_bytes && (size_t)(_cur - _begin) >= _flush_bytes)
+                flush();
+            }
+
+            void write(boost::string_view const& str) { write(str.data(), str.size()); }
+            void write(std::string const& str) { write(str.data(), str.size()); }
+            void write(const char* str) { write(str, strlen(str)); }
+
+            /*
+             * Append a decimal number to the output
+             */
+            void write(unsigned long long);
+
+            /*
+             * Mark the end of a vertex (for the flush policy)
+             */
+            void end_vertex(void)
+            {
+              if (_flush_nodes && ++_nodes_since_flush >= _flush_nodes)
+                flush();
+            }
+
+            /*
+             * Write pending bytes to the file descriptor
+             */
+            virtual void flush(void);
+
+            /*
+             * Flush every n vertices (0 for never)
+             */
+            void flush_every_nodes(unsigned long n) { _flush_nodes = n; }
+
+            /*
+             * Flush every n bytes (0 for never)
+             */
+            void flush_every_bytes(size_t n) { _flush_bytes = n; }
+
+            /*
+             * Write to another file descriptor, keeping the buffer: pending
+             * bytes are dropped and counters reset
+             */
+            void reset(int fd);
+
+            /* Number of write syscalls done */
+            unsigned long long syscalls(void) const { return _syscalls; }
+
+            /* Number of bytes output */
+            unsigned long long bytes(void) const { return _bytes + (_cur - _begin); }
+
+            /*
+             * Error while writing the output
+             */
+            class WriteException : public ::std::runtime_error
+            {
+              public:
+              WriteException() : ::std::runtime_error("Error while writing output") {};
+                virtual ~WriteException() {};
+            };
+
+          protected:
+
+            /*
+             * Write a whole block to the file descriptor
+             */
+            virtual void write_fd(const char*, size_t);
+
+            // Output file descriptor
+            int _fd;
+
+          private:
+
+            /*
+             * Append bytes not fitting in the buffer
+             */
+            void write_large(const char*, size_t);
+
+            // Output buffer
+            std::vector<char> _buf;
+
+            // Start of buffer
+            char* _begin;
+
+            // Current position
+            char* _cur;
+
+            // End of buffer
+            char* _end;
+
+            // Flush policy: vertices
+            unsigned long _flush_nodes;
+
+            // Flush policy: bytes
+            size_t _flush_bytes;
+
+            // Vertices since last flush
+            unsigned long _nodes_since_flush;
+
+            // Write syscalls done
+            unsigned long long _syscalls;
+
+            // Bytes flushed
+            unsigned long long _bytes;
+        };
+
+        /*
+         * Output kept in memory (as a part of the dot file built by a worker)
+         */
+        class Ast2DotMemoryOutput : public Ast2DotOutput
+        {
+          public:
+            Ast2DotMemoryOutput(size_t size = AST2DOT_OUTPUT_BUFFER_SIZE);
+            virtual ~Ast2DotMemoryOutput(void);
+
+            /* Bytes flushed so far */
+            std::string& data(void) { return _data; }
+
+          protected:
+            virtual void write_fd(const char*, size_t);
+
+          private:
+            // Bytes flushed
+            std::string _data;
+        };
+
+    } // ! namespace parser
+} // ! namespace clang_ast2dot
+
+#endif /* ! _CLANG_AST_OUTPUT_H_ */
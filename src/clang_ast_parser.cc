@@ -16,68 +16,26 @@
  * fstream for ifstream, ofstream, getline, etc...
  * iostream for cin, cout, etc...
  */
+#include <algorithm>
 #include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <sstream>
 
-/**
- * Boost tokenizer for parsing ast dump lines
- */
-#include <boost/tokenizer.hpp>
-
 // Include our defs
 #include "clang_ast_parser.h"
+#include "clang_ast_output.h"
 
 namespace clang_ast2dot
 {
   namespace parser
   {
-    /**
-     * Escape utf chars and some special chars for URL/HTML
-     * (or equivalent) output
-     */
-    std::string&
-    escape_dot_string(std::string& str)
-    {
-      // Found character position
-      size_t pos = 0;
-      // Length of escaped sequence
-      size_t ilen = 0;
-          
-      do
-	{
-	  pos = str.find_first_of("<>\\ ", pos + ilen);
-	  if (pos != std::string::npos)
-	    switch (str[pos]) {
-	    default:
-	      break;
-	    case '<':
-	      str.replace(pos, 1, "&lt;");
-	      ilen = 4;
-	      break;
-	    case '>':
-	      str.replace(pos, 1, "&gt;");
-	      ilen = 4;
-	      break;
-	    case ' ':
-	      str.replace(pos, 1, "&nbsp;");
-	      ilen = 6;
-	      break;
-	    case '\\':
-	      str = str.insert(pos, 1, '\\');
-	      ilen = 1;
-	      break;
-	    }
-	}
-      while (pos != std::string::npos);
-          
-      return str;
-    }
-
     /**
      * Ast2DotParser Constructor
      */
     Ast2DotParser::Ast2DotParser()
+      : _line(_symbols),
+        _formatter((Ast2DotOutput *) NULL)
     {
       //std::cerr << "Ast2DotParser::Ast2DotParser\n";
       _inbuf.clear();
@@ -85,10 +43,14 @@ namespace clang_ast2dot
       _name.clear();
       _label.clear();
       _address.clear();
-      _props = std::vector<std::string>(5);
+      _props = std::vector<boost::string_view>(5);
+      _prop_syms = std::vector<Ast2DotSymbols::Id>(5, Ast2DotSymbols::NONE);
+      _kind = Ast2DotSymbols::NONE;
+      _label_sym = Ast2DotSymbols::NONE;
       _is_null = false;
-      _name2null.clear();
-      _name2public.clear();
+      _nnull = 0;
+      _npublic = 0;
+      _max_depth = -1;
     }
         
     /** 
@@ -149,6 +111,48 @@ namespace clang_ast2dot
       return _scstr;
     }
 
+    /** 
+     * Read the string that display tree relationships in AST dump
+     * from an input buffer. Same as above but without any virtual
+     * call per char.
+     *
+     * @return the sibling/child string representing the relationship
+     *         between AST classes
+     */
+    std::string&
+    Ast2DotParser::read_sibling_child_string(Ast2DotInput* in)
+    {
+      int c = 0;
+      unsigned long long start = Ast2DotStats::start(Ast2DotStats::PREFIX);
+      _scstr.clear();
+
+      if (!in->eof())
+	{
+	  while ((c = in->get()) == '|' || c == ' ' || c == '`')
+	    _scstr.append(1, (char)c);
+
+	  in->unget();
+
+	  if (_scstr.empty())
+	    throw Ast2DotParser::EmptyScStrException();
+
+	  if ((c = in->get()) != '-')
+	    {
+	      in->unget();
+	      throw Ast2DotParser::InvalidScStrException();
+	    }
+	  else
+	    _scstr.append(1, '-');
+	}
+
+      else
+	throw Ast2DotParser::UnexpectedEofException();
+
+      Ast2DotStats::stop(Ast2DotStats::PREFIX, start);
+
+      return _scstr;
+    }
+
     /**
      * This method quotes some specific quoting string in order for 
      * the quoted string to be handled as one token.
@@ -163,6 +167,9 @@ namespace clang_ast2dot
      *  2. 'special'
      *  3. 'quoted'
      *  4. 'string>>'
+     *
+     * The result is a new string (owned by the caller through out_buf_ptr)
+     * if quotes were found, else the input buffer itself.
      */
     std::string&
     Ast2DotParser::quote_special_quotes(std::string& input_buf,
@@ -171,8 +178,8 @@ namespace clang_ast2dot
 					std::string*& out_buf_ptr)
     {
       //std::cerr << "Ast2DotParser::quote_special_quotes\n";
-      // Copy of input buffer
-      std::string *inbuf = new std::string(input_buf);
+      // Copy of input buffer (only if quotes are found)
+      std::string *inbuf = (std::string*)NULL;
       // Set out_buf_ptr to null
       out_buf_ptr = (std::string*)NULL;
       // Length of in quote string
@@ -189,6 +196,8 @@ namespace clang_ast2dot
 	  (lastpos = input_buf.find(out_quoting_str)) != std::string::npos &&
 	  curpos < lastpos)
 	{
+	  // Result buf, owned by the caller through out_buf_ptr
+	  inbuf = new std::string(input_buf);
 	  // Insert a dbl quote at start of in_quote
 	  std::string quote_entry = std::string("\"").append(in_quoting_str);
 	  // and replace in_quote in result buf
@@ -201,13 +210,72 @@ namespace clang_ast2dot
 	  out_buf_ptr = inbuf;
 	}
 
-      // Return result buf
-      return (*inbuf);
+      // Return result buf (or input buf untouched)
+      return inbuf ? (*inbuf) : input_buf;
+    }
+
+    /**
+     * Append the decimal form of an index to a string
+     *
+     * @param str  string to append to
+     * @param ix   index
+     */
+    static inline void
+    append_index(std::string& str, size_t ix)
+    {
+      // Digits, least significant first
+      char digits[24];
+      // Number of digits
+      int n = 0;
+
+      do
+	{
+	  digits[n++] = '0' + ix % 10;
+	  ix /= 10;
+	}
+      while (ix);
+
+      while (n)
+	str.push_back(digits[--n]);
+    }
+
+    /**
+     * Index of a numbered vertex name (as NULL_1 or public_1)
+     *
+     * @param name    vertex name
+     * @param prefix  name prefix (as NULL_)
+     * @param count   number of vertices numbered
+     *
+     * @return index, or -1 if name is not the one of a numbered vertex
+     */
+    static long
+    name_to_index(std::string const& name, const char* prefix, size_t count)
+    {
+      // Prefix length
+      size_t len = strlen(prefix);
+      // Index in name
+      size_t ix = 0;
+
+      if (name.size() <= len || name.size() > len + 19 ||
+	  name.compare(0, len, prefix) != 0 ||
+	  (name[len] == '0' && name.size() > len + 1))
+	return -1;
+
+      for (size_t i = len; i < name.size(); i++)
+	{
+	  if (name[i] < '0' || name[i] > '9')
+	    return -1;
+	  ix = ix * 10 + (name[i] - '0');
+	}
+
+      return ix < count ? (long)ix : -1;
     }
 
     /**
      * Provide a name for a null vertex.
-     * If ix is -1, add a new null else return indexed one
+     * If ix is -1 (or not allocated yet), add a new null else return
+     * indexed one. Names are derived from the null counter, so this is
+     * constant time.
      *
      * @param ix index of the null vertex in parsing order
      *
@@ -219,22 +287,14 @@ namespace clang_ast2dot
     {
       //std::cerr << "Ast2DotParser::null_to_name\n";
 
-      std::stringbuf strbuf("", std::ios_base::out);
-      std::ostream ostr(&strbuf);
+      std::string name("NULL_");
 
-      int mapsz = _name2null.size();
-      
-      if (ix == -1 || ix >= mapsz)
-	{
-	  int next_ix = mapsz;
-	  ostr << "NULL_" << next_ix;
-	  _name2null[next_ix] = strbuf.str();
-	  return _name2null[next_ix];
-	}
-
-      else if (ix >= 0 && ix < mapsz)
-	return _name2null[ix];
+      if (ix < 0 || (size_t)ix >= _nnull)
+	append_index(name, _nnull++);
+      else
+	append_index(name, ix);
 
+      return name;
     }
         
     /**
@@ -242,7 +302,8 @@ namespace clang_ast2dot
      *
      * @param name  name of the null vertex
      *
-     * @return label for this null vertex (as <<<NULL_#1>>>)
+     * @return label for this null vertex (as <<<NULL_#1>>>),
+     *         empty if name is not the one of an allocated null vertex
      *
      */
     std::string
@@ -250,36 +311,21 @@ namespace clang_ast2dot
     {
       //std::cerr << "Ast2DotParser::null_to_label\n";
 
-      std::stringbuf strbuf("", std::ios_base::out);
-      std::ostream ostr(&strbuf);
-
-      std::map<int, std::string>::iterator it = _name2null.begin();
-
-      do
-	{
-	  if (it->second.compare(name) == 0)
-	    break;
-	  it++;
-	}
-      while (it != _name2null.end());
-      
-      if (it != _name2null.end())
-	{
-	  ostr << "&lt;&lt;&lt;NULL_" << it->first << "&gt;&gt;&gt;";
-	  return strbuf.str();
-	}
-
-      else 
+      if (name_to_index(name, "NULL_", _nnull) < 0)
 	return std::string("");
+
+      return "&lt;&lt;&lt;" + name + "&gt;&gt;&gt;";
     }
         
     /**
      * Provide a name for a public vertex.
-     * If ix is -1, add a new public else return indexed one
+     * If ix is -1 (or not allocated yet), add a new public else return
+     * indexed one
      *
-     * @param ix index of the public vertex in parsing orderame
+     * @param ix            index of the public vertex in parsing order
+     * @param allocated_ix  set to the index of the new public vertex
      *
-     * @return name for this public vertex (as NULL_1)
+     * @return name for this public vertex (as public_1)
      *
      */
     std::string
@@ -287,27 +333,18 @@ namespace clang_ast2dot
     {
       //std::cerr << "Ast2DotParser::public_to_name\n";
 
-      std::stringbuf strbuf("", std::ios_base::out);
-      std::ostream ostr(&strbuf);
+      std::string name("public_");
 
-      int mapsz = _name2public.size();
-      
-      if (ix == -1 || ix >= mapsz)
+      if (ix < 0 || (size_t)ix >= _npublic)
 	{
-	  int next_ix = mapsz;
-	  ostr << "public_" << next_ix;
-	  _name2public[next_ix] = strbuf.str();
-
 	  if (allocated_ix)
-	    *allocated_ix = next_ix;
-
-	  return _name2public[next_ix];
+	    *allocated_ix = _npublic;
+	  append_index(name, _npublic++);
 	}
+      else
+	append_index(name, ix);
 
-      else if (ix >= 0 && ix < mapsz)
-	return _name2public[ix];
-
-      return std::string("");
+      return name;
     }
         
     /**
@@ -315,7 +352,8 @@ namespace clang_ast2dot
      *
      * @param name  name of the public vertex
      *
-     * @return label for this public vertex (as PUBLIC_0)
+     * @return label for this public vertex (as public_0),
+     *         empty if name is not the one of an allocated public vertex
      *
      */
     std::string
@@ -323,33 +361,16 @@ namespace clang_ast2dot
     {
       //std::cerr << "Ast2DotParser::public_to_label\n";
 
-      std::stringbuf strbuf("", std::ios_base::out);
-      std::ostream ostr(&strbuf);
-
-      std::map<int, std::string>::iterator it = _name2public.begin();
-
-      do
-	{
-	  if (it->second.compare(name) == 0)
-	    break;
-	  it++;
-	}
-      while (it != _name2public.end());
-      
-      if (it != _name2public.end())
-	{
-	  ostr << "public_" << it->first;
-	  return strbuf.str();
-	}
-
-      else 
+      if (name_to_index(name, "public_", _npublic) < 0)
 	return std::string("");
+
+      return name;
     }
 
     /**
-     * Provide a public node index from the name registered in the map
+     * Provide a public node index from its name
      *
-     * @retval -1 if the name was not found in the map
+     * @retval -1 if the name is not the one of an allocated public vertex
      *
      * @return index
      *
@@ -357,212 +378,531 @@ namespace clang_ast2dot
     std::string
     Ast2DotParser::public_to_index(std::string const& name)
     {
-      //std::cerr << "Ast2DotParser::public_to_label\n";
+      //std::cerr << "Ast2DotParser::public_to_index\n";
 
-      std::stringbuf strbuf("", std::ios_base::out);
-      std::ostream ostr(&strbuf);
+      // Index of the public vertex
+      long ix = name_to_index(name, "public_", _npublic);
 
-      std::map<int, std::string>::iterator it = _name2public.begin();
+      if (ix < 0)
+	return std::string("-1");
 
-      do
-	{
-	  if (it->second.compare(name) == 0)
-	    break;
-	  it++;
-	}
-      while (it != _name2public.end());
+      return name.substr(strlen("public_"));
+    }
       
-      if (it != _name2public.end())
-	ostr << it->first;
+    /**
+     * Read properties of a vertex from a stream (until end of line)
+     *
+     * @return the vertex string, owned by the caller
+     */
+    std::string*
+    Ast2DotParser::read_vertex_props(std::istream* is, std::ostream* os)
+    {
+      //std::cerr << "Ast2DotParser::read_vertex_props\n";
+
+      _arena.reset();
+
+      std::getline(*is, _inbuf);
 
-      else 
-	ostr << -1;
+      if (!parse_vertex_line(boost::string_view(_inbuf)))
+        return new std::string("");
 
-      return strbuf.str();
+      boost::string_view vertex = vertex_string();
+
+      return new std::string(vertex.data(), vertex.size());
     }
-      
+
     /**
+     * Read properties of a vertex from an input buffer (until end of line)
      *
+     * @return the vertex string, owned by the caller
      */
     std::string*
-    Ast2DotParser::read_vertex_props(std::istream* is, std::ostream* os)
+    Ast2DotParser::read_vertex_props(Ast2DotInput* in, std::ostream* /* os */)
     {
       //std::cerr << "Ast2DotParser::read_vertex_props\n";
 
-      std::string ast;
-      std::string* astptr;
+      boost::string_view vertex = read_vertex(in);
 
-      std::string *ret = new std::string("");
-            
-      std::getline(*is, ast);
+      return new std::string(vertex.data(), vertex.size());
+    }
+
+    /**
+     * Read properties of a vertex from an input buffer (until end of line)
+     *
+     * The line is only a view in the input buffer: it is tokenized
+     * there without any copy, and the vertex string is built in the
+     * parser arena, reset at each line. Once the arena has grown to
+     * the largest line, no heap allocation is done.
+     *
+     * @return the vertex string (empty if line is empty), valid until
+     *         next read
+     */
+    boost::string_view
+    Ast2DotParser::read_vertex(Ast2DotInput* in)
+    {
+      boost::string_view line;
+
+      _arena.reset();
+
+      if (!in->getline(line) || !parse_vertex_line(line))
+        return boost::string_view();
 
-      if (!ast.empty())
+      return vertex_string();
+    }
+
+    /**
+     * Read the whole dump in a graph. The tree is built as by
+     * the tree relationship strings: a vertex is the child of the last
+     * vertex read with a lesser depth.
+     *
+     * @param in     input to read the dump from
+     * @param graph  graph the vertices are added to
+     * @param level  depth of the first vertex (0 unless reading a part
+     *               of a dump starting after its relationship string)
+     *
+     * @return number of vertices read
+     */
+    size_t
+    Ast2DotParser::read_graph(Ast2DotInput* in, Ast2DotGraph& graph, int level)
+    {
+      // Number of vertices read
+      size_t count = 0;
+
+      read_vertices(in, graph, level, -1, count);
+      Ast2DotStats::count(Ast2DotStats::NODES, count);
+
+      return count;
+    }
+
+    /**
+     * Read the next part of the dump in a graph: the root vertex, then a
+     * top level declaration with its subtree per call. A dump is so
+     * emitted part by part (orphans of a part being linked to the root),
+     * holding only the largest declaration in memory.
+     *
+     * @param in     input to read the dump from
+     * @param graph  graph the vertices are added to (cleared by the caller)
+     * @param level  depth of the first vertex, as returned by the
+     *               previous call (0 for the first part)
+     *
+     * @return depth of the first vertex of the next part, -1 at end of dump
+     */
+    int
+    Ast2DotParser::read_part(Ast2DotInput* in, Ast2DotGraph& graph, int level)
+    {
+      // Number of vertices read
+      size_t count = 0;
+
+      level = read_vertices(in, graph, level, 1, count);
+      Ast2DotStats::count(Ast2DotStats::NODES, count);
+
+      return level;
+    }
+
+    /**
+     * Read vertices in a graph until the next one is at most as deep as
+     * a depth, some vertices being read
+     *
+     * @param in     input to read the dump from
+     * @param graph  graph the vertices are added to
+     * @param level  depth of the first vertex
+     * @param stop   depth of the vertices ending the read (-1 for none)
+     * @param count  incremented by the number of vertices read
+     *
+     * @return depth of the next vertex (its relationship string being
+     *         read), -1 at end of dump
+     */
+    int
+    Ast2DotParser::read_vertices(Ast2DotInput* in, Ast2DotGraph& graph, int level, int stop, size_t& count)
+    {
+      while (!in->eof())
 	{
-          /*
-	   * Replace ":" with "\:"
-	   */
-	  size_t fpos = 0;
-	  do
+	  boost::string_view line;
+
+	  _arena.reset();
+
+	  if (!in->getline(line))
+	    graph.add_node(level, Ast2DotSymbols::NONE, Ast2DotGraph::EMPTY);
+	  else if (level > 0 && _filter.active() && !line.empty() &&
+		   !_filter.accept(level, line))
 	    {
-	      fpos = ast.find(":", fpos+3);
-	      if (fpos >= 0 && fpos != std::string::npos)
-		{
-		  std::string::iterator rstart = ast.begin() + fpos; 
-		  ast.insert(rstart, 1, '\\'); 
-		}
+	      // Rejected with its subtree, next vertex relationship string read
+	      if ((level = skip_subtree(in, level)) < 0 || (count && level <= stop))
+		return level;
+	      continue;
 	    }
-	  while (fpos != std::string::npos);
-
-	  /*
-	   * We quote AST special quotes (<<<...>>>, <<...>> and <...>) for
-	   * having the quoted string in one token
-	   */
-	  if (ast.find("<<<") != std::string::npos)
-	    ast = quote_special_quotes(ast, "<<<", ">>>", astptr);
-	  if (ast.find("<<") != std::string::npos &&
-	      ast.find("<<<") == std::string::npos)
-	    ast = quote_special_quotes(ast, "<<", ">>", astptr);
-	  if (ast.find("<") != std::string::npos &&
-	      ast.find("<<") == std::string::npos &&
-	      ast.find("<<<") == std::string::npos)
-	    ast = quote_special_quotes(ast, "<", ">", astptr);
-
-	  /*
-	   * let's start the real tokenizing work
-	   */
-	  // Init separator
-	  boost::escaped_list_separator<char> f("\\", " ", "\\\"");
-	  // And tokenizer
-	  boost::tokenizer<boost::escaped_list_separator<char> > tok(ast, f);
-	  // Start iteration
-	  boost::tokenizer<boost::escaped_list_separator<char> >::iterator it = tok.begin();
-
-	  _is_null = false;
-	  _name.clear();
-	  _label.clear();
-	  _address.clear();
-	  _props.clear();
-                
-	  do
+	  else if (_max_depth >= 0 && level > _max_depth && !line.empty())
 	    {
-	      // Name & address are always available but for <<<null>>>, where we have only this token
-	      _name = (*it);
-	      it++;
-	      if (it == tok.end())
+	      // Collapsed with the next deeper vertices, next relationship string read
+	      level = summarize(in, graph, line, level);
+	      count++;
+	      if (level < 0 || level <= stop)
+		return level;
+	      continue;
+	    }
+	  else if (!parse_vertex_line(line))
+	    graph.add_node(level, Ast2DotSymbols::NONE, Ast2DotGraph::EMPTY);
+	  else
+	    {
+	      Ast2DotStats::depth(level);
+	      add_vertex(graph, level);
+	    }
+	  count++;
+
+	  // Read relationship spec string, giving the next vertex level
+	  try
+	    {
+	      std::string const& scstr = read_sibling_child_string(in);
+
+	      // If the string is empty, we could be at end of file
+	      if (scstr.empty())
 		break;
 
-	      /*
-	       * handle some particular node cases ...
-	       */
+	      level = scstr.length() / 2;
+	      if (level <= stop)
+		return level;
+	    }
+	  catch (UnexpectedEofException const& ueofe)
+	    {
+	      break;
+	    }
+	  catch (EmptyScStrException const& esse)
+	    {
+	      break;
+	    }
+	  catch (InvalidScStrException const& isse)
+	    {
+	      break;
+	    }
+	}
 
-	      // ------------------------------------------
-	      // CXX Constructor Initializer
-	      if (_name.compare("CXXCtorInitializer") == 0)
-		{
-		  // Get next token and test if need to be skipped
-		  std::string tmp = (*it);
-		  it++;
-		  if (it == tok.end())
-		    break;
-
-		  // If 'Field' next token is address
-		  if (tmp.compare("Field") == 0)
-		    {
-		      _address = (*it);
-		      it++;
-		      if (it == tok.end())
-			break;		      
-		    }
-		}
+      return -1;
+    }
 
-	      // ------------------------------------------
-	      // original namespace
-	      else if (_name.compare("original") == 0)
-		{
-		  _name.append(*it);
-		  // Address
-		  _address = (*it);
-		  it++;
-		  if (it == tok.end())
-		    break;
-		}
+    /**
+     * Add the node of the vertex fields to a graph
+     *
+     * @param graph  graph the node is added to
+     * @param level  depth of the node
+     */
+    void
+    Ast2DotParser::add_vertex(Ast2DotGraph& graph, int level)
+    {
+      graph.add_node(level, _kind, 0);
 
-	      // ------------------------------------------
-	      // public, protected & private
-	      else if (_name.compare("public") != 0 &&
-		       _name.compare("protected") != 0 &&
-		       _name.compare("private") != 0)
-		{
-		  // Address
-		  _address = (*it);
-		  it++;
-		  if (it == tok.end())
-		    break;
-		}
+      // Name when not the kind
+      if (_kind == Ast2DotSymbols::NONE)
+	graph.add_name(_name);
+
+      // NULL & public numbers are given back by the emitters
+      if (_kind != Ast2DotSymbols::NULL_VERTEX &&
+	  _kind != Ast2DotSymbols::PUBLIC)
+	graph.set_address(_address);
+
+      for (size_t i = 0; i < _props.size(); i++)
+	graph.add_prop(_prop_syms[i], _props[i]);
+    }
+
+    /**
+     * Skip the subtree of a rejected vertex: the lines deeper than the
+     * vertex are only told by the length of their relationship string,
+     * their text being given to the filter only if it follows files.
+     *
+     * @param in     input to read the dump from
+     * @param level  depth of the rejected vertex
+     *
+     * @return depth of the next vertex (its relationship string being
+     *         read), -1 at end of dump
+     */
+    int
+    Ast2DotParser::skip_subtree(Ast2DotInput* in, int level)
+    {
+      for (;;)
+	{
+	  // Depth of the next line
+	  int next = next_level(in);
+
+	  if (next <= level)
+	    return next;
+
+	  boost::string_view line;
+	  in->getline(line);
+	  _filter.skip(line);
+	}
+    }
+
+    /**
+     * Depth of the next vertex, from its relationship string
+     *
+     * @return the depth, -1 at end of dump (or on an invalid string)
+     */
+    int
+    Ast2DotParser::next_level(Ast2DotInput* in)
+    {
+      try
+	{
+	  std::string const& scstr = read_sibling_child_string(in);
+
+	  if (scstr.empty())
+	    return -1;
+	  return scstr.length() / 2;
+	}
+      catch (UnexpectedEofException const& ueofe)
+	{
+	  return -1;
+	}
+      catch (EmptyScStrException const& esse)
+	{
+	  return -1;
+	}
+      catch (InvalidScStrException const& isse)
+	{
+	  return -1;
+	}
+    }
+
+    /**
+     * Collapse the vertices deeper than the max depth in one summary
+     * node: the child of the last vertex kept, giving the number of
+     * vertices collapsed and their most frequent kinds. Lines are only
+     * read for their depth and their kind (first word), subtrees
+     * rejected by the filter being skipped.
+     *
+     * @param in     input to read the dump from
+     * @param graph  graph the summary node is added to
+     * @param line   line of the first vertex collapsed
+     * @param level  depth of the first vertex collapsed
+     *
+     * @return depth of the next vertex (its relationship string being
+     *         read), -1 at end of dump
+     */
+    int
+    Ast2DotParser::summarize(Ast2DotInput* in, Ast2DotGraph& graph, boost::string_view const& line, int level)
+    {
+      // Line of the current vertex
+      boost::string_view cur = line;
+      // Number of vertices collapsed
+      size_t count = 0;
+      // Most frequent kinds
+      std::vector<std::pair<size_t, Ast2DotSymbols::Id> > kinds;
 
-	      // ------------------------------------------
-	      // Overrides
-	      else if (_name.compare("Overrides:") != 0)
+      _summary_kinds.clear();
+
+      for (;;)
+	{
+	  // First vertex was accepted by read_graph
+	  if (count > 0 && _filter.active() && !_filter.accept(level, cur))
+	    level = skip_subtree(in, level);
+	  else
+	    {
+	      if (!cur.empty())
 		{
-		  // Remove ':'
-		  _name.pop_back();
-		  
-		  // Skip '['
-		  it++;
-		  // Read address
-		  _address = (*it);
-		  it++;
-		  if (it == tok.end())
-		    break;
+		  Ast2DotSymbols::Id kind = _symbols.intern(cur.substr(0, cur.find(' ')));
+
+		  if (kind != Ast2DotSymbols::NONE)
+		    _summary_kinds[kind]++;
+		  count++;
 		}
-                    
-	      for (; it != tok.end(); ++it)
-		_props.push_back((*it));
+	      level = next_level(in);
 	    }
-	  while (it != tok.end());
-                
-	  std::stringbuf strbuf("", std::ios_base::out);
-	  std::ostream ostr(&strbuf);
 
-	  if (_name.compare("<<<NULL>>>") == 0)
+	  if (level <= _max_depth)
+	    break;
+
+	  in->getline(cur);
+	}
+
+      for (std::unordered_map<Ast2DotSymbols::Id, size_t>::const_iterator it = _summary_kinds.begin();
+	   it != _summary_kinds.end(); ++it)
+	kinds.push_back(std::make_pair(it->second, it->first));
+      std::sort(kinds.begin(), kinds.end(),
+		[](std::pair<size_t, Ast2DotSymbols::Id> const& a, std::pair<size_t, Ast2DotSymbols::Id> const& b)
+		{ return a.first > b.first || (a.first == b.first && a.second < b.second); });
+
+      graph.add_node(_max_depth + 1, Ast2DotSymbols::NONE, Ast2DotGraph::SUMMARY);
+
+      _inbuf.clear();
+      append_index(_inbuf, count);
+      _inbuf.append(count > 1 ? " nodes" : " node");
+      graph.add_prop(Ast2DotSymbols::NONE, _inbuf);
+
+      for (size_t k = 0; k < kinds.size() && k < AST2DOT_SUMMARY_KINDS; k++)
+	{
+	  boost::string_view text = _symbols.text(kinds[k].second);
+
+	  _inbuf.assign(text.data(), text.size()).append(" x");
+	  append_index(_inbuf, kinds[k].first);
+	  graph.add_prop(Ast2DotSymbols::NONE, _inbuf);
+	}
+
+      return level;
+    }
+
+    /**
+     * Is a prop token worth interning: addresses and source locations
+     * are almost never repeated
+     */
+    static inline bool
+    internable(boost::string_view const& tok)
+    {
+      if (tok.size() > 1 && tok[0] == '0' && tok[1] == 'x')
+	return false;
+
+      return tok.find_first_of(":/") == boost::string_view::npos;
+    }
+
+    /**
+     * Parse a line of the dump in the vertex fields
+     *
+     * @param ast  line of the dump (without tree relationship string)
+     *
+     * @return false if line is empty
+     */
+    bool
+    Ast2DotParser::parse_vertex_line(boost::string_view const& ast)
+    {
+      if (ast.empty())
+        return false;
+
+      unsigned long long start = Ast2DotStats::start(Ast2DotStats::TOKENIZE);
+
+      /*
+       * let's start the real tokenizing work: tokens are views in the
+       * line (or in the arena), AST special quotes (<<<...>>>, <<...>>
+       * and <...>) being kept in one token
+       */
+      size_t ntok = _tokenizer.tokenize(ast, &_arena);
+      std::vector<boost::string_view>& tok = _tokenizer.tokens();
+      // Next token
+      size_t it = 0;
+
+      _is_null = false;
+      _name.clear();
+      _label.clear();
+      _address.clear();
+      _props.clear();
+      _prop_syms.clear();
+
+      // Name & address are always available but for <<<null>>>, where we have only this token
+      _name.assign(tok[it].data(), tok[it].size());
+      _kind = _symbols.intern(tok[it]);
+      _label_sym = _kind;
+      it++;
+
+      /*
+       * handle some particular node cases ...
+       */
+
+      // Only one token
+      if (it == ntok)
+	;
+
+      // ------------------------------------------
+      // CXX Constructor Initializer
+      else if (_kind == Ast2DotSymbols::CXX_CTOR_INITIALIZER)
+	{
+	  // Get next token and test if need to be skipped
+	  boost::string_view tmp = tok[it++];
+
+	  // If 'Field' next token is address
+	  if (_symbols.find(tmp) == Ast2DotSymbols::FIELD && it < ntok)
 	    {
-	      _is_null = true;
-	      _name = null_to_name(-1);
-	      std::cerr << "NULL name = " << _name << "\n"; 
-	      _label = null_to_label(_name);
+	      _address.assign(tok[it].data(), tok[it].size());
+	      it++;
 	    }
-	  else if (_name.compare("public") == 0)
+	}
+
+      // ------------------------------------------
+      // original namespace
+      else if (_kind == Ast2DotSymbols::ORIGINAL)
+	{
+	  _name.append(tok[it].data(), tok[it].size());
+	  _label_sym = Ast2DotSymbols::NONE;
+	  // Address
+	  _address.assign(tok[it].data(), tok[it].size());
+	  it++;
+	}
+
+      // ------------------------------------------
+      // Overrides
+      else if (_kind == Ast2DotSymbols::OVERRIDES)
+	{
+	  // Remove ':'
+	  _name.pop_back();
+	  _label_sym = Ast2DotSymbols::NONE;
+
+	  // Skip '['
+	  it++;
+	  // Read address
+	  if (it < ntok)
 	    {
-	      _name = public_to_name(-1);
-	      std::cerr << "public name = " << _name << "\n"; 
-	      _address = public_to_index(_name);
-	      _label = public_to_label(_name);
+	      _address.assign(tok[it].data(), tok[it].size());
+	      it++;
 	    }
-	  else
-	    _label = _name;
-
-	  ostr << "    " << _name;
-	  if (!_address.empty())
-	    ostr << "_" << _address;
-                
-	  ostr << " [shape=record,style=filled,fillcolor=lightgrey,label=\"{ ";
-	  ostr << escape_dot_string(_label) << "| ";
-                
-	  if (!_address.empty())
-	    ostr << _address << "| ";
-
-	  for (std::vector<std::string>::iterator svit = _props.begin();
-	       svit != _props.end();
-	       ++svit)
-	    ostr << escape_dot_string(*svit) << "| ";
-                
-	  ostr << "}\"];\n";
-                
-	  ret = new std::string(strbuf.str());
 	}
-            
-      return ret;
+
+      // ------------------------------------------
+      // public, protected & private have no address
+      else if (_kind != Ast2DotSymbols::PUBLIC &&
+	       _kind != Ast2DotSymbols::PROTECTED &&
+	       _kind != Ast2DotSymbols::PRIVATE)
+	{
+	  // Address
+	  _address.assign(tok[it].data(), tok[it].size());
+	  it++;
+	}
+
+      // Recurring props are interned (not addresses nor locations)
+      for (; it < ntok; ++it)
+	{
+	  _props.push_back(tok[it]);
+	  _prop_syms.push_back(internable(tok[it]) ?
+			       _symbols.intern(tok[it]) : Ast2DotSymbols::NONE);
+	}
+
+      if (_kind == Ast2DotSymbols::NULL_VERTEX)
+	{
+	  _label_sym = Ast2DotSymbols::NONE;
+	  _is_null = true;
+	  // NULL_n, labeled <<<NULL_n>>>
+	  _name.assign("NULL_");
+	  append_index(_name, _nnull++);
+	  //std::cerr << "NULL name = " << _name << "\n";
+	  _label.assign("&lt;&lt;&lt;").append(_name).append("&gt;&gt;&gt;");
+	  Ast2DotStats::count(Ast2DotStats::NULL_NODES);
+	}
+      else if (_kind == Ast2DotSymbols::PUBLIC)
+	{
+	  _label_sym = Ast2DotSymbols::NONE;
+	  // public_n, address n
+	  append_index(_address, _npublic++);
+	  _name.assign("public_").append(_address);
+	  //std::cerr << "public name = " << _name << "\n";
+	  _label = _name;
+	  Ast2DotStats::count(Ast2DotStats::PUBLIC_NODES);
+	}
+      else
+	_label = _name;
+
+      Ast2DotStats::stop(Ast2DotStats::TOKENIZE, start);
+
+      return true;
     }
-        
+
+    /**
+     * Build the vertex string of the vertex fields: the line is added
+     * alone to a graph, formatted as the emitters do
+     *
+     * @return the vertex string, valid until next line
+     */
+    boost::string_view
+    Ast2DotParser::vertex_string(void)
+    {
+      _line.clear();
+      add_vertex(_line, 0);
+
+      return _formatter.vertex_string(_line, 0);
+    }
+
   } // ! parser
 } // ! clang_ast2dot
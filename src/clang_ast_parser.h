@@ -19,6 +19,7 @@
 
 #include <string>
 #include <iostream>
+#include <unordered_map>
 #include <vector>
 
 /**
@@ -26,6 +27,21 @@
  */
 #include <boost/regex.hpp>
 
+/**
+ * Own headers
+ */
+#include "clang_ast_input.h"
+#include "clang_ast_tokenizer.h"
+#include "clang_ast_arena.h"
+#include "clang_ast_symbols.h"
+#include "clang_ast_graph.h"
+#include "clang_ast_emitter.h"
+#include "clang_ast_filter.h"
+#include "clang_ast_stats.h"
+
+// Most frequent kinds shown by a summary vertex (--max-depth)
+#define AST2DOT_SUMMARY_KINDS                   3
+
 namespace clang_ast2dot
 {
     namespace parser
@@ -50,6 +66,11 @@ namespace clang_ast2dot
              */
             virtual std::string& read_sibling_child_string(std::istream *is = &std::cin);
 
+            /*
+             * Same, reading from an input buffer (mapped file or stdin)
+             */
+            virtual std::string& read_sibling_child_string(Ast2DotInput *);
+
             /*
              * Replace special quoting string with quoted one
              */
@@ -95,13 +116,37 @@ namespace clang_ast2dot
              */
             virtual std::string* read_vertex_props(std::istream *, std::ostream *);
 
+            /*
+             * Same, reading the line from an input buffer
+             */
+            virtual std::string* read_vertex_props(Ast2DotInput *, std::ostream *);
+
+            /*
+             * Same, without any copy: the vertex string is only valid until next read
+             */
+            virtual boost::string_view read_vertex(Ast2DotInput *);
+
+            /*
+             * Read the whole dump in a graph (returns the number of vertices),
+             * level being the depth of the first vertex
+             */
+            virtual size_t read_graph(Ast2DotInput *, Ast2DotGraph&, int level = 0);
+
+            /*
+             * Read the next part of the dump in a graph: the root vertex, then
+             * one top level declaration per call, level being the depth of its
+             * first vertex. Returns the depth of the vertex after the part (its
+             * relationship string read), -1 at end of dump.
+             */
+            virtual int read_part(Ast2DotInput *, Ast2DotGraph&, int level = 0);
+
             /*
              * Empty relationship string exception
              */
             class EmptyScStrException : public ::std::runtime_error
             {
               public:
-              EmptyScStrException() : ::std::runtime_error("Empty ScStr String Found") {};
+              EmptyScStrException() : ::std::runtime_error("Empty ScStr String Found") { Ast2DotStats::count(Ast2DotStats::EXCEPTIONS); };
                 virtual ~EmptyScStrException() {};
             };
 
@@ -111,7 +156,7 @@ namespace clang_ast2dot
             class InvalidScStrException : public ::std::runtime_error
             {
               public:
-              InvalidScStrException() : ::std::runtime_error("Invalid ScStr String Found") {};
+              InvalidScStrException() : ::std::runtime_error("Invalid ScStr String Found") { Ast2DotStats::count(Ast2DotStats::EXCEPTIONS); };
                 virtual ~InvalidScStrException() {};
             };
 
@@ -121,7 +166,7 @@ namespace clang_ast2dot
             class UnexpectedEofException : public ::std::runtime_error
             {
               public:
-              UnexpectedEofException() : std::runtime_error("Unexpected Eof while parsing ScStr") {};
+              UnexpectedEofException() : std::runtime_error("Unexpected Eof while parsing ScStr") { Ast2DotStats::count(Ast2DotStats::EXCEPTIONS); };
                 virtual ~UnexpectedEofException() {};
             };
 
@@ -143,9 +188,70 @@ namespace clang_ast2dot
             /* Address of the vertex (will be part of the vertex ID) */
             virtual std::string& address(void) { return _address; }
 
-            /* Vector of string used for loading vertex properties */
-            virtual std::vector<std::string>& props(void) { return _props; }
+            /* Vector of views used for loading vertex properties (valid until next line) */
+            virtual std::vector<boost::string_view>& props(void) { return _props; }
+
+            /* Symbol of the vertex kind (first token), NONE if not interned */
+            virtual Ast2DotSymbols::Id kind(void) { return _kind; }
+
+            /* Symbols of the vertex properties (NONE for the ones not interned) */
+            virtual std::vector<Ast2DotSymbols::Id>& prop_syms(void) { return _prop_syms; }
+
+            /* Symbol table of the parsed tokens */
+            virtual Ast2DotSymbols& symbols(void) { return _symbols; }
+
+            /* Subtree filter of read_graph (kinds interned in the symbol table) */
+            void set_filter(Ast2DotFilter const& filter) { _filter = filter; _filter.bind(_symbols); }
+            Ast2DotFilter& filter(void) { return _filter; }
+
+            /* Depth of the deepest vertices read by read_graph (-1 for all), deeper ones being summarized */
+            void set_max_depth(int depth) { _max_depth = depth; }
+            int max_depth(void) const { return _max_depth; }
             
+          protected:
+
+            /*
+             * Parse a line of the dump in the vertex fields
+             */
+            virtual bool parse_vertex_line(boost::string_view const&);
+
+            /*
+             * Build the vertex string of the vertex fields (by the emitter
+             * formatter)
+             */
+            virtual boost::string_view vertex_string(void);
+
+            /*
+             * Add the node of the vertex fields to a graph
+             */
+            void add_vertex(Ast2DotGraph&, int);
+
+            /*
+             * Read vertices in a graph until one at most as deep as a depth
+             * is next (the part read being not empty). Returns its depth (-1
+             * at end of dump).
+             */
+            int read_vertices(Ast2DotInput *, Ast2DotGraph&, int, int, size_t&);
+
+            /*
+             * Skip the subtree of a rejected vertex, returning the depth of
+             * the next vertex (-1 at end of dump)
+             */
+            virtual int skip_subtree(Ast2DotInput *, int);
+
+            /*
+             * Depth of the next vertex from its relationship string (-1 at
+             * end of dump)
+             */
+            int next_level(Ast2DotInput *);
+
+            /*
+             * Collapse the vertices deeper than max depth, from the line of
+             * the first one, in a summary node. Returns the depth of the
+             * next vertex (-1 at end of dump).
+             */
+            virtual int summarize(Ast2DotInput *, Ast2DotGraph&, boost::string_view const&, int);
+
           private:
 	    
             // Line buffer
@@ -160,23 +266,51 @@ namespace clang_ast2dot
             // Vertex name
             std::string _name;
 
+            // Vertex kind
+            Ast2DotSymbols::Id _kind;
+
+            // Vertex label symbol (NONE if label is not the kind)
+            Ast2DotSymbols::Id _label_sym;
+
             // Vertex label
             std::string _label;
 
             // Vertex address
             std::string _address;
 
-            // Other props (class dependent)
-            std::vector<std::string> _props;
+            // Other props (class dependent), views in the line
+            std::vector<boost::string_view> _props;
+
+            // Symbols of the props
+            std::vector<Ast2DotSymbols::Id> _prop_syms;
+
+            // Kinds and recurring tokens
+            Ast2DotSymbols _symbols;
+
+            // Line tokenizer
+            Ast2DotTokenizer _tokenizer;
+
+            // Per line text (unquoted tokens)
+            Ast2DotArena _arena;
+
+            // Node of the line read by read_vertex, and its vertex formatter
+            Ast2DotGraph _line;
+            Ast2DotEmitter _formatter;
+
+            // Subtrees skipped by read_graph
+            Ast2DotFilter _filter;
+
+            // Depth of the deepest vertices read (-1 for all)
+            int _max_depth;
 
-            // Null vertex are numbered
-            std::map<int, std::string> _name2null;
+            // Vertices of a summary by kind
+            std::unordered_map<Ast2DotSymbols::Id, size_t> _summary_kinds;
 
-            // Public vertex are also numbered (in addr)
-            std::map<int, std::string> _name2public;
+            // Null vertex are numbered (NULL_n)
+            size_t _nnull;
 
-	    // Number of public nodes
-	    int _npublic;
+            // Public vertex are also numbered (public_n, n being the address)
+            size_t _npublic;
         };
         
     } // ! namespace parser
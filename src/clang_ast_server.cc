@@ -0,0 +1,378 @@
+/**
+ * @file clang_ast_server.cc
+ */
+
+/**
+ * C System headers
+ *
+ * string.h for strncpy
+ * errno.h, unistd.h, sys/socket.h & sys/un.h for the sockets
+ */
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/**
+ * C++ System headers
+ *
+ * thread for the workers
+ */
+#include <iostream>
+#include <thread>
+#include <vector>
+
+// Include our defs
+#include "clang_ast_server.h"
+#include "clang_ast_stats.h"
+
+namespace clang_ast2dot
+{
+  namespace parser
+  {
+    /**
+     * Address of a socket path
+     *
+     * @return false if the path is too long
+     */
+    static bool
+    socket_address(std::string const& path, struct sockaddr_un& addr)
+    {
+      memset(&addr, 0, sizeof(addr));
+      addr.sun_family = AF_UNIX;
+      if (path.empty() || path.size() >= sizeof(addr.sun_path))
+        return false;
+      strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+      return true;
+    }
+
+    /**
+     * Write a whole block to a file descriptor, or to a socket (without
+     * SIGPIPE if closed)
+     *
+     * @return false on error
+     */
+    static bool
+    write_all(int fd, const char* data, size_t len, bool socket)
+    {
+      while (len > 0)
+        {
+          ssize_t n = socket ? ::send(fd, data, len, MSG_NOSIGNAL) : ::write(fd, data, len);
+
+          if (n < 0)
+            {
+              if (errno == EINTR)
+                continue;
+              return false;
+            }
+          data += n;
+          len -= n;
+        }
+
+      return true;
+    }
+
+    /**
+     * Output to a connection: a client leaving early is a write error of
+     * its request (no SIGPIPE)
+     */
+    class Ast2DotSocketOutput : public Ast2DotOutput
+    {
+      public:
+        Ast2DotSocketOutput() : Ast2DotOutput(-1) {}
+        virtual ~Ast2DotSocketOutput() {}
+
+      protected:
+        virtual void write_fd(const char* data, size_t len)
+        {
+          unsigned long long start = Ast2DotStats::start(Ast2DotStats::OUTPUT);
+
+          Ast2DotStats::count(Ast2DotStats::BYTES_OUT, len);
+          while (len > 0)
+            {
+              ssize_t n = ::send(_fd, data, len, MSG_NOSIGNAL);
+
+              if (n < 0)
+                {
+                  if (errno == EINTR)
+                    continue;
+                  throw WriteException();
+                }
+              data += n;
+              len -= n;
+            }
+          Ast2DotStats::stop(Ast2DotStats::OUTPUT, start);
+        }
+    };
+
+    /**
+     * Ast2DotServer Constructor: the socket is bound and listening, a
+     * socket file left by a server not running any more being replaced
+     *
+     * @param path   socket path
+     * @param batch  conversion settings and number of workers
+     *
+     * @throw SocketException if the socket cannot be created, or if a
+     *        server already listens on it
+     */
+    Ast2DotServer::Ast2DotServer(std::string const& path, Ast2DotBatch const& batch, size_t max_request)
+      : _path(path),
+        _fd(-1),
+        _batch(batch),
+        _max_request(max_request),
+        _stop(false),
+        _requests(0),
+        _failed(0)
+    {
+      struct sockaddr_un addr;
+
+      if (!socket_address(_path, addr))
+        throw SocketException(_path);
+
+      // Stale socket file, unless a server answers
+      _fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+      if (_fd < 0)
+        throw SocketException(_path);
+      if (::connect(_fd, (struct sockaddr*) &addr, sizeof(addr)) == 0)
+        {
+          ::close(_fd);
+          throw SocketException(_path);
+        }
+      ::close(_fd);
+      ::unlink(_path.c_str());
+
+      _fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+      if (_fd < 0)
+        throw SocketException(_path);
+      if (::bind(_fd, (struct sockaddr*) &addr, sizeof(addr)) != 0 ||
+          ::listen(_fd, AST2DOT_SERVER_BACKLOG) != 0)
+        {
+          ::close(_fd);
+          throw SocketException(_path);
+        }
+    }
+
+    /**
+     * Ast2DotServer Destructor
+     */
+    Ast2DotServer::~Ast2DotServer()
+    {
+      ::close(_fd);
+      ::unlink(_path.c_str());
+    }
+
+    /**
+     * Serve requests with the workers of the settings, until stopped
+     */
+    void
+    Ast2DotServer::serve(void)
+    {
+      std::vector<std::thread> workers;
+
+      for (unsigned j = 0; j < _batch.jobs(); j++)
+        workers.push_back(std::thread(&Ast2DotServer::work, this));
+      for (size_t j = 0; j < workers.size(); j++)
+        workers[j].join();
+    }
+
+    /**
+     * Stop serving: the workers waiting for a connection return, the
+     * others once their request is served
+     */
+    void
+    Ast2DotServer::stop(void)
+    {
+      _stop = true;
+      ::shutdown(_fd, SHUT_RDWR);
+    }
+
+    /**
+     * Worker: accept connections and serve them with its own parser,
+     * graph and buffers
+     */
+    void
+    Ast2DotServer::work(void)
+    {
+      Ast2DotStats::Merge merge;
+      Ast2DotParser parser;
+      Ast2DotGraph graph(parser.symbols());
+      Ast2DotSocketOutput out;
+      // Dump of the request
+      std::string dump;
+
+      _batch.setup(parser);
+
+      while (!_stop)
+        {
+          int fd = ::accept(_fd, (struct sockaddr*) NULL, (socklen_t*) NULL);
+
+          if (fd < 0)
+            {
+              if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+              break;
+            }
+
+          if (!handle(fd, parser, graph, dump, out))
+            _failed++;
+          ::close(fd);
+        }
+    }
+
+    /**
+     * Serve one connection: the dump is read until the client shuts down
+     * its side, then converted to the connection. Connections without
+     * dump (servers probing the socket) are not requests, dumps over the
+     * max request size are refused.
+     *
+     * @param fd      connection
+     * @param parser  parser of the worker
+     * @param graph   graph of the worker
+     * @param dump    request buffer of the worker
+     * @param out     output of the worker
+     *
+     * @return false on error
+     */
+    bool
+    Ast2DotServer::handle(int fd, Ast2DotParser& parser, Ast2DotGraph& graph, std::string& dump, Ast2DotOutput& out)
+    {
+      // Bytes of the request read
+      size_t len = 0;
+
+      for (;;)
+        {
+          ssize_t n;
+
+          if (dump.size() - len < AST2DOT_SERVER_BLOCK_SIZE)
+            dump.resize(len + AST2DOT_SERVER_BLOCK_SIZE);
+
+          n = ::read(fd, &dump[len], dump.size() - len);
+          if (n < 0)
+            {
+              if (errno == EINTR)
+                continue;
+              return false;
+            }
+          if (n == 0)
+            break;
+          len += n;
+
+          if (len > _max_request)
+            {
+              std::string error = std::string("// Error: request over ").append(std::to_string(_max_request))
+                .append(" bytes\n");
+
+              _requests++;
+              std::cerr << "[server] ** Error! request over " << _max_request << " bytes\n";
+              write_all(fd, error.data(), error.size(), true);
+              return false;
+            }
+        }
+
+      if (!len)
+        return true;
+      _requests++;
+
+      out.reset(fd);
+
+      try
+        {
+          Ast2DotMemoryInput in(dump.data(), len);
+
+          _batch.convert(&in, &out, parser, graph);
+          out.flush();
+        }
+      catch (std::exception const& e)
+        {
+          std::cerr << "[server] ** Error! " << e.what() << "\n";
+          out.reset(-1);
+          return false;
+        }
+
+      out.reset(-1);
+
+      return true;
+    }
+
+    /**
+     * Client: send a dump to a server, then copy the dot file it sends
+     * back
+     *
+     * @param path    socket path
+     * @param in_fd   dump
+     * @param out_fd  dot file
+     *
+     * @throw SocketException if the server cannot be connected
+     *
+     * @return false on error, or if the dot file is not complete
+     */
+    bool
+    Ast2DotServer::request(std::string const& path, int in_fd, int out_fd)
+    {
+      struct sockaddr_un addr;
+      std::vector<char> block(AST2DOT_SERVER_BLOCK_SIZE);
+      // Last bytes of the dot file
+      char tail[2] = { 0, 0 };
+      // Dump sent whole (the reply is read anyway: it tells why not)
+      bool sent = true;
+      bool ok = true;
+      int fd;
+
+      if (!socket_address(path, addr) || (fd = ::socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+        throw SocketException(path);
+      if (::connect(fd, (struct sockaddr*) &addr, sizeof(addr)) != 0)
+        {
+          ::close(fd);
+          throw SocketException(path);
+        }
+
+      // Dump sent
+      for (;;)
+        {
+          ssize_t n = ::read(in_fd, &block[0], block.size());
+
+          if (n < 0 && errno == EINTR)
+            continue;
+          if (n <= 0)
+            {
+              sent = n == 0;
+              break;
+            }
+          if (!write_all(fd, &block[0], n, true))
+            {
+              sent = false;
+              break;
+            }
+        }
+      ::shutdown(fd, SHUT_WR);
+
+      // Dot file received
+      while (ok)
+        {
+          ssize_t n = ::read(fd, &block[0], block.size());
+
+          if (n < 0 && errno == EINTR)
+            continue;
+          if (n <= 0)
+            {
+              ok = n == 0;
+              break;
+            }
+          if (n >= 2)
+            memcpy(tail, &block[n - 2], 2);
+          else
+            {
+              tail[0] = tail[1];
+              tail[1] = block[0];
+            }
+          ok = write_all(out_fd, &block[0], n, false);
+        }
+      ::close(fd);
+
+      return sent && ok && tail[0] == '}' && tail[1] == '\n';
+    }
+
+  } // ! parser
+} // ! clang_ast2dot
@@ -0,0 +1,138 @@
+/**
+ * @file clang_ast_server.h
+ *
+ */
+
+#ifndef _CLANG_AST_SERVER_H_
+#define _CLANG_AST_SERVER_H_
+
+/**
+ * C++ System headers
+ *
+ * atomic for the stop flag and the counters
+ * stdexcept for the socket errors
+ */
+#include <atomic>
+#include <stdexcept>
+#include <string>
+
+/**
+ * Own headers
+ */
+#include "clang_ast_batch.h"
+
+// Pending connections of the socket
+#define AST2DOT_SERVER_BACKLOG                  64
+
+// Size of the blocks read from and written to the sockets
+#define AST2DOT_SERVER_BLOCK_SIZE               (64 * 1024)
+
+// Largest dump of a request (bytes), larger ones are refused
+#define AST2DOT_SERVER_MAX_REQUEST_SIZE         (256 * 1024 * 1024)
+
+namespace clang_ast2dot
+{
+    namespace parser
+    {
+        /*
+         * Conversion server on a local (Unix domain) socket, for the tools
+         * converting many small dumps.
+         *
+         * A client connects, sends a dump and shuts down its side of the
+         * connection, then reads the dot file until the server closes the
+         * connection. A dot file not ending with the closing brace means the
+         * conversion failed. A dump is read whole before it is converted, so
+         * dumps larger than the max request size are refused, with an error
+         * line (a dot comment) as reply.
+         *
+         * Each worker accepts connections on the socket, so requests on
+         * separate connections are converted concurrently. A worker keeps
+         * its parser (and interned symbols), graph, request buffer and
+         * output buffer from one request to the next. Dumps are converted
+         * with the settings of a batch.
+         */
+        class Ast2DotServer
+        {
+          public:
+
+            /*
+             * Server explicit constructor (socket path, conversion settings
+             * and number of workers), the socket listening on return
+             */
+            Ast2DotServer(std::string const&, Ast2DotBatch const&,
+                          size_t max_request = AST2DOT_SERVER_MAX_REQUEST_SIZE);
+
+            /*
+             * Server destructor (close and remove the socket)
+             */
+            virtual ~Ast2DotServer(void);
+
+            /*
+             * Serve requests with the workers until stopped
+             */
+            virtual void serve(void);
+
+            /*
+             * Stop serving (the requests in progress are completed)
+             */
+            void stop(void);
+
+            /*
+             * Client: send a dump read from a file descriptor to a server and
+             * write the dot file to another one (returns false on error or if
+             * the conversion failed)
+             */
+            static bool request(std::string const&, int, int);
+
+            /* Requests served, and failed */
+            size_t requests(void) const { return _requests; }
+            size_t failed(void) const { return _failed; }
+
+            /*
+             * Error while creating or connecting the socket
+             */
+            class SocketException : public ::std::runtime_error
+            {
+              public:
+              SocketException(std::string const& path) : ::std::runtime_error(std::string("Cannot use socket '").append(path).append("'")) {};
+                virtual ~SocketException() {};
+            };
+
+          protected:
+
+            /*
+             * Worker: accept and serve connections
+             */
+            void work(void);
+
+            /*
+             * Serve one connection with the state of a worker
+             */
+            bool handle(int, Ast2DotParser&, Ast2DotGraph&, std::string&, Ast2DotOutput&);
+
+          private:
+
+            // Socket path
+            std::string _path;
+
+            // Listening socket
+            int _fd;
+
+            // Conversion settings
+            Ast2DotBatch const& _batch;
+
+            // Largest dump of a request
+            size_t _max_request;
+
+            // Stop accepting connections
+            std::atomic<bool> _stop;
+
+            // Requests served, and failed
+            std::atomic<size_t> _requests;
+            std::atomic<size_t> _failed;
+        };
+
+    } // ! namespace parser
+} // ! namespace clang_ast2dot
+
+#endif /* ! _CLANG_AST_SERVER_H_ */
@@ -0,0 +1,140 @@
+/**
+ * @file clang_ast_stats.cc
+ */
+
+// Include our defs
+#include "clang_ast_stats.h"
+
+/**
+ * C++ System headers
+ *
+ * algorithm for max
+ */
+#include <algorithm>
+
+namespace clang_ast2dot
+{
+  namespace parser
+  {
+    std::atomic<bool> Ast2DotStats::_enabled(false);
+    thread_local Ast2DotStats::Local Ast2DotStats::_local;
+    std::atomic<unsigned long long> Ast2DotStats::_ticks[Ast2DotStats::PHASES];
+    std::atomic<unsigned long long> Ast2DotStats::_calls[Ast2DotStats::PHASES];
+    std::atomic<unsigned long long> Ast2DotStats::_timed[Ast2DotStats::PHASES];
+    std::atomic<unsigned long long> Ast2DotStats::_counts[Ast2DotStats::COUNTERS];
+    std::atomic<int> Ast2DotStats::_max_depth(0);
+    unsigned long long Ast2DotStats::_start_ticks = 0;
+    std::chrono::steady_clock::time_point Ast2DotStats::_start_time;
+
+    /*
+     * Names of the phases and counters in the reports
+     */
+    static const char* const phase_names[Ast2DotStats::PHASES] =
+      {
+        "prefix", "line", "quote", "tokenize", "escape", "output"
+      };
+    static const char* const counter_names[Ast2DotStats::COUNTERS] =
+      {
+        "lines", "nodes", "null_nodes", "public_nodes", "bytes_in", "bytes_out", "exceptions"
+      };
+
+    /**
+     * Start timing and counting: the ticks per second are measured from
+     * now to the report
+     */
+    void
+    Ast2DotStats::enable(void)
+    {
+      _start_time = std::chrono::steady_clock::now();
+      _start_ticks = ticks();
+      _enabled = true;
+    }
+
+    /**
+     * Add the counters of the calling thread to the totals, and reset them
+     */
+    void
+    Ast2DotStats::merge(void)
+    {
+      int depth;
+
+      if (!enabled())
+        return;
+
+      for (int p = 0; p < PHASES; p++)
+        {
+          _ticks[p].fetch_add(_local.ticks[p], std::memory_order_relaxed);
+          _calls[p].fetch_add(_local.calls[p], std::memory_order_relaxed);
+          _timed[p].fetch_add(_local.timed[p], std::memory_order_relaxed);
+        }
+      for (int c = 0; c < COUNTERS; c++)
+        _counts[c].fetch_add(_local.counts[c], std::memory_order_relaxed);
+
+      depth = _max_depth.load(std::memory_order_relaxed);
+      while (_local.max_depth > depth &&
+             !_max_depth.compare_exchange_weak(depth, _local.max_depth, std::memory_order_relaxed))
+        ;
+
+      _local = Local();
+    }
+
+    /**
+     * Seconds spent in a phase by all threads, estimated from the calls
+     * timed
+     *
+     * @param phase  phase
+     */
+    double
+    Ast2DotStats::seconds(Phase phase)
+    {
+      double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - _start_time).count();
+      unsigned long long elapsed_ticks = ticks() - _start_ticks;
+      double seconds;
+
+      if (!elapsed_ticks || !_timed[phase])
+        return 0.0;
+
+      seconds = (double) _ticks[phase] * _calls[phase] / _timed[phase] * (elapsed / elapsed_ticks);
+
+      // Special quotes are searched while tokenizing
+      if (phase == TOKENIZE)
+        seconds = std::max(0.0, seconds - Ast2DotStats::seconds(QUOTE));
+
+      return seconds;
+    }
+
+    /**
+     * Report the totals, once the threads counting are over
+     *
+     * @param os    stream of the report
+     * @param json  JSON object (one line) rather than text
+     */
+    void
+    Ast2DotStats::report(std::ostream& os, bool json)
+    {
+      double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - _start_time).count();
+
+      merge();
+
+      if (json)
+        {
+          os << "{\"seconds\":" << elapsed << ",\"phases\":{";
+          for (int p = 0; p < PHASES; p++)
+            os << (p ? "," : "") << "\"" << phase_names[p] << "\":" << seconds((Phase) p);
+          os << "},\"counters\":{";
+          for (int c = 0; c < COUNTERS; c++)
+            os << "\"" << counter_names[c] << "\":" << _counts[c] << ",";
+          os << "\"max_depth\":" << _max_depth << "}}\n";
+          return;
+        }
+
+      os << "[stats] " << elapsed << " s\n";
+      for (int p = 0; p < PHASES; p++)
+        os << "[stats] " << phase_names[p] << " " << seconds((Phase) p) << " s\n";
+      for (int c = 0; c < COUNTERS; c++)
+        os << "[stats] " << counter_names[c] << " " << _counts[c] << "\n";
+      os << "[stats] max_depth " << _max_depth << "\n";
+    }
+
+  } // ! parser
+} // ! clang_ast2dot
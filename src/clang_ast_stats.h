@@ -0,0 +1,189 @@
+/**
+ * @file clang_ast_stats.h
+ *
+ */
+
+#ifndef _CLANG_AST_STATS_H_
+#define _CLANG_AST_STATS_H_
+
+/**
+ * C System headers
+ *
+ * x86intrin.h for the time stamp counter
+ */
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/**
+ * C++ System headers
+ *
+ * atomic for the totals of the threads
+ * chrono for the clock of the report (and the ticks without TSC)
+ */
+#include <atomic>
+#include <chrono>
+#include <iostream>
+
+// One call in N of the frequent phases is timed (power of 2)
+#define AST2DOT_STATS_SAMPLING                  16
+
+namespace clang_ast2dot
+{
+    namespace parser
+    {
+        /*
+         * Per phase timing and counters of the conversion (--stats).
+         *
+         * Phases are timed in time stamp counter ticks and counted in
+         * counters of the thread (no lock, nothing shared), added to the
+         * totals of the process when the thread is over. The per line
+         * phases are timed on one call in AST2DOT_STATS_SAMPLING, their
+         * time being scaled by their number of calls, output writes on
+         * every call. Special quotes are not part of the tokenizing time.
+         * When not enabled, timing and counting are a test of a flag.
+         */
+        class Ast2DotStats
+        {
+          public:
+
+            /*
+             * Phases timed
+             */
+            enum Phase
+              {
+                PREFIX = 0,     // relationship strings (read_sibling_child_string)
+                LINE,           // line reading
+                QUOTE,          // special quotes
+                TOKENIZE,       // tokenizing and vertex fields
+                ESCAPE,         // vertex strings and their escaping
+                OUTPUT,         // output writing
+                PHASES
+              };
+
+            /*
+             * Counters
+             */
+            enum Counter
+              {
+                LINES = 0,
+                NODES,
+                NULL_NODES,
+                PUBLIC_NODES,
+                BYTES_IN,
+                BYTES_OUT,
+                EXCEPTIONS,
+                COUNTERS
+              };
+
+            /*
+             * Start timing and counting (before any thread is started)
+             */
+            static void enable(void);
+            static bool enabled(void) { return _enabled.load(std::memory_order_relaxed); }
+
+            /* Current tick */
+            static unsigned long long ticks(void)
+            {
+#if defined(__x86_64__) || defined(__i386__)
+              return __rdtsc();
+#else
+              return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+            }
+
+            /* Start of a phase (0 if not enabled or not sampled) */
+            static unsigned long long start(Phase phase)
+            {
+              if (!enabled() ||
+                  ((_local.calls[phase]++ & (AST2DOT_STATS_SAMPLING - 1)) && phase != OUTPUT))
+                return 0;
+              return ticks();
+            }
+
+            /* End of a phase */
+            static void stop(Phase phase, unsigned long long start)
+            {
+              if (start)
+                {
+                  _local.ticks[phase] += ticks() - start;
+                  _local.timed[phase]++;
+                }
+            }
+
+            /* Count events */
+            static void count(Counter counter, unsigned long long n = 1)
+            {
+              if (enabled())
+                _local.counts[counter] += n;
+            }
+
+            /* Depth of a vertex */
+            static void depth(int level)
+            {
+              if (enabled() && level > _local.max_depth)
+                _local.max_depth = level;
+            }
+
+            /*
+             * Add the counters of the thread to the totals
+             */
+            static void merge(void);
+
+            /*
+             * Counters of a thread added to the totals when it is over
+             * (one in each thread function)
+             */
+            struct Merge
+            {
+              ~Merge() { merge(); }
+            };
+
+            /*
+             * Report the totals (of the threads over and of the calling
+             * one), as text or JSON
+             */
+            static void report(std::ostream&, bool json);
+
+            /* Totals */
+            static double seconds(Phase);
+            static unsigned long long total(Counter counter) { return _counts[counter]; }
+            static int max_depth(void) { return _max_depth; }
+
+          private:
+
+            /*
+             * Counters of a thread
+             */
+            struct Local
+            {
+              unsigned long long ticks[PHASES];
+              unsigned long long calls[PHASES];
+              unsigned long long timed[PHASES];
+              unsigned long long counts[COUNTERS];
+              int max_depth;
+            };
+
+            // Timing and counting (read by all the threads)
+            static std::atomic<bool> _enabled;
+
+            // Counters of the thread
+            static thread_local Local _local;
+
+            // Totals
+            static std::atomic<unsigned long long> _ticks[PHASES];
+            static std::atomic<unsigned long long> _calls[PHASES];
+            static std::atomic<unsigned long long> _timed[PHASES];
+            static std::atomic<unsigned long long> _counts[COUNTERS];
+            static std::atomic<int> _max_depth;
+
+            // Start, for the ticks per second
+            static unsigned long long _start_ticks;
+            static std::chrono::steady_clock::time_point _start_time;
+        };
+
+    } // ! namespace parser
+} // ! namespace clang_ast2dot
+
+#endif /* ! _CLANG_AST_STATS_H_ */
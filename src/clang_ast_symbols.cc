@@ -0,0 +1,404 @@
+/**
+ * @file clang_ast_symbols.cc
+ */
+
+/**
+ * C++ System headers
+ *
+ * algorithm for sorting the perfect hash buckets
+ */
+#include <algorithm>
+#include <stdint.h>
+
+// Include our defs
+#include "clang_ast_symbols.h"
+#include "clang_ast_escape.h"
+
+namespace clang_ast2dot
+{
+  namespace parser
+  {
+    /**
+     * Known symbols: the first ones are the Ast2DotSymbols::Known IDs,
+     * then the clang node kinds and the recurring keywords of the dump
+     */
+    static const char* const known_names[] =
+      {
+        // Ast2DotSymbols::Known
+        "<<<NULL>>>", "public", "protected", "private", "original",
+        "Overrides:", "CXXCtorInitializer", "Field", "prev", "parent",
+
+        // Declarations
+        "TranslationUnitDecl", "NamespaceDecl", "NamespaceAliasDecl",
+        "UsingDirectiveDecl", "UsingDecl", "UsingShadowDecl",
+        "LinkageSpecDecl", "TypedefDecl", "TypeAliasDecl",
+        "TypeAliasTemplateDecl", "RecordDecl", "CXXRecordDecl",
+        "ClassTemplateDecl", "ClassTemplateSpecializationDecl",
+        "ClassTemplatePartialSpecializationDecl", "EnumDecl",
+        "EnumConstantDecl", "FieldDecl", "IndirectFieldDecl", "FunctionDecl",
+        "FunctionTemplateDecl", "CXXMethodDecl", "CXXConstructorDecl",
+        "CXXDestructorDecl", "CXXConversionDecl", "ParmVarDecl", "VarDecl",
+        "VarTemplateDecl", "TemplateTypeParmDecl", "NonTypeTemplateParmDecl",
+        "TemplateTemplateParmDecl", "AccessSpecDecl", "FriendDecl",
+        "StaticAssertDecl", "LabelDecl", "EmptyDecl", "ImplicitParamDecl",
+        "TemplateArgument", "TemplateArgumentList",
+
+        // Statements
+        "CompoundStmt", "DeclStmt", "ReturnStmt", "IfStmt", "ForStmt",
+        "WhileStmt", "DoStmt", "SwitchStmt", "CaseStmt", "DefaultStmt",
+        "BreakStmt", "ContinueStmt", "GotoStmt", "LabelStmt", "NullStmt",
+        "CXXForRangeStmt", "CXXTryStmt", "CXXCatchStmt", "GCCAsmStmt",
+        "AttributedStmt",
+
+        // Expressions
+        "ImplicitCastExpr", "CStyleCastExpr", "CXXStaticCastExpr",
+        "CXXDynamicCastExpr", "CXXReinterpretCastExpr", "CXXConstCastExpr",
+        "CXXFunctionalCastExpr", "DeclRefExpr", "MemberExpr", "CallExpr",
+        "CXXMemberCallExpr", "CXXOperatorCallExpr", "CXXConstructExpr",
+        "CXXTemporaryObjectExpr", "CXXNewExpr", "CXXDeleteExpr",
+        "CXXThisExpr", "CXXBoolLiteralExpr", "CXXNullPtrLiteralExpr",
+        "CXXDefaultArgExpr", "CXXDefaultInitExpr", "CXXBindTemporaryExpr",
+        "CXXDependentScopeMemberExpr", "CXXUnresolvedConstructExpr",
+        "CXXThrowExpr", "CXXTypeidExpr", "CXXScalarValueInitExpr",
+        "CXXStdInitializerListExpr", "ExprWithCleanups",
+        "MaterializeTemporaryExpr", "UnresolvedLookupExpr",
+        "UnresolvedMemberExpr", "DependentScopeDeclRefExpr",
+        "IntegerLiteral", "FloatingLiteral", "CharacterLiteral",
+        "StringLiteral", "ImaginaryLiteral", "UserDefinedLiteral",
+        "BinaryOperator", "CompoundAssignOperator", "UnaryOperator",
+        "ConditionalOperator", "BinaryConditionalOperator", "ParenExpr",
+        "ParenListExpr", "ArraySubscriptExpr", "InitListExpr",
+        "ImplicitValueInitExpr", "DesignatedInitExpr",
+        "UnaryExprOrTypeTraitExpr", "OffsetOfExpr", "StmtExpr",
+        "PredefinedExpr", "LambdaExpr", "PackExpansionExpr",
+        "SizeOfPackExpr", "SubstNonTypeTemplateParmExpr", "ConstantExpr",
+        "OpaqueValueExpr", "VAArgExpr", "AddrLabelExpr", "TypeTraitExpr",
+        "CXXNoexceptExpr",
+
+        // Types
+        "BuiltinType", "PointerType", "LValueReferenceType",
+        "RValueReferenceType", "ConstantArrayType", "IncompleteArrayType",
+        "VariableArrayType", "DependentSizedArrayType", "FunctionProtoType",
+        "FunctionNoProtoType", "ParenType", "TypedefType", "ElaboratedType",
+        "RecordType", "EnumType", "TemplateTypeParmType",
+        "SubstTemplateTypeParmType", "TemplateSpecializationType",
+        "InjectedClassNameType", "DependentNameType", "DecltypeType",
+        "AutoType", "MemberPointerType", "ComplexType", "VectorType",
+        "AttributedType", "PackExpansionType", "QualType", "DecayedType",
+        "TypeOfExprType",
+
+        // Type referenced declarations
+        "Typedef", "Record", "CXXRecord", "Enum", "TemplateTypeParm",
+        "ClassTemplateSpecialization", "Function", "Var", "ParmVar",
+        "EnumConstant", "CXXMethod", "CXXConstructor", "Namespace",
+
+        // Attributes
+        "AbiTagAttr", "AlignedAttr", "AllocSizeAttr", "AlwaysInlineAttr",
+        "AsmLabelAttr", "ConstAttr", "DeprecatedAttr", "FormatAttr",
+        "FormatArgAttr", "MallocAttr", "ModeAttr", "NoThrowAttr",
+        "NonNullAttr", "PackedAttr", "PureAttr", "ReturnsNonNullAttr",
+        "RestrictAttr", "SentinelAttr", "UnusedAttr", "UsedAttr",
+        "VisibilityAttr", "WarnUnusedResultAttr", "BuiltinAttr",
+        "NoInlineAttr", "FinalAttr", "OverrideAttr",
+
+        // Comments
+        "FullComment", "ParagraphComment", "TextComment",
+        "BlockCommandComment", "ParamCommandComment", "InlineCommandComment",
+        "VerbatimLineComment",
+
+        // Recurring keywords
+        "lvalue", "xvalue", "prvalue", "implicit", "referenced", "used",
+        "extern", "static", "inline", "definition", "struct", "union",
+        "class", "sugar", "imported", "invalid", "cinit", "callinit",
+        "listinit", "const", "volatile", "virtual", "default", "delete",
+        "trivial", "constexpr", "prefix", "postfix", "bitfield", "mutable",
+        "cannot", "overflow", "'int'", "'char'", "'long'",
+        "'void'", "'_Bool'", "'bool'", "'double'", "'float'", "'size_t'",
+        "'int", "'unsigned", "'char", "'long", "'void", "'const",
+        "'struct", "'union", "'enum", "'class", "int'", "long'", "char'",
+        "void'", "*'", "*", "&'", "<LValueToRValue>", "<IntegralCast>",
+        "<ArrayToPointerDecay>", "<FunctionToPointerDecay>", "<NoOp>",
+        "<BitCast>", "<NullToPointer>", "<IntegralToBoolean>",
+        "<PointerToBoolean>", "<IntegralToFloating>", "<FloatingCast>",
+        "<UncheckedDerivedToBase>", "<DerivedToBase>", "<ToVoid>",
+        "<ConstructorConversion>", "<UserDefinedConversion>", "'='", "'+'",
+        "'-'", "'*'", "'/'", "'<'", "'>'", "'<='", "'>='", "'=='", "'!='",
+        "'&&'", "'||'", "'!'", "'&'", "'++'", "'--'", "'+='", "'-='", "'->'",
+        "'.'", "0", "1", "''"
+      };
+
+    // Number of known symbols
+    static const size_t nknown = sizeof(known_names) / sizeof(known_names[0]);
+
+    /**
+     * Hash of a token (FNV-1a)
+     */
+    static inline uint64_t
+    hash_token(boost::string_view const& str)
+    {
+      uint64_t h = 14695981039346656037ULL;
+
+      for (size_t i = 0; i < str.size(); i++)
+        {
+          h ^= (unsigned char)str[i];
+          h *= 1099511628211ULL;
+        }
+
+      return h;
+    }
+
+    /**
+     * Mix a hash with a displacement (murmur3 finalizer)
+     */
+    static inline uint64_t
+    mix_hash(uint64_t h, uint64_t d)
+    {
+      h += d * 0x9e3779b97f4a7c15ULL;
+      h ^= h >> 33;
+      h *= 0xff51afd7ed558ccdULL;
+      h ^= h >> 33;
+      h *= 0xc4ceb9fe1a85ec53ULL;
+      h ^= h >> 33;
+      return h;
+    }
+
+    /**
+     * Perfect hash of the known symbols (hash and displace).
+     * Keys are spread in buckets, then each bucket gets the first
+     * displacement putting all its keys in free slots: a lookup is
+     * one hash, one slot and one compare.
+     */
+    struct Ast2DotSymbols::KnownTable
+    {
+      // Text of the symbols
+      std::vector<boost::string_view> text;
+      // Text of the symbols escaped for dot
+      std::vector<std::string> escaped;
+      std::vector<boost::string_view> escaped_text;
+      // Displacement of each bucket
+      std::vector<uint32_t> disp;
+      // Symbol of each slot
+      std::vector<Ast2DotSymbols::Id> slots;
+      // Slot mask
+      uint64_t mask;
+
+      KnownTable()
+      {
+        // Hashes of the symbols
+        std::vector<uint64_t> hashes(nknown);
+        // Bucket of the symbols (bucket size, bucket index)
+        std::vector<std::vector<size_t> > buckets(nknown / 2 + 1);
+
+        escaped.reserve(nknown);
+        for (size_t i = 0; i < nknown; i++)
+          {
+            text.push_back(boost::string_view(known_names[i]));
+            escaped.push_back(std::string());
+            escape_dot_string_append(text[i], escaped[i]);
+            escaped_text.push_back(escaped[i]);
+            hashes[i] = hash_token(text[i]);
+            buckets[bucket(hashes[i])].push_back(i);
+          }
+
+        size_t size = 1;
+        while (size < 2 * nknown)
+          size <<= 1;
+        mask = size - 1;
+        slots.assign(size, Ast2DotSymbols::NONE);
+        disp.assign(buckets.size(), 0);
+
+        // Largest buckets first
+        std::vector<std::pair<size_t, size_t> > order;
+        for (size_t b = 0; b < buckets.size(); b++)
+          order.push_back(std::make_pair(buckets[b].size(), b));
+        std::sort(order.rbegin(), order.rend());
+
+        for (size_t o = 0; o < order.size() && order[o].first; o++)
+          {
+            std::vector<size_t>& keys = buckets[order[o].second];
+            // Slots tried for this displacement
+            std::vector<uint64_t> tried;
+
+            for (uint32_t d = 0; ; d++)
+              {
+                tried.clear();
+                for (size_t k = 0; k < keys.size(); k++)
+                  {
+                    uint64_t s = mix_hash(hashes[keys[k]], d) & mask;
+                    if (slots[s] != Ast2DotSymbols::NONE ||
+                        std::find(tried.begin(), tried.end(), s) != tried.end())
+                      break;
+                    tried.push_back(s);
+                  }
+
+                if (tried.size() == keys.size())
+                  {
+                    disp[order[o].second] = d;
+                    for (size_t k = 0; k < keys.size(); k++)
+                      slots[tried[k]] = keys[k];
+                    break;
+                  }
+              }
+          }
+      }
+
+      size_t bucket(uint64_t h) const
+      {
+        return (h >> 32) % (nknown / 2 + 1);
+      }
+
+      Ast2DotSymbols::Id find(boost::string_view const& str, uint64_t h) const
+      {
+        Ast2DotSymbols::Id id = slots[mix_hash(h, disp[bucket(h)]) & mask];
+
+        if (id != Ast2DotSymbols::NONE && text[id] == str)
+          return id;
+
+        return Ast2DotSymbols::NONE;
+      }
+    };
+
+    /**
+     * Known symbols table, built on first use (and not at static
+     * initialization, as it uses the escape table)
+     */
+    static const Ast2DotSymbols::KnownTable&
+    known_table(void)
+    {
+      static const Ast2DotSymbols::KnownTable table;
+      return table;
+    }
+
+    const Ast2DotSymbols::Id Ast2DotSymbols::NONE;
+
+    /**
+     * Ast2DotSymbols Constructor
+     *
+     * @param max  max number of interned symbols
+     */
+    Ast2DotSymbols::Ast2DotSymbols(size_t max)
+      : _nknown(nknown),
+        _known(&known_table()),
+        _known_text(&_known->text[0]),
+        _known_escaped(&_known->escaped_text[0]),
+        _max(max),
+        _slots(1024, NONE)
+    {
+    }
+
+    /**
+     * Ast2DotSymbols Destructor
+     */
+    Ast2DotSymbols::~Ast2DotSymbols()
+    {
+    }
+
+    /**
+     * Number of known symbols
+     */
+    size_t
+    Ast2DotSymbols::known(void)
+    {
+      return nknown;
+    }
+
+    /**
+     * Find a token in the known then in the interned symbols
+     *
+     * @param str  token
+     *
+     * @return symbol ID or NONE
+     */
+    Ast2DotSymbols::Id
+    Ast2DotSymbols::find(boost::string_view const& str) const
+    {
+      // Hash of the token
+      uint64_t h = hash_token(str);
+      // Known symbol
+      Id id = _known->find(str, h);
+
+      if (id != NONE)
+        return id;
+
+      size_t mask = _slots.size() - 1;
+      for (size_t s = h & mask; _slots[s] != NONE; s = (s + 1) & mask)
+        {
+          Entry const& e = _entries[_slots[s]];
+          if (e.hash == h && e.text == str)
+            return _nknown + _slots[s];
+        }
+
+      return NONE;
+    }
+
+    /**
+     * Find a token, interning it if it is not a known symbol nor an
+     * already interned one
+     *
+     * @param str  token
+     *
+     * @return symbol ID, NONE if the token is too long or the table full
+     */
+    Ast2DotSymbols::Id
+    Ast2DotSymbols::intern(boost::string_view const& str)
+    {
+      if (str.size() > AST2DOT_SYMBOL_MAX_LENGTH)
+        return NONE;
+
+      // Hash of the token
+      uint64_t h = hash_token(str);
+      // Known symbol
+      Id id = _known->find(str, h);
+
+      if (id != NONE)
+        return id;
+
+      size_t mask = _slots.size() - 1;
+      size_t s = h & mask;
+      for (; _slots[s] != NONE; s = (s + 1) & mask)
+        {
+          Entry const& e = _entries[_slots[s]];
+          if (e.hash == h && e.text == str)
+            return _nknown + _slots[s];
+        }
+
+      if (_entries.size() >= _max)
+        return NONE;
+
+      // New symbol, text and escaped text kept in the table
+      Entry e;
+      e.text = _text.copy(str);
+      char* esc = _text.allocate(escaped_dot_string_size(str));
+      e.escaped = boost::string_view(esc, escape_dot_string_copy(str, esc) - esc);
+      e.hash = h;
+
+      _slots[s] = _entries.size();
+      _entries.push_back(e);
+
+      // Keep load under 1/2
+      if (2 * _entries.size() > _slots.size())
+        grow();
+
+      return _nknown + _entries.size() - 1;
+    }
+
+    /**
+     * Double the hash slots and put back the interned symbols
+     */
+    void
+    Ast2DotSymbols::grow(void)
+    {
+      _slots.assign(2 * _slots.size(), NONE);
+
+      size_t mask = _slots.size() - 1;
+      for (size_t i = 0; i < _entries.size(); i++)
+        {
+          size_t s = _entries[i].hash & mask;
+          while (_slots[s] != NONE)
+            s = (s + 1) & mask;
+          _slots[s] = i;
+        }
+    }
+
+  } // ! parser
+} // ! clang_ast2dot
@@ -0,0 +1,160 @@
+/**
+ * @file clang_ast_symbols.h
+ *
+ */
+
+#ifndef _CLANG_AST_SYMBOLS_H_
+#define _CLANG_AST_SYMBOLS_H_
+
+/**
+ * C++ System headers
+ *
+ * vector for the symbol entries and hash slots
+ */
+#include <string>
+#include <vector>
+
+/**
+ * Boost headers
+ */
+#include <boost/utility/string_view.hpp>
+
+/**
+ * Own headers
+ */
+#include "clang_ast_arena.h"
+
+// Max number of symbols interned while parsing (others are kept as text)
+#define AST2DOT_SYMBOLS_MAX                     (1 << 20)
+
+// Tokens longer than this are not interned
+#define AST2DOT_SYMBOL_MAX_LENGTH               64
+
+namespace clang_ast2dot
+{
+    namespace parser
+    {
+        /*
+         * Symbol table of the AST dump tokens.
+         *
+         * Clang node kinds and the recurring keywords of the dump are known
+         * symbols, found with a perfect hash built once from a static list.
+         * Other recurring tokens are interned while parsing in an open
+         * addressing table. A symbol is a small integer ID, with its text and
+         * its text escaped for dot kept in the table.
+         */
+        class Ast2DotSymbols
+        {
+          public:
+
+            // Symbol ID
+            typedef unsigned int Id;
+
+            // No symbol (token not interned)
+            static const Id NONE = (Id)-1;
+
+            /*
+             * IDs of the known symbols the parser dispatches on
+             * (first ones of the static list)
+             */
+            enum Known
+              {
+                NULL_VERTEX = 0,        // <<<NULL>>>
+                PUBLIC,                 // public
+                PROTECTED,              // protected
+                PRIVATE,                // private
+                ORIGINAL,               // original
+                OVERRIDES,              // Overrides:
+                CXX_CTOR_INITIALIZER,   // CXXCtorInitializer
+                FIELD,                  // Field
+                PREV,                   // prev
+                PARENT                  // parent
+              };
+
+            /*
+             * Symbol table explicit constructor
+             */
+            Ast2DotSymbols(size_t max = AST2DOT_SYMBOLS_MAX);
+
+            /*
+             * Symbol table destructor
+             */
+            virtual ~Ast2DotSymbols(void);
+
+            /*
+             * Find the ID of a token, NONE if not interned
+             */
+            Id find(boost::string_view const&) const;
+
+            /*
+             * Find the ID of a token, interning it if needed
+             * (NONE if too long or table full)
+             */
+            Id intern(boost::string_view const&);
+
+            /* Text of a symbol */
+            boost::string_view text(Id id) const
+            { return id < _nknown ? _known_text[id] : _entries[id - _nknown].text; }
+
+            /* Text of a symbol escaped for dot */
+            boost::string_view escaped(Id id) const
+            { return id < _nknown ? _known_escaped[id] : _entries[id - _nknown].escaped; }
+
+            /* Number of symbols (known and interned) */
+            size_t size(void) const { return _nknown + _entries.size(); }
+
+            /* Number of known symbols */
+            static size_t known(void);
+
+            /* Is the ID one of a known symbol */
+            static bool is_known(Id id) { return id < known(); }
+
+            /*
+             * Perfect hash table of the known symbols
+             */
+            struct KnownTable;
+
+          private:
+
+            /*
+             * Interned symbol
+             */
+            struct Entry
+            {
+              boost::string_view text;
+              boost::string_view escaped;
+              size_t hash;
+            };
+
+            /*
+             * Double the interned symbols hash slots
+             */
+            void grow(void);
+
+            // Number of known symbols
+            size_t _nknown;
+
+            // Known symbols (shared by all tables)
+            const KnownTable* _known;
+
+            // Text and escaped text of the known symbols
+            const boost::string_view* _known_text;
+            const boost::string_view* _known_escaped;
+
+            // Max number of interned symbols
+            size_t _max;
+
+            // Interned symbols
+            std::vector<Entry> _entries;
+
+            // Hash slots of the interned symbols (index in _entries or NONE)
+            std::vector<Id> _slots;
+
+            // Text of the interned symbols
+            Ast2DotArena _text;
+        };
+
+    } // ! namespace parser
+} // ! namespace clang_ast2dot
+
+#endif /* ! _CLANG_AST_SYMBOLS_H_ */
@@ -0,0 +1,202 @@
+/**
+ * @file clang_ast_tokenizer.cc
+ */
+
+/**
+ * C System headers
+ *
+ * string.h for memcpy
+ */
+#include <string.h>
+
+// Include our defs
+#include "clang_ast_tokenizer.h"
+#include "clang_ast_stats.h"
+
+namespace clang_ast2dot
+{
+  namespace parser
+  {
+    /**
+     * Ast2DotTokenizer Constructor
+     */
+    Ast2DotTokenizer::Ast2DotTokenizer()
+    {
+      _tokens.reserve(16);
+    }
+
+    /**
+     * Ast2DotTokenizer Destructor
+     */
+    Ast2DotTokenizer::~Ast2DotTokenizer()
+    {
+    }
+
+    /**
+     * Find the special quoted region of a line.
+     * Only the first <<<...>>> is quoted, or if none the first <<...>>,
+     * or if none the first <...>
+     *
+     * @param line   line of the dump
+     * @param begin  set to the position of the opening quote
+     * @param end    set to the position following the closing quote
+     *
+     * @return true if a special quoted region was found
+     */
+    bool
+    Ast2DotTokenizer::special_quotes(boost::string_view const& line, size_t& begin, size_t& end)
+    {
+      // In quote string
+      const char* in_quote = "";
+      // Out quote string
+      const char* out_quote = "";
+      // Quote strings length
+      size_t len = 0;
+
+      if (line.find("<<<") != boost::string_view::npos)
+        {
+          in_quote = "<<<";
+          out_quote = ">>>";
+          len = 3;
+        }
+      else if (line.find("<<") != boost::string_view::npos)
+        {
+          in_quote = "<<";
+          out_quote = ">>";
+          len = 2;
+        }
+      else if (line.find('<') != boost::string_view::npos)
+        {
+          in_quote = "<";
+          out_quote = ">";
+          len = 1;
+        }
+      else
+        return false;
+
+      // 'in' must be before 'out'
+      size_t curpos = line.find(in_quote);
+      size_t lastpos = line.find(out_quote);
+      if (lastpos == boost::string_view::npos || curpos >= lastpos)
+        return false;
+
+      // Closing quote is the first one after the opening one
+      size_t closepos = line.find(out_quote, curpos + len);
+      if (closepos == boost::string_view::npos)
+        return false;
+
+      begin = curpos;
+      end = closepos + len;
+
+      return true;
+    }
+
+    /**
+     * Split a line in tokens.
+     *
+     * Tokens are split on each single space out of quotes, so two spaces
+     * give an empty token. Tokens are views in the line unless a char
+     * had to be removed from them (double quotes, escapes): they are then
+     * copied in the unquoted buffer, sized for the whole line, taken from
+     * the arena if one is given (then tokens live as long as the arena
+     * is not reset).
+     *
+     * @param line   line of the dump (without tree relationship string)
+     * @param arena  arena for the unquoted buffer (or NULL)
+     *
+     * @return number of tokens
+     */
+    size_t
+    Ast2DotTokenizer::tokenize(boost::string_view const& line, Ast2DotArena* arena)
+    {
+      // Line chars
+      const char* p = line.data();
+      // Line length
+      size_t n = line.size();
+      // Special quoted region
+      size_t qbegin = boost::string_view::npos;
+      size_t qend = boost::string_view::npos;
+      // Inside quotes
+      bool in_quote = false;
+      // Start of current token in line
+      size_t tstart = 0;
+      // Current token is copied in unquoted buffer
+      bool copied = false;
+      // Special quotes search, timed apart from the tokenizing
+      unsigned long long start = Ast2DotStats::start(Ast2DotStats::QUOTE);
+      // Unquoted buffer (allocated on first copy)
+      char* ubuf = (char*)NULL;
+      // Start of current token in unquoted buffer
+      char* ustart = (char*)NULL;
+      // End of unquoted buffer
+      char* u = (char*)NULL;
+
+      _tokens.clear();
+
+      if (!special_quotes(line, qbegin, qend))
+        qbegin = qend = boost::string_view::npos;
+      Ast2DotStats::stop(Ast2DotStats::QUOTE, start);
+
+      for (size_t i = 0; i <= n; i++)
+        {
+          // Special quotes act as if a double quote was around them
+          if (i == qbegin || i == qend)
+            in_quote = !in_quote;
+
+          // End of line or separator: end of token
+          if (i == n || (p[i] == ' ' && !in_quote))
+            {
+              if (copied)
+                _tokens.push_back(boost::string_view(ustart, u - ustart));
+              else
+                _tokens.push_back(boost::string_view(p + tstart, i - tstart));
+              tstart = i + 1;
+              copied = false;
+              continue;
+            }
+
+          // Double quotes and escapes remove chars from the token
+          if (p[i] == '"' ||
+              (p[i] == '\\' && i + 1 < n &&
+               (p[i + 1] == 'n' || p[i + 1] == '"' || p[i + 1] == '\\' || p[i + 1] == ' ')))
+            {
+              // Switch to copy
+              if (!copied)
+                {
+                  if (!ubuf)
+                    {
+                      if (arena)
+                        ubuf = arena->allocate(n);
+                      else
+                        {
+                          if (_unquoted.size() < n)
+                            _unquoted.resize(n);
+                          ubuf = &_unquoted[0];
+                        }
+                      u = ubuf;
+                    }
+                  ustart = u;
+                  memcpy(u, p + tstart, i - tstart);
+                  u += i - tstart;
+                  copied = true;
+                }
+
+              if (p[i] == '"')
+                in_quote = !in_quote;
+              else
+                {
+                  // Escaped char
+                  i++;
+                  *u++ = (p[i] == 'n') ? '\n' : p[i];
+                }
+            }
+
+          else if (copied)
+            *u++ = p[i];
+        }
+
+      return _tokens.size();
+    }
+
+  } // ! parser
+} // ! clang_ast2dot
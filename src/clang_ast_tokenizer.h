@@ -0,0 +1,88 @@
+/**
+ * @file clang_ast_tokenizer.h
+ *
+ */
+
+#ifndef _CLANG_AST_TOKENIZER_H_
+#define _CLANG_AST_TOKENIZER_H_
+
+/**
+ * C++ System headers
+ *
+ * vector for the token list
+ */
+#include <string>
+#include <vector>
+
+/**
+ * Boost headers
+ */
+#include <boost/utility/string_view.hpp>
+
+/**
+ * Own headers
+ */
+#include "clang_ast_arena.h"
+
+namespace clang_ast2dot
+{
+    namespace parser
+    {
+        /*
+         * Tokenizer of the vertex property lines of an AST dump.
+         *
+         * Tokens are separated by single spaces. The clang special quotes
+         * <<<...>>>, <<...>> or <...> (only the first one found, in this order
+         * of precedence) are kept in one token, as are "..." strings (the
+         * double quotes being removed) and \-escaped chars.
+         *
+         * Single quoted types are not kept in one token: 'int (void)' is
+         * 'int and (void)', as split by the boost tokenizer this replaces,
+         * since each token is a field of the vertex label and the dot output
+         * is kept the same.
+         *
+         * Tokens are views in the line, or in an unquoted buffer for the few
+         * ones that had chars removed. They are valid until next tokenize call
+         * (or arena reset) and as long as the line is.
+         */
+        class Ast2DotTokenizer
+        {
+          public:
+
+            /*
+             * Tokenizer explicit constructor
+             */
+            Ast2DotTokenizer(void);
+
+            /*
+             * Tokenizer destructor
+             */
+            virtual ~Ast2DotTokenizer(void);
+
+            /*
+             * Split a line in tokens, return the number of tokens
+             */
+            size_t tokenize(boost::string_view const&, Ast2DotArena * = (Ast2DotArena *)NULL);
+
+            /* Tokens of the last line */
+            std::vector<boost::string_view>& tokens(void) { return _tokens; }
+
+            /*
+             * Find the special quoted region of a line ([begin, end) in line)
+             * Return false if line has none.
+             */
+            static bool special_quotes(boost::string_view const&, size_t&, size_t&);
+
+          private:
+
+            // Tokens of the last line
+            std::vector<boost::string_view> _tokens;
+
+            // Tokens that had chars removed (when no arena is given)
+            std::string _unquoted;
+        };
+
+    } // ! namespace parser
+} // ! namespace clang_ast2dot
+
+#endif /* ! _CLANG_AST_TOKENIZER_H_ */
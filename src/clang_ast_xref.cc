@@ -0,0 +1,337 @@
+/**
+ * @file clang_ast_xref.cc
+ */
+
+// Include our defs
+#include "clang_ast_xref.h"
+
+namespace clang_ast2dot
+{
+  namespace parser
+  {
+    /**
+     * Hash of an address (murmur3 finalizer: addresses are aligned and
+     * close to each other)
+     */
+    static inline uint64_t
+    address_hash(uint64_t h)
+    {
+      h ^= h >> 33;
+      h *= 0xff51afd7ed558ccdULL;
+      h ^= h >> 33;
+      h *= 0xc4ceb9fe1a85ec53ULL;
+      h ^= h >> 33;
+
+      return h;
+    }
+
+    /**
+     * Ast2DotAddressIndex Constructor
+     */
+    Ast2DotAddressIndex::Ast2DotAddressIndex()
+      : _keys(AST2DOT_ADDRESS_INDEX_SLOTS, 0),
+        _values(AST2DOT_ADDRESS_INDEX_SLOTS, 0)
+    {
+    }
+
+    /**
+     * Ast2DotAddressIndex Destructor
+     */
+    Ast2DotAddressIndex::~Ast2DotAddressIndex()
+    {
+    }
+
+    /**
+     * Set the ID of an address
+     *
+     * @param address  address value (not 0)
+     * @param id       vertex ID
+     */
+    void
+    Ast2DotAddressIndex::put(uint64_t address, std::string const& id)
+    {
+      size_t s = slot(address);
+
+      if (_keys[s] == address)
+        {
+          _ids[_values[s]] = id;
+          return;
+        }
+
+      _keys[s] = address;
+      _values[s] = (uint32_t) _ids.size();
+      _ids.push_back(id);
+
+      if (_ids.size() * 2 > _keys.size())
+        grow();
+    }
+
+    /**
+     * ID of an address
+     *
+     * @param address  address value
+     *
+     * @return ID, NULL if the address is not indexed
+     */
+    std::string const*
+    Ast2DotAddressIndex::find(uint64_t address) const
+    {
+      size_t s;
+
+      if (!address)
+        return (std::string const*) NULL;
+
+      s = slot(address);
+
+      return _keys[s] == address ? &_ids[_values[s]] : (std::string const*) NULL;
+    }
+
+    /**
+     * Remove all addresses
+     */
+    void
+    Ast2DotAddressIndex::clear(void)
+    {
+      _keys.assign(AST2DOT_ADDRESS_INDEX_SLOTS, 0);
+      _values.assign(AST2DOT_ADDRESS_INDEX_SLOTS, 0);
+      _ids.clear();
+    }
+
+    /**
+     * Slot of an address, or empty slot where to put it
+     */
+    size_t
+    Ast2DotAddressIndex::slot(uint64_t address) const
+    {
+      size_t mask = _keys.size() - 1;
+      size_t s = address_hash(address) & mask;
+
+      while (_keys[s] && _keys[s] != address)
+        s = (s + 1) & mask;
+
+      return s;
+    }
+
+    /**
+     * Double the slots, putting the addresses again
+     */
+    void
+    Ast2DotAddressIndex::grow(void)
+    {
+      std::vector<uint64_t> keys(_keys.size() * 2, 0);
+      std::vector<uint32_t> values(_keys.size() * 2, 0);
+
+      keys.swap(_keys);
+      values.swap(_values);
+
+      for (size_t k = 0; k < keys.size(); k++)
+        if (keys[k])
+          {
+            size_t s = slot(keys[k]);
+
+            _keys[s] = keys[k];
+            _values[s] = values[k];
+          }
+    }
+
+    /**
+     * Ast2DotXref Constructor
+     */
+    Ast2DotXref::Ast2DotXref()
+    {
+      _enabled[REFERENCE] = true;
+      _enabled[PREV] = true;
+      _enabled[PARENT] = true;
+      _edges[REFERENCE] = 0;
+      _edges[PREV] = 0;
+      _edges[PARENT] = 0;
+    }
+
+    /**
+     * Ast2DotXref Destructor
+     */
+    Ast2DotXref::~Ast2DotXref()
+    {
+    }
+
+    /**
+     * Index a declaration vertex, emitting its prev and parent links and
+     * the pending links to it, or emit the links of a reference vertex
+     * (pending if its declaration was not emitted yet)
+     *
+     * @param graph  graph of the node
+     * @param i      node
+     * @param id     vertex ID of the node
+     * @param out    output of the dot file
+     */
+    void
+    Ast2DotXref::add(Ast2DotGraph const& graph, Ast2DotGraph::Index i, std::string const& id, Ast2DotOutput* out)
+    {
+      uint64_t address;
+
+      switch (kind_class(graph, i))
+        {
+        case DECL:
+          {
+            address = graph.address_value(i);
+
+            if (address)
+              {
+                _decls.put(address, id);
+
+                // Forward links resolved
+                std::pair<std::unordered_multimap<uint64_t, Pending>::iterator,
+                          std::unordered_multimap<uint64_t, Pending>::iterator> range =
+                  _pending.equal_range(address);
+
+                for (std::unordered_multimap<uint64_t, Pending>::iterator p = range.first; p != range.second; ++p)
+                  emit_edge(p->second.from, id, p->second.type, out);
+                _pending.erase(range.first, range.second);
+              }
+
+            // prev 0x... and parent 0x... props
+            graph.props(i, _props);
+            for (size_t p = 0; p + 1 < _props.size(); p++)
+              {
+                if ((_props[p].sym != Ast2DotSymbols::PREV && _props[p].sym != Ast2DotSymbols::PARENT) ||
+                    _props[p + 1].sym != Ast2DotSymbols::NONE ||
+                    !Ast2DotGraph::parse_address(_props[p + 1].text, address))
+                  continue;
+
+                LinkType type = _props[p].sym == Ast2DotSymbols::PREV ? PREV : PARENT;
+
+                if (_enabled[type])
+                  link(id, address, type, out);
+                p++;
+              }
+          }
+          break;
+
+        case REF_EXPR:
+          if (!_enabled[REFERENCE])
+            break;
+
+          graph.props(i, _props);
+          for (size_t p = 0; p < _props.size(); p++)
+            {
+              if (_props[p].sym == Ast2DotSymbols::NONE &&
+                  Ast2DotGraph::parse_address(_props[p].text, address))
+                link(id, address, REFERENCE, out);
+            }
+          break;
+
+        default:
+          break;
+        }
+    }
+
+    /**
+     * Drop the links still pending
+     *
+     * @return number of links dropped
+     */
+    size_t
+    Ast2DotXref::finish(void)
+    {
+      size_t dropped = _pending.size();
+
+      _pending.clear();
+
+      return dropped;
+    }
+
+    /**
+     * Forget the declarations and links
+     */
+    void
+    Ast2DotXref::clear(void)
+    {
+      _decls.clear();
+      _pending.clear();
+      _edges[REFERENCE] = 0;
+      _edges[PREV] = 0;
+      _edges[PARENT] = 0;
+    }
+
+    /**
+     * Class of the kind of a node: declarations are the kinds ending in
+     * Decl, references the DeclRefExpr and MemberExpr ones. Classes of the
+     * interned kinds are cached.
+     */
+    Ast2DotXref::KindClass
+    Ast2DotXref::kind_class(Ast2DotGraph const& graph, Ast2DotGraph::Index i)
+    {
+      Ast2DotSymbols::Id kind = graph.kind(i);
+
+      if (graph.flags(i) & (Ast2DotGraph::EMPTY | Ast2DotGraph::SUMMARY))
+        return OTHER;
+
+      if (kind != Ast2DotSymbols::NONE && kind < _classes.size() && _classes[kind] != UNKNOWN)
+        return (KindClass) _classes[kind];
+
+      boost::string_view name = graph.name(i);
+      KindClass cls = OTHER;
+
+      if (name == "DeclRefExpr" || name == "MemberExpr")
+        cls = REF_EXPR;
+      else if (name.size() > 4 && name.ends_with("Decl"))
+        cls = DECL;
+
+      if (kind != Ast2DotSymbols::NONE)
+        {
+          if (kind >= _classes.size())
+            _classes.resize(kind + 1, UNKNOWN);
+          _classes[kind] = cls;
+        }
+
+      return cls;
+    }
+
+    /**
+     * Link a vertex to the declaration of an address: edge at once if it
+     * is indexed, pending otherwise
+     */
+    void
+    Ast2DotXref::link(std::string const& from, uint64_t address, LinkType type, Ast2DotOutput* out)
+    {
+      std::string const* decl = _decls.find(address);
+
+      if (decl)
+        emit_edge(from, *decl, type, out);
+      else
+        {
+          Pending pending;
+
+          pending.from = from;
+          pending.type = type;
+          _pending.insert(std::make_pair(address, pending));
+        }
+    }
+
+    /**
+     * Emit the edge of a link
+     */
+    void
+    Ast2DotXref::emit_edge(std::string const& from, std::string const& to, LinkType type, Ast2DotOutput* out)
+    {
+      out->write(AST2DOT_VERTEX_INDENT);
+      out->write(from);
+      out->write(AST2DOT_EDGE_ARROW);
+      out->write(to);
+      switch (type)
+        {
+        case PREV:
+          out->write(AST2DOT_XREF_PREV_EDGE_ATTRS);
+          break;
+        case PARENT:
+          out->write(AST2DOT_XREF_PARENT_EDGE_ATTRS);
+          break;
+        default:
+          out->write(AST2DOT_XREF_EDGE_ATTRS);
+          break;
+        }
+      _edges[type]++;
+    }
+
+  } // ! parser
+} // ! clang_ast2dot
@@ -0,0 +1,227 @@
+/**
+ * @file clang_ast_xref.h
+ *
+ */
+
+#ifndef _CLANG_AST_XREF_H_
+#define _CLANG_AST_XREF_H_
+
+/**
+ * C System headers
+ *
+ * stdint.h for the addresses
+ */
+#include <stdint.h>
+
+/**
+ * C++ System headers
+ *
+ * unordered_map for the pending links
+ */
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Own headers
+ */
+#include "clang_ast_graph.h"
+#include "clang_ast_output.h"
+
+// Attributes of the edges from a reference to its declaration
+#define AST2DOT_XREF_EDGE_ATTRS                 " [style=\"dashed\",color=red,constraint=false];\n"
+
+// Attributes of the edges from a redeclaration to the previous one (prev)
+#define AST2DOT_XREF_PREV_EDGE_ATTRS            " [style=\"dashed\",color=darkgreen,label=\"prev\",constraint=false];\n"
+
+// Attributes of the edges from an out of line declaration to its parent
+#define AST2DOT_XREF_PARENT_EDGE_ATTRS          " [style=\"dotted\",color=darkgreen,label=\"parent\",constraint=false];\n"
+
+// Initial number of slots of the address index (power of 2)
+#define AST2DOT_ADDRESS_INDEX_SLOTS             1024
+
+namespace clang_ast2dot
+{
+    namespace parser
+    {
+        /*
+         * Index of the vertex IDs by 0x... address value.
+         *
+         * Open addressing with linear probing on the address value (0 is
+         * the empty slot, clang never prints it), kept at most half full.
+         */
+        class Ast2DotAddressIndex
+        {
+          public:
+
+            /*
+             * Address index explicit constructor
+             */
+            Ast2DotAddressIndex(void);
+
+            /*
+             * Address index destructor
+             */
+            virtual ~Ast2DotAddressIndex(void);
+
+            /*
+             * Set the ID of an address
+             */
+            void put(uint64_t, std::string const&);
+
+            /*
+             * ID of an address (NULL if not indexed)
+             */
+            std::string const* find(uint64_t) const;
+
+            /* Remove all addresses */
+            void clear(void);
+
+            /* Number of addresses */
+            size_t size(void) const { return _ids.size(); }
+
+          private:
+
+            /*
+             * Slot of an address: its own one or the empty one to put it in
+             */
+            size_t slot(uint64_t) const;
+
+            /*
+             * Double the slots
+             */
+            void grow(void);
+
+            // Address of the slots (0 if empty)
+            std::vector<uint64_t> _keys;
+
+            // Index in _ids of the slots
+            std::vector<uint32_t> _values;
+
+            // IDs, in indexing order
+            std::vector<std::string> _ids;
+        };
+
+        /*
+         * Links from vertices to the declarations of other vertices, by
+         * 0x... address:
+         *  - references: DeclRefExpr and MemberExpr to the declarations they
+         *    use (their 0x... props),
+         *  - redeclarations: declarations to the previous one (prev 0x...),
+         *  - out of line declarations to their semantic parent (parent 0x...).
+         *
+         * Declaration vertices (kinds ending in Decl) are indexed by address
+         * as they are emitted. A link to an indexed declaration is emitted at
+         * once; a forward one is kept pending, and emitted when its
+         * declaration is. So, besides the index, memory only holds the links
+         * not resolved yet, and redeclaration chains of a whole dump need no
+         * second pass: the dump is read and emitted a top level declaration
+         * at a time (Ast2DotParser::read_part). Links still pending at the end (declaration filtered
+         * out or not in the dump) are dropped.
+         */
+        class Ast2DotXref
+        {
+          public:
+
+            /*
+             * Link types
+             */
+            enum LinkType
+              {
+                REFERENCE = 0,          // DeclRefExpr/MemberExpr to declaration
+                PREV,                   // redeclaration to previous declaration
+                PARENT                  // out of line declaration to parent
+              };
+
+            /*
+             * Xref explicit constructor
+             */
+            Ast2DotXref(void);
+
+            /*
+             * Xref destructor
+             */
+            virtual ~Ast2DotXref(void);
+
+            /* Emit the links of a type (all types by default) */
+            void enable(LinkType type, bool on) { _enabled[type] = on; }
+            bool enabled(LinkType type) const { return _enabled[type]; }
+
+            /*
+             * Index a vertex emitted with its ID, and emit the edges of the
+             * links it makes or resolves
+             */
+            void add(Ast2DotGraph const&, Ast2DotGraph::Index, std::string const&, Ast2DotOutput*);
+
+            /*
+             * Drop the links still pending (returns their number)
+             */
+            size_t finish(void);
+
+            /* Forget the declarations and links */
+            void clear(void);
+
+            /* Number of edges emitted (all or of a type), and of links pending */
+            size_t edges(void) const { return _edges[REFERENCE] + _edges[PREV] + _edges[PARENT]; }
+            size_t edges(LinkType type) const { return _edges[type]; }
+            size_t pending(void) const { return _pending.size(); }
+
+          protected:
+
+            /*
+             * Kind of a node, cached by symbol ID
+             */
+            enum KindClass
+              {
+                UNKNOWN = 0,
+                OTHER,
+                DECL,
+                REF_EXPR
+              };
+
+            KindClass kind_class(Ast2DotGraph const&, Ast2DotGraph::Index);
+
+            /*
+             * Link a vertex to the declaration of an address
+             */
+            void link(std::string const&, uint64_t, LinkType, Ast2DotOutput*);
+
+            /*
+             * Emit the edge of a link
+             */
+            void emit_edge(std::string const&, std::string const&, LinkType, Ast2DotOutput*);
+
+          private:
+
+            /*
+             * Link waiting for its declaration
+             */
+            struct Pending
+            {
+              std::string from;
+              LinkType type;
+            };
+
+            // Vertex IDs of the declarations by address
+            Ast2DotAddressIndex _decls;
+
+            // Links by address of their declaration
+            std::unordered_multimap<uint64_t, Pending> _pending;
+
+            // Class of the interned kinds (by symbol ID)
+            std::vector<unsigned char> _classes;
+
+            // Props of the current node
+            std::vector<Ast2DotGraph::Prop> _props;
+
+            // Link types emitted
+            bool _enabled[PARENT + 1];
+
+            // Edges emitted by type
+            size_t _edges[PARENT + 1];
+        };
+
+    } // ! namespace parser
+} // ! namespace clang_ast2dot
+
+#endif /* ! _CLANG_AST_XREF_H_ */
@@ -13,6 +13,8 @@ class MockAst2DotParser : public Ast2DotParser {
       std::string(std::string const&));
   MOCK_METHOD2(read_vertex_props,
       std::string*(std::istream *, std::ostream *));
+  MOCK_METHOD3(read_graph,
+      size_t(Ast2DotInput *, Ast2DotGraph&, int));
   MOCK_METHOD0(inbuf,
       std::string&(void));
   MOCK_METHOD0(scstr,
@@ -26,7 +28,7 @@ class MockAst2DotParser : public Ast2DotParser {
   MOCK_METHOD0(address,
       std::string&(void));
   MOCK_METHOD0(props,
-      std::vector<std::string>&(void));
+      std::vector<boost::string_view>&(void));
 };
 
 }  // namespace parser
@@ -4,9 +4,37 @@
 
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <string>
+#include <thread>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include "test_parser.h"
 #include "clang_ast_parser.h"
+#include "clang_ast_output.h"
+#include "clang_ast_escape.h"
+#include "clang_ast_tokenizer.h"
+#include "clang_ast_arena.h"
+#include "clang_ast_symbols.h"
+#include "clang_ast_graph.h"
+#include "clang_ast_emitter.h"
+#include "clang_ast_jobs.h"
+#include "clang_ast_filter.h"
+#include "clang_ast_dedupe.h"
+#include "clang_ast_xref.h"
+#include "clang_ast_cache.h"
+#include "clang_ast_incremental.h"
+#include "clang_ast_batch.h"
+#include "clang_ast_server.h"
+#include "clang_ast_decompress.h"
+#include "clang_ast_compress.h"
+#include "clang_ast_stats.h"
+#ifdef AST2DOT_WITH_ZLIB
+#include <zlib.h>
+#endif
+
+#include <boost/tokenizer.hpp>
 
 namespace clang_ast2dot
 {
@@ -400,6 +428,28 @@ namespace clang_ast2dot
             EXPECT_STREQ(p.null_to_label("NULL_4").c_str(), "");
         }
 
+        TEST_F(TestParser, Public2Name)
+        {
+            Ast2DotParser p;
+            int ix = -1;
+
+            // Nothing numbered yet
+            EXPECT_STREQ(p.null_to_label("NULL_0").c_str(), "");
+            EXPECT_STREQ(p.public_to_label("public_0").c_str(), "");
+            EXPECT_STREQ(p.public_to_index("public_0").c_str(), "-1");
+
+            EXPECT_STREQ(p.public_to_name(-1, &ix).c_str(), "public_0");
+            EXPECT_EQ(ix, 0);
+            EXPECT_STREQ(p.public_to_name(-1, &ix).c_str(), "public_1");
+            EXPECT_EQ(ix, 1);
+            EXPECT_STREQ(p.public_to_name(0).c_str(), "public_0");
+            EXPECT_STREQ(p.public_to_label("public_1").c_str(), "public_1");
+            EXPECT_STREQ(p.public_to_index("public_1").c_str(), "1");
+            EXPECT_STREQ(p.public_to_index("public_2").c_str(), "-1");
+            EXPECT_STREQ(p.public_to_index("public_01").c_str(), "-1");
+            EXPECT_STREQ(p.public_to_index("NULL_1").c_str(), "-1");
+        }
+
         TEST_F(TestParser, ParseVertexProps)
         {
             Ast2DotParser p;
@@ -429,6 +479,1330 @@ namespace clang_ast2dot
                     delete vertex_str;
                 }
         }
+
+        TEST_F(TestParser, ParseScStrMmap)
+        {
+            Ast2DotParser p;
+            Ast2DotMmapInput in("../tests/test_parser.txt");
+            boost::string_view line;
+
+            // Check 1st line is empty scstr
+            EXPECT_THROW(p.read_sibling_child_string(&in), Ast2DotParser::EmptyScStrException);
+
+            // Discard to next line
+            EXPECT_TRUE(in.getline(line));
+            EXPECT_EQ(line, "Line0");
+
+            // Check 2nd line is invalid scstr
+            EXPECT_THROW(p.read_sibling_child_string(&in), Ast2DotParser::InvalidScStrException);
+
+            // Discard to next line
+            EXPECT_TRUE(in.getline(line));
+
+            // Check 3rd line
+            p.read_sibling_child_string(&in);
+            EXPECT_STREQ(p.scstr().c_str(), "| |-");
+            EXPECT_TRUE(in.getline(line));
+            EXPECT_EQ(line, "-Line-2");
+
+            // Check 4th line
+            p.read_sibling_child_string(&in);
+            EXPECT_STREQ(p.scstr().c_str(), "|-");
+            EXPECT_TRUE(in.getline(line));
+            EXPECT_EQ(line, "Line1");
+
+            // Discard until end of file
+            while (in.getline(line))
+                ;
+            EXPECT_TRUE(in.eof());
+            EXPECT_THROW(p.read_sibling_child_string(&in), Ast2DotParser::UnexpectedEofException);
+        }
+
+        TEST_F(TestParser, StreamInputLines)
+        {
+            Ast2DotMmapInput min("../tests/test_parser2.txt");
+            Ast2DotStreamInput sin(_test_parser2_testfile);
+            boost::string_view mline;
+            boost::string_view sline;
+            std::string copy;
+
+            // Check test file is open
+            EXPECT_TRUE(_test_parser2_testfile->is_open());
+
+            // Both inputs give the same lines
+            while (min.getline(mline))
+                {
+                    copy.assign(mline.data(), mline.size());
+                    EXPECT_TRUE(sin.getline(sline));
+                    EXPECT_EQ(sline, copy);
+                }
+            EXPECT_FALSE(sin.getline(sline));
+            EXPECT_TRUE(sin.eof());
+        }
+        TEST_F(TestParser, OutputBuffering)
+        {
+            FILE* tmp = tmpfile();
+            Ast2DotOutput out(fileno(tmp), 64);
+            char buf[256];
+
+            // Nothing written until buffer is full
+            out.write("digraph {\n");
+            EXPECT_EQ(out.syscalls(), 0);
+            out.write(std::string(100, 'x'));
+            EXPECT_EQ(out.syscalls(), 2);
+
+            // Flush every 2 vertices
+            out.flush_every_nodes(2);
+            out.write("a");
+            out.end_vertex();
+            EXPECT_EQ(out.syscalls(), 2);
+            out.write((unsigned long long)42);
+            out.end_vertex();
+            EXPECT_EQ(out.syscalls(), 3);
+            EXPECT_EQ(out.bytes(), 113);
+
+            // Check what was written
+            rewind(tmp);
+            EXPECT_EQ(fread(buf, 1, sizeof(buf), tmp), 113);
+            EXPECT_EQ(std::string(buf + 110, 3), "a42");
+            fclose(tmp);
+        }
+        /*
+         * Reference escaping (find_first_of/replace), as done before
+         */
+        static std::string
+        reference_escape(std::string str)
+        {
+            size_t pos = 0;
+            size_t ilen = 0;
+
+            while ((pos = str.find_first_of("<>\\ ", pos + ilen)) != std::string::npos)
+                switch (str[pos])
+                    {
+                    case '<': str.replace(pos, 1, "&lt;"); ilen = 4; break;
+                    case '>': str.replace(pos, 1, "&gt;"); ilen = 4; break;
+                    case ' ': str.replace(pos, 1, "&nbsp;"); ilen = 6; break;
+                    default: str.insert(pos, 1, '\\'); ilen = 2; break;
+                    }
+
+            return str;
+        }
+
+        TEST_F(TestParser, EscapeDotString)
+        {
+            std::string line;
+            std::string out;
+
+            // Every line of the test file
+            while (std::getline(*_test_parser2_testfile, line))
+                {
+                    out = "prefix";
+                    escape_dot_string_append(line, out);
+                    EXPECT_EQ(out, "prefix" + reference_escape(line));
+                    EXPECT_EQ(escaped_dot_string_size(line), reference_escape(line).size());
+                }
+
+            // Long template types, special chars at all block offsets
+            for (size_t n = 0; n < 80; n++)
+                {
+                    line = std::string(n, 'a') + "std::basic_string<char, std::char_traits<char> > \\x";
+                    out.clear();
+                    escape_dot_string_append(line, out);
+                    EXPECT_EQ(out, reference_escape(line));
+                    EXPECT_EQ(escape_dot_string(line), reference_escape(std::string(n, 'a') + "std::basic_string<char, std::char_traits<char> > \\x"));
+                }
+        }
+        /*
+         * Reference tokenizing (quote_special_quotes and boost tokenizer)
+         */
+        static std::vector<std::string>
+        reference_tokens(Ast2DotParser& p, std::string ast)
+        {
+            std::string* astptr;
+            std::vector<std::string> toks;
+
+            if (ast.find("<<<") != std::string::npos)
+                ast = p.quote_special_quotes(ast, "<<<", ">>>", astptr);
+            if (ast.find("<<") != std::string::npos &&
+                ast.find("<<<") == std::string::npos)
+                ast = p.quote_special_quotes(ast, "<<", ">>", astptr);
+            if (ast.find("<") != std::string::npos &&
+                ast.find("<<") == std::string::npos &&
+                ast.find("<<<") == std::string::npos)
+                ast = p.quote_special_quotes(ast, "<", ">", astptr);
+
+            boost::escaped_list_separator<char> f("\\", " ", "\\\"");
+            boost::tokenizer<boost::escaped_list_separator<char> > tok(ast, f);
+            for (boost::tokenizer<boost::escaped_list_separator<char> >::iterator it = tok.begin();
+                 it != tok.end();
+                 ++it)
+                toks.push_back(*it);
+
+            return toks;
+        }
+
+        TEST_F(TestParser, Tokenizer)
+        {
+            const char* files[] = {
+                "../tests/test_parser2.txt",
+                "../examples/ast.txt",
+                "../examples/ast2.txt",
+                "../examples/test_ast3.txt",
+                "../build/clang_ast_parser_extract.ast",
+                "../build/clang_ast_parser_extract2.ast",
+                "../build/clang_ast_parser_extract4.ast",
+            };
+            Ast2DotParser p;
+            Ast2DotTokenizer t;
+
+            for (size_t f = 0; f < sizeof(files) / sizeof(files[0]); f++)
+                {
+                    std::ifstream ifs(files[f]);
+                    std::string line;
+
+                    EXPECT_TRUE(ifs.is_open());
+                    while (std::getline(ifs, line))
+                        {
+                            // Skip relationship string
+                            size_t start = line.find_first_not_of("| `");
+                            if (start != std::string::npos && line[start] == '-')
+                                start++;
+                            if (start == std::string::npos)
+                                continue;
+                            line.erase(0, start);
+
+                            std::vector<std::string> ref = reference_tokens(p, line);
+                            ASSERT_EQ(t.tokenize(line), ref.size()) << line;
+                            for (size_t i = 0; i < ref.size(); i++)
+                                EXPECT_EQ(t.tokens()[i], ref[i]) << line;
+                        }
+                }
+
+            // Double quotes and escapes
+            ASSERT_EQ(t.tokenize("StringLiteral 0x1 \"a b\"  x\\\\y"), 5);
+            EXPECT_EQ(t.tokens()[2], "a b");
+            EXPECT_EQ(t.tokens()[3], "");
+            EXPECT_EQ(t.tokens()[4], "x\\y");
+        }
+
+        TEST_F(TestParser, Arena)
+        {
+            Ast2DotArena a(16);
+
+            boost::string_view s1 = a.copy("0123456789");
+            boost::string_view s2 = a.copy("abcdefghij");
+            EXPECT_EQ(s1, "0123456789");
+            EXPECT_EQ(s2, "abcdefghij");
+            EXPECT_EQ(a.chunks(), 2);
+
+            // Larger than a chunk
+            a.allocate(100);
+            EXPECT_EQ(a.chunks(), 3);
+
+            // Chunks are reused after reset
+            size_t capacity = a.capacity();
+            for (int i = 0; i < 10; i++)
+                {
+                    a.reset();
+                    a.copy("0123456789");
+                    a.copy("abcdefghij");
+                    a.allocate(100);
+                }
+            EXPECT_EQ(a.chunks(), 3);
+            EXPECT_EQ(a.capacity(), capacity);
+
+            // Vertex string in the parser arena
+            std::istringstream is("FunctionDecl 0x1a <col:1> f 'void (void)'\n");
+            Ast2DotStreamInput in(&is);
+            Ast2DotParser p;
+            EXPECT_EQ(p.read_vertex(&in),
+                      "    FunctionDecl_0x1a [shape=record,style=filled,fillcolor=lightgrey,"
+                      "label=\"{ FunctionDecl| 0x1a| &lt;col:1&gt;| f| 'void| (void)'| }\"];\n");
+        }
+
+        TEST_F(TestParser, Symbols)
+        {
+            Ast2DotSymbols sym(2);
+
+            // Known symbols are found at their ID
+            for (Ast2DotSymbols::Id id = 0; id < Ast2DotSymbols::known(); id++)
+                EXPECT_EQ(sym.find(sym.text(id)), id) << sym.text(id);
+            EXPECT_EQ(sym.find("public"), Ast2DotSymbols::PUBLIC);
+            EXPECT_EQ(sym.intern("CXXCtorInitializer"), Ast2DotSymbols::CXX_CTOR_INITIALIZER);
+            EXPECT_EQ(sym.escaped(Ast2DotSymbols::NULL_VERTEX), "&lt;&lt;&lt;NULL&gt;&gt;&gt;");
+            EXPECT_EQ(sym.find("NoSuchDecl"), Ast2DotSymbols::NONE);
+
+            // Interned symbols
+            Ast2DotSymbols::Id a = sym.intern("'a b'");
+            EXPECT_FALSE(Ast2DotSymbols::is_known(a));
+            EXPECT_EQ(sym.intern("'a b'"), a);
+            EXPECT_EQ(sym.find("'a b'"), a);
+            EXPECT_EQ(sym.escaped(a), "'a&nbsp;b'");
+            EXPECT_NE(sym.intern("x<y>"), Ast2DotSymbols::NONE);
+
+            // Table full, too long
+            EXPECT_EQ(sym.intern("z"), Ast2DotSymbols::NONE);
+            EXPECT_EQ(sym.size(), Ast2DotSymbols::known() + 2);
+            EXPECT_EQ(Ast2DotSymbols().intern(std::string(AST2DOT_SYMBOL_MAX_LENGTH + 1, 'x')),
+                      Ast2DotSymbols::NONE);
+
+            // Growing the table keeps the symbols
+            Ast2DotSymbols big;
+            for (int i = 0; i < 5000; i++)
+                EXPECT_EQ(big.intern(std::to_string(i) + "u"), Ast2DotSymbols::known() + i);
+            for (int i = 0; i < 5000; i++)
+                EXPECT_EQ(big.find(std::to_string(i) + "u"), Ast2DotSymbols::known() + i);
+
+            // Parser kinds
+            std::istringstream is("ImplicitCastExpr 0x2 <col:1> 'int' <LValueToRValue>\n");
+            Ast2DotStreamInput in(&is);
+            Ast2DotParser p;
+            p.read_vertex(&in);
+            EXPECT_EQ(p.symbols().text(p.kind()), "ImplicitCastExpr");
+            ASSERT_EQ(p.prop_syms().size(), 3);
+            EXPECT_EQ(p.prop_syms()[0], Ast2DotSymbols::NONE);
+            EXPECT_EQ(p.symbols().text(p.prop_syms()[1]), "'int'");
+        }
+
+        TEST_F(TestParser, Graph)
+        {
+            std::istringstream is("TranslationUnitDecl 0x1a <<invalid sloc>>\n"
+                                  "|-FunctionDecl 0x2b <a.c:1:1> f 'int (void)'\n"
+                                  "| |-CompoundStmt 0x3c <col:9>\n"
+                                  "| | `-<<<NULL>>>\n"
+                                  "| `-public 'struct A'\n"
+                                  "`-original Namespace 0x4d 'std'\n");
+            Ast2DotStreamInput in(&is);
+            Ast2DotParser p;
+            Ast2DotGraph g(p.symbols());
+            std::vector<Ast2DotGraph::Prop> props;
+            char buf[20];
+
+            ASSERT_EQ(p.read_graph(&in, g), 6);
+            ASSERT_EQ(g.size(), 6);
+
+            // Tree links
+            EXPECT_EQ(g.parent(0), Ast2DotGraph::NONE);
+            EXPECT_EQ(g.first_child(0), 1);
+            EXPECT_EQ(g.next_sibling(1), 5);
+            EXPECT_EQ(g.parent(5), 0);
+            EXPECT_EQ(g.first_child(1), 2);
+            EXPECT_EQ(g.next_sibling(2), 4);
+            EXPECT_EQ(g.parent(3), 2);
+            EXPECT_EQ(g.next_sibling(5), Ast2DotGraph::NONE);
+
+            // Fields
+            EXPECT_EQ(g.name(1), "FunctionDecl");
+            EXPECT_EQ(g.address(1, buf), "0x2b");
+            EXPECT_EQ(g.address_value(1), 0x2b);
+            EXPECT_TRUE(g.is_null(3));
+            EXPECT_EQ(g.address(4, buf), "");
+            EXPECT_EQ(g.address(5, buf), "Namespace");
+            ASSERT_EQ(g.props(1, props), 4);
+            EXPECT_EQ(props[0].text, "<a.c:1:1>");
+            EXPECT_EQ(props[0].sym, Ast2DotSymbols::NONE);
+            EXPECT_EQ(props[2].text, "'int");
+            EXPECT_NE(props[2].sym, Ast2DotSymbols::NONE);
+            EXPECT_EQ(props[3].text, "(void)'");
+
+            // Address not 0x... to its end: kept as text, no value
+            uint64_t value = 7;
+            EXPECT_FALSE(Ast2DotGraph::parse_address("0x12zz", value));
+            EXPECT_EQ(value, 7);
+            std::istringstream bad("Foo 0x12zz <a.c:1:1>\n");
+            Ast2DotStreamInput bad_in(&bad);
+            Ast2DotGraph bad_g(p.symbols());
+            ASSERT_EQ(p.read_graph(&bad_in, bad_g), 1);
+            EXPECT_EQ(bad_g.address(0, buf), "0x12zz");
+            EXPECT_EQ(bad_g.address_value(0), 0);
+
+            // Emitted as the dump is converted by the streaming parser
+            const char* files[] = {
+                "../examples/test_ast1",
+                "../examples/test_ast2",
+                "../examples/test_ast3",
+            };
+            for (size_t f = 0; f < sizeof(files) / sizeof(files[0]); f++)
+                {
+                    Ast2DotMmapInput min(std::string(files[f]) + ".txt");
+                    Ast2DotParser fp;
+                    Ast2DotGraph fg(fp.symbols());
+                    FILE* tmp = tmpfile();
+                    std::ifstream res(std::string(files[f]) + ".dot.result");
+                    std::stringstream expected;
+                    std::string dot;
+
+                    fp.read_graph(&min, fg);
+                    {
+                        Ast2DotOutput out(fileno(tmp));
+                        Ast2DotEmitter emitter(&out);
+                        out.write("digraph {\n");
+                        EXPECT_EQ(emitter.emit(fg), fg.size());
+                        out.write("}\n");
+                    }
+
+                    rewind(tmp);
+                    dot.resize(1 << 16);
+                    dot.resize(fread(&dot[0], 1, dot.size(), tmp));
+                    fclose(tmp);
+                    expected << res.rdbuf();
+                    EXPECT_EQ(dot, expected.str()) << files[f];
+                }
+        }
+
+        TEST_F(TestParser, Jobs)
+        {
+            const char dump[] = "A 0x1\n|-B 0x2\n| `-C 0x3\n|-D 0x4\n`-E 0x5\n";
+            std::vector<size_t> starts;
+
+            // Split at top level declarations only
+            EXPECT_EQ(Ast2DotJobs::split(dump, sizeof(dump) - 1, 1, starts), 4);
+            EXPECT_EQ(starts[1], 6);
+            EXPECT_EQ(starts[2], 24);
+            EXPECT_EQ(starts[3], 32);
+            EXPECT_EQ(Ast2DotJobs::split(dump, sizeof(dump) - 1, 1024, starts), 1);
+
+            // A few chunks per job, within the bounds
+            EXPECT_EQ(Ast2DotJobs::chunk_size(1024, 4), AST2DOT_JOBS_MIN_CHUNK_SIZE);
+            EXPECT_EQ(Ast2DotJobs::chunk_size(16 * 1024 * 1024, 4), 1024 * 1024);
+            EXPECT_EQ(Ast2DotJobs::chunk_size(1024UL * 1024 * 1024, 4), AST2DOT_JOBS_MAX_CHUNK_SIZE);
+
+            // Same output as a single threaded conversion, with small chunks
+            const char* files[] = {
+                "../examples/test_ast3.txt",
+                "../examples/ast.txt",
+                "clang_ast_parser_extract2.ast",
+            };
+            for (size_t f = 0; f < sizeof(files) / sizeof(files[0]); f++)
+                {
+                    Ast2DotMmapInput min(files[f]);
+                    Ast2DotParser fp;
+                    Ast2DotGraph fg(fp.symbols());
+                    Ast2DotMemoryOutput expected;
+                    Ast2DotMemoryOutput out;
+                    Ast2DotJobs jobs(3, 256);
+
+                    fp.read_graph(&min, fg);
+                    {
+                        Ast2DotEmitter emitter(&expected);
+                        emitter.emit(fg);
+                        expected.flush();
+                    }
+
+                    EXPECT_EQ(jobs.convert(min.data(), min.size(), &out), fg.size()) << files[f];
+                    out.flush();
+                    EXPECT_GT(jobs.chunks(), 1) << files[f];
+                    EXPECT_EQ(out.data(), expected.data()) << files[f];
+                }
+        }
+
+        TEST_F(TestParser, Parts)
+        {
+            const char dump[] = "A 0x1\n|-B 0x2\n| `-C 0x3\n|-D 0x4\n`-E 0x5\n";
+            Ast2DotMemoryInput in(dump, sizeof(dump) - 1);
+            Ast2DotParser p;
+            Ast2DotGraph g(p.symbols());
+
+            // Root, then one top level declaration per part
+            EXPECT_EQ(p.read_part(&in, g), 1);
+            EXPECT_EQ(g.size(), 1);
+            g.clear();
+            EXPECT_EQ(p.read_part(&in, g, 1), 1);
+            EXPECT_EQ(g.size(), 2);
+            EXPECT_TRUE(g.flags(0) & Ast2DotGraph::ORPHAN);
+            g.clear();
+            EXPECT_EQ(p.read_part(&in, g, 1), 1);
+            g.clear();
+            EXPECT_EQ(p.read_part(&in, g, 1), -1);
+            EXPECT_EQ(g.size(), 1);
+
+            // Same output as the whole graph, emitted part by part
+            const char* files[] = {
+                "../examples/test_ast3.txt",
+                "../examples/ast.txt",
+                "clang_ast_parser_extract2.ast",
+            };
+            for (size_t f = 0; f < sizeof(files) / sizeof(files[0]); f++)
+                {
+                    Ast2DotMmapInput min(files[f]);
+                    Ast2DotParser fp;
+                    Ast2DotGraph fg(fp.symbols());
+                    Ast2DotMemoryOutput expected;
+                    Ast2DotMemoryOutput out;
+                    Ast2DotMmapInput pin(files[f]);
+                    Ast2DotParser pp;
+                    Ast2DotGraph pg(pp.symbols());
+                    Ast2DotEmitter emitter(&out);
+                    size_t vertices = 0;
+
+                    fp.read_graph(&min, fg);
+                    {
+                        Ast2DotEmitter whole(&expected);
+                        whole.emit(fg);
+                        expected.flush();
+                    }
+
+                    for (int level = 0; level >= 0; )
+                        {
+                            pg.clear();
+                            level = pp.read_part(&pin, pg, level);
+                            vertices += emitter.emit(pg);
+                        }
+                    out.flush();
+                    EXPECT_EQ(vertices, fg.size()) << files[f];
+                    EXPECT_EQ(out.data(), expected.data()) << files[f];
+                }
+        }
+
+        TEST_F(TestParser, Filter)
+        {
+            const char dump[] =
+                "TranslationUnitDecl 0x1 <<invalid sloc>> <invalid sloc>\n"
+                "|-TypedefDecl 0x2 <<invalid sloc>> <invalid sloc> implicit __int128_t '__int128'\n"
+                "|-FunctionDecl 0x3 </usr/include/stdio.h:10:1, col:20> col:5 printf 'int (const char *, ...)'\n"
+                "| `-ParmVarDecl 0x4 <col:12, col:24> col:24 'const char *'\n"
+                "|-FunctionDecl 0x5 <line:12:1, col:20> col:5 puts 'int (const char *)'\n"
+                "|-FunctionDecl 0x6 <src/a.c:1:1, line:3:1> line:1:5 main 'int (void)'\n"
+                "| `-CompoundStmt 0x7 <col:16, line:3:1>\n"
+                "|   `-ReturnStmt 0x8 <line:2:3, col:10>\n"
+                "|     `-IntegerLiteral 0x9 <col:10> 'int' 0\n"
+                "`-VarDecl 0xa <line:4:1, col:5> col:5 x 'int'\n";
+            const size_t size = sizeof(dump) - 1;
+            Ast2DotFilter filter;
+
+            // Kinds of the vertices kept
+            struct Case
+            {
+                const char* include;
+                const char* exclude;
+                const char* file;
+                size_t vertices;
+            } cases[] = {
+                { "", "", "", 10 },
+                { "FunctionDecl", "", "", 8 },
+                { "", "CompoundStmt", "", 7 },
+                { "", "ParmVarDecl,ReturnStmt", "", 7 },
+                { "", "", "*/stdio.h", 4 },
+                { "", "", "src/*", 6 },
+                { "VarDecl", "", "src/*", 2 },
+            };
+
+            for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++)
+                {
+                    Ast2DotMemoryInput in(dump, size);
+                    Ast2DotParser p;
+                    Ast2DotGraph g(p.symbols());
+                    std::vector<std::string> include, exclude, files;
+                    std::string list;
+                    std::stringstream ss;
+
+                    ss.str(cases[c].include);
+                    while (std::getline(ss, list, ','))
+                        include.push_back(list);
+                    ss.clear();
+                    ss.str(cases[c].exclude);
+                    while (std::getline(ss, list, ','))
+                        exclude.push_back(list);
+                    if (*cases[c].file)
+                        files.push_back(cases[c].file);
+
+                    filter.include_kinds(include);
+                    filter.exclude_kinds(exclude);
+                    filter.only_files(files);
+                    p.set_filter(filter);
+
+                    EXPECT_EQ(p.read_graph(&in, g), cases[c].vertices) << c;
+                    if (!files.empty())
+                        {
+                            EXPECT_EQ(p.filter().file(), "src/a.c") << c;
+                        }
+
+                    // Same vertices with the dump parsed in parts
+                    Ast2DotMemoryOutput expected;
+                    Ast2DotMemoryOutput out;
+                    Ast2DotEmitter emitter(&expected);
+                    Ast2DotJobs jobs(2, 16);
+
+                    emitter.emit(g);
+                    expected.flush();
+                    jobs.set_filter(&filter);
+                    EXPECT_EQ(jobs.convert(dump, size, &out), cases[c].vertices) << c;
+                    out.flush();
+                    EXPECT_EQ(out.data(), expected.data()) << c;
+                }
+
+            // Current file at the start of a part of the dump
+            EXPECT_EQ(Ast2DotFilter::last_file(dump, strstr(dump, "|-FunctionDecl 0x5")), "/usr/include/stdio.h");
+            EXPECT_EQ(Ast2DotFilter::last_file(dump, strstr(dump, "|-FunctionDecl 0x3")), "");
+        }
+
+        TEST_F(TestParser, MaxDepth)
+        {
+            const char dump[] =
+                "TranslationUnitDecl 0x1 <<invalid sloc>> <invalid sloc>\n"
+                "|-FunctionDecl 0x2 <a.c:1:1, line:3:1> line:1:5 main 'int (void)'\n"
+                "| `-CompoundStmt 0x3 <col:16, line:3:1>\n"
+                "|   |-ReturnStmt 0x4 <line:2:3, col:10>\n"
+                "|   | `-IntegerLiteral 0x5 <col:10> 'int' 0\n"
+                "|   `-ReturnStmt 0x6 <line:2:3, col:10>\n"
+                "|     `-<<<NULL>>>\n"
+                "|-FunctionDecl 0x7 <line:4:1, line:5:1> line:4:5 f 'void (void)'\n"
+                "| `-CompoundStmt 0x8 <col:16, line:5:1>\n"
+                "|   `-NullStmt 0x9 <line:4:3>\n"
+                "`-VarDecl 0xa <line:6:1, col:5> col:5 x 'int'\n";
+            Ast2DotMemoryInput in(dump, sizeof(dump) - 1);
+            Ast2DotParser p;
+            Ast2DotGraph g(p.symbols());
+            std::vector<Ast2DotGraph::Prop> props;
+
+            p.set_max_depth(2);
+            ASSERT_EQ(p.read_graph(&in, g), 8);
+            ASSERT_EQ(g.size(), 8);
+
+            // Summary of the 4 vertices below the compound statement
+            EXPECT_TRUE(g.flags(3) & Ast2DotGraph::SUMMARY);
+            EXPECT_EQ(g.parent(3), 2);
+            EXPECT_EQ(g.next_sibling(3), Ast2DotGraph::NONE);
+            EXPECT_EQ(g.next_sibling(1), 4);
+            ASSERT_EQ(g.props(3, props), 4);
+            EXPECT_EQ(props[0].text, "4 nodes");
+            EXPECT_EQ(props[1].text, "ReturnStmt x2");
+            EXPECT_EQ(props[2].text, "<<<NULL>>> x1");
+            EXPECT_TRUE(g.flags(6) & Ast2DotGraph::SUMMARY);
+            ASSERT_EQ(g.props(6, props), 2);
+            EXPECT_EQ(props[0].text, "1 node");
+
+            // Numbered in emission order, even when parsed in parts
+            Ast2DotMemoryOutput expected;
+            Ast2DotMemoryOutput out;
+            Ast2DotEmitter emitter(&expected);
+            Ast2DotJobs jobs(2, 16);
+
+            emitter.emit(g);
+            expected.flush();
+            EXPECT_EQ(expected.data().find("IntegerLiteral_0x5"), std::string::npos);
+            EXPECT_NE(expected.data().find("CompoundStmt_0x3 -> summary_0 "), std::string::npos);
+            EXPECT_NE(expected.data().find("CompoundStmt_0x8 -> summary_1 "), std::string::npos);
+
+            jobs.set_max_depth(2);
+            EXPECT_EQ(jobs.convert(dump, sizeof(dump) - 1, &out), 8);
+            out.flush();
+            EXPECT_EQ(out.data(), expected.data());
+        }
+
+        TEST_F(TestParser, DedupeSubtrees)
+        {
+            const char dump[] =
+                "TranslationUnitDecl 0x1 <<invalid sloc>> <invalid sloc>\n"
+                "|-FunctionDecl 0x2 <a.c:1:1, line:3:1> line:1:5 main 'int (void)'\n"
+                "| `-CompoundStmt 0x3 <col:16, line:3:1>\n"
+                "|   |-ReturnStmt 0x4 <col:3, col:10>\n"
+                "|   | `-IntegerLiteral 0x5 <col:10> 'int' 0\n"
+                "|   |-ReturnStmt 0x6 <col:3, col:10>\n"
+                "|   | `-IntegerLiteral 0x7 <col:10> 'int' 0\n"
+                "|   |-ReturnStmt 0x8 <col:3, col:10>\n"
+                "|   | `-IntegerLiteral 0x9 <col:10> 'int' 1\n"
+                "|   `-ReturnStmt 0xa <col:3, col:10>\n"
+                "|     `-IntegerLiteral 0xb <col:10> 'int' 0\n"
+                "`-VarDecl 0xc <line:6:1, col:5> col:5 x 'int'\n";
+            Ast2DotMemoryInput in(dump, sizeof(dump) - 1);
+            Ast2DotParser p;
+            Ast2DotGraph g(p.symbols());
+            Ast2DotMemoryOutput out;
+            Ast2DotDedupeEmitter emitter(&out);
+
+            ASSERT_EQ(p.read_graph(&in, g), 12);
+
+            // Second and last returns share the first one, not the third
+            EXPECT_EQ(emitter.emit(g), 8);
+            EXPECT_EQ(emitter.shared(), 2);
+            out.flush();
+
+            std::string const& dot = out.data();
+            EXPECT_EQ(dot.find("ReturnStmt_0x6"), std::string::npos);
+            EXPECT_EQ(dot.find("IntegerLiteral_0xb"), std::string::npos);
+            EXPECT_NE(dot.find("ReturnStmt_0x8"), std::string::npos);
+            EXPECT_NE(dot.find("| x3| }"), std::string::npos);
+            EXPECT_NE(dot.find("CompoundStmt_0x3 -> ReturnStmt_0x4 [style=\"dashed\""), std::string::npos);
+
+            // Single vertices are not shared
+            EXPECT_NE(dot.find("IntegerLiteral_0x9"), std::string::npos);
+        }
+
+        TEST_F(TestParser, XrefEdges)
+        {
+            const char dump[] =
+                "TranslationUnitDecl 0x1 <<invalid sloc>> <invalid sloc>\n"
+                "|-VarDecl 0x2 <a.c:1:1, col:5> col:5 b 'int'\n"
+                "|-CXXRecordDecl 0x3 <line:2:1, line:5:1> line:2:8 struct S definition\n"
+                "| |-CXXMethodDecl 0x4 <line:3:3, col:30> col:8 f 'int (void)'\n"
+                "| | `-CompoundStmt 0x5 <col:12, col:30>\n"
+                "| |   `-ReturnStmt 0x6 <col:14, col:28>\n"
+                "| |     `-BinaryOperator 0x7 <col:21, col:28> 'int' '+'\n"
+                "| |       |-MemberExpr 0x8 <col:21> 'int' lvalue ->x 0x9\n"
+                "| |       | `-CXXThisExpr 0xa <col:21> 'struct S *' this\n"
+                "| |       `-DeclRefExpr 0xb <col:28> 'int' lvalue Var 0x2 'b' 'int'\n"
+                "| `-FieldDecl 0x9 <line:4:3, col:7> col:7 referenced x 'int'\n"
+                "`-VarDecl 0xc <line:6:1, col:9> col:5 c 'int' cinit\n"
+                "  `-DeclRefExpr 0xd <col:9> 'int' lvalue Var 0xe 'd' 'int'\n";
+            Ast2DotMemoryInput in(dump, sizeof(dump) - 1);
+            Ast2DotParser p;
+            Ast2DotGraph g(p.symbols());
+            Ast2DotMemoryOutput out;
+            Ast2DotEmitter emitter(&out);
+            Ast2DotXref xref;
+
+            ASSERT_EQ(p.read_graph(&in, g), 13);
+
+            emitter.set_xref(&xref);
+            EXPECT_EQ(emitter.emit(g), 13);
+            out.flush();
+
+            // Backward reference at once, forward one when its declaration is emitted
+            std::string const& dot = out.data();
+            size_t back = dot.find("DeclRefExpr_0xb -> VarDecl_0x2 [style=\"dashed\",color=red,constraint=false]");
+            size_t forward = dot.find("MemberExpr_0x8 -> FieldDecl_0x9 [style=\"dashed\"");
+            ASSERT_NE(back, std::string::npos);
+            ASSERT_NE(forward, std::string::npos);
+            EXPECT_LT(dot.find("DeclRefExpr_0xb ["), back);
+            EXPECT_LT(dot.find("FieldDecl_0x9 ["), forward);
+            EXPECT_EQ(xref.edges(), 2);
+
+            // Declaration not in the dump
+            EXPECT_EQ(dot.find("DeclRefExpr_0xd -> "), std::string::npos);
+            EXPECT_EQ(xref.pending(), 1);
+            EXPECT_EQ(xref.finish(), 1);
+            EXPECT_EQ(xref.pending(), 0);
+
+            // Same edges with the dump emitted a top level declaration at a time
+            Ast2DotMemoryInput pin(dump, sizeof(dump) - 1);
+            Ast2DotParser pp;
+            Ast2DotGraph pg(pp.symbols());
+            Ast2DotMemoryOutput pout;
+            Ast2DotEmitter pemitter(&pout);
+            Ast2DotXref pxref;
+
+            pemitter.set_xref(&pxref);
+            for (int level = 0; level >= 0; )
+                {
+                    pg.clear();
+                    level = pp.read_part(&pin, pg, level);
+                    pemitter.emit(pg);
+                }
+            pout.flush();
+            EXPECT_EQ(pout.data(), dot);
+            EXPECT_EQ(pxref.edges(), 2);
+            EXPECT_EQ(pxref.finish(), 1);
+        }
+
+        TEST_F(TestParser, RedeclEdges)
+        {
+            const char dump[] =
+                "TranslationUnitDecl 0x1 <<invalid sloc>> <invalid sloc>\n"
+                "|-NamespaceDecl 0x2 <a.cc:1:1, col:15> col:11 ns\n"
+                "| `-CXXRecordDecl 0x3 <col:15, col:22> col:22 struct S\n"
+                "|-NamespaceDecl 0x4 prev 0x2 <line:2:1, line:4:1> line:2:11 ns\n"
+                "| `-CXXRecordDecl 0x5 prev 0x3 <line:3:1, col:20> col:8 struct S definition\n"
+                "|   `-CXXMethodDecl 0x6 <col:12, col:19> col:17 f 'void (void)'\n"
+                "`-CXXMethodDecl 0x7 parent 0x5 prev 0x6 <line:5:1, col:20> col:13 f 'void (void)'\n";
+            Ast2DotMemoryInput in(dump, sizeof(dump) - 1);
+            Ast2DotParser p;
+            Ast2DotGraph g(p.symbols());
+            Ast2DotMemoryOutput out;
+            Ast2DotEmitter emitter(&out);
+            Ast2DotXref xref;
+
+            ASSERT_EQ(p.read_graph(&in, g), 7);
+
+            xref.enable(Ast2DotXref::REFERENCE, false);
+            emitter.set_xref(&xref);
+            EXPECT_EQ(emitter.emit(g), 7);
+            out.flush();
+
+            std::string const& dot = out.data();
+            EXPECT_NE(dot.find("NamespaceDecl_0x4 -> NamespaceDecl_0x2 [style=\"dashed\",color=darkgreen,label=\"prev\""), std::string::npos);
+            EXPECT_NE(dot.find("CXXRecordDecl_0x5 -> CXXRecordDecl_0x3 [style=\"dashed\",color=darkgreen,label=\"prev\""), std::string::npos);
+            EXPECT_NE(dot.find("CXXMethodDecl_0x7 -> CXXRecordDecl_0x5 [style=\"dotted\",color=darkgreen,label=\"parent\""), std::string::npos);
+            EXPECT_NE(dot.find("CXXMethodDecl_0x7 -> CXXMethodDecl_0x6 [style=\"dashed\""), std::string::npos);
+            EXPECT_EQ(xref.edges(Ast2DotXref::PREV), 3);
+            EXPECT_EQ(xref.edges(Ast2DotXref::PARENT), 1);
+            EXPECT_EQ(xref.pending(), 0);
+        }
+
+        TEST_F(TestParser, AddressIndex)
+        {
+            Ast2DotAddressIndex index;
+
+            EXPECT_EQ(index.find(0x10), (std::string const*) NULL);
+            EXPECT_EQ(index.find(0), (std::string const*) NULL);
+
+            // Close aligned addresses, past a few growths
+            for (uint64_t a = 0; a < 10000; a++)
+                index.put(0x55d0a0000000ULL + a * 16, std::to_string(a));
+            EXPECT_EQ(index.size(), 10000);
+
+            for (uint64_t a = 0; a < 10000; a++)
+                {
+                    std::string const* id = index.find(0x55d0a0000000ULL + a * 16);
+                    ASSERT_NE(id, (std::string const*) NULL);
+                    EXPECT_EQ(*id, std::to_string(a));
+                }
+            EXPECT_EQ(index.find(0x55d0a0000008ULL), (std::string const*) NULL);
+
+            index.put(0x55d0a0000000ULL, "again");
+            EXPECT_EQ(*index.find(0x55d0a0000000ULL), "again");
+            EXPECT_EQ(index.size(), 10000);
+
+            index.clear();
+            EXPECT_EQ(index.find(0x55d0a0000000ULL), (std::string const*) NULL);
+        }
+
+        TEST_F(TestParser, GraphCache)
+        {
+            const char dump[] =
+                "TranslationUnitDecl 0x1 <<invalid sloc>> <invalid sloc>\n"
+                "|-TypedefDecl 0x2 <<invalid sloc>> <invalid sloc> implicit __int128_t '__int128'\n"
+                "| `-BuiltinType 0x3 '__int128'\n"
+                "|-FunctionDecl 0x4 <a.c:1:1, line:3:1> line:1:5 main 'int (void)'\n"
+                "| `-CompoundStmt 0x5 <col:16, line:3:1>\n"
+                "|   `-ReturnStmt 0x6 <line:2:3, col:10>\n"
+                "|     `-<<<NULL>>>\n"
+                "`-CXXRecordDecl 0x7 <line:4:1, col:30> col:8 struct S definition\n"
+                "  |-public 'struct B'\n"
+                "  `-original Namespace 0x8 'n'\n";
+            Ast2DotMemoryInput in(dump, sizeof(dump) - 1);
+            Ast2DotParser p;
+            Ast2DotGraph g(p.symbols());
+            Ast2DotMemoryOutput cache;
+            Ast2DotMemoryOutput expected;
+            Ast2DotMemoryOutput out;
+
+            ASSERT_EQ(p.read_graph(&in, g), 10);
+            Ast2DotEmitter(&expected).emit(g);
+            expected.flush();
+
+            Ast2DotCache::save(g, &cache);
+            cache.flush();
+
+            // Emitted from the cache as from the parsed graph
+            std::vector<uint64_t> aligned(cache.data().size() / 8 + 1);
+            memcpy(aligned.data(), cache.data().data(), cache.data().size());
+
+            Ast2DotSymbols symbols;
+            Ast2DotGraph loaded(symbols);
+
+            Ast2DotCache::load((const char*) aligned.data(), cache.data().size(), symbols, loaded);
+            ASSERT_EQ(loaded.size(), g.size());
+            EXPECT_EQ(symbols.size(), p.symbols().size());
+            EXPECT_EQ(Ast2DotEmitter(&out).emit(loaded), 10);
+            out.flush();
+            EXPECT_EQ(out.data(), expected.data());
+
+            // Not loaded twice in a table, nor truncated, nor of another version
+            Ast2DotGraph again(symbols);
+            EXPECT_THROW(Ast2DotCache::load((const char*) aligned.data(), cache.data().size(), symbols, again),
+                         Ast2DotCache::FormatException);
+
+            Ast2DotSymbols fresh;
+            EXPECT_THROW(Ast2DotCache::load((const char*) aligned.data(), cache.data().size() - 1, fresh, again),
+                         Ast2DotCache::FormatException);
+            ((Ast2DotCache::Header*) aligned.data())->version++;
+            EXPECT_THROW(Ast2DotCache::load((const char*) aligned.data(), cache.data().size(), fresh, again),
+                         Ast2DotCache::FormatException);
+            ((Ast2DotCache::Header*) aligned.data())->version--;
+
+            // Nodes checked as read: a kind not interned, props out of the pool or a cycle
+            Ast2DotCache::Header header;
+            memcpy(&header, aligned.data(), sizeof(header));
+            char* data = (char*) aligned.data();
+            Ast2DotSymbols::Id* kind = (Ast2DotSymbols::Id*) (data + header.offsets[Ast2DotCache::KIND]);
+            uint64_t* props = (uint64_t*) (data + header.offsets[Ast2DotCache::PROPS]);
+            Ast2DotGraph::Index* next_sibling = (Ast2DotGraph::Index*) (data + header.offsets[Ast2DotCache::NEXT_SIBLING]);
+
+            Ast2DotCache::load((const char*) aligned.data(), cache.data().size(), fresh, again);
+            kind[3] = symbols.size() + 1;
+            Ast2DotSymbols bad_kind;
+            Ast2DotCache::load((const char*) aligned.data(), cache.data().size(), bad_kind, again);
+            EXPECT_EQ(again.kind(2), g.kind(2));
+            EXPECT_THROW(again.kind(3), Ast2DotGraph::FormatException);
+            EXPECT_THROW(Ast2DotEmitter(&out).emit(again), Ast2DotGraph::FormatException);
+            kind[3] = g.kind(3);
+            props[9] = header.pool_size + 1;
+            Ast2DotSymbols bad_props;
+            Ast2DotCache::load((const char*) aligned.data(), cache.data().size(), bad_props, again);
+            EXPECT_THROW(Ast2DotEmitter(&out).emit(again), Ast2DotGraph::FormatException);
+            props[9] = g.columns().props[9];
+            next_sibling[3] = 1;
+            Ast2DotSymbols bad_edges;
+            Ast2DotCache::load((const char*) aligned.data(), cache.data().size(), bad_edges, again);
+            EXPECT_THROW(Ast2DotEmitter(&out).emit(again), Ast2DotGraph::FormatException);
+            EXPECT_THROW(again.parent(again.size()), Ast2DotGraph::FormatException);
+            next_sibling[3] = g.next_sibling(3);
+
+            // Empty lines and summaries have no kind
+            const char deep[] = "A 0x1\n|-B 0x2\n| `-C 0x3\n|   `-D 0x4\n`-\n";
+            Ast2DotMemoryInput din(deep, sizeof(deep) - 1);
+            Ast2DotParser dp;
+            Ast2DotGraph dg(dp.symbols());
+            Ast2DotMemoryOutput dcache;
+            Ast2DotMemoryOutput dexpected;
+            Ast2DotMemoryOutput dout;
+
+            dp.set_max_depth(1);
+            dp.read_graph(&din, dg);
+            Ast2DotEmitter(&dexpected).emit(dg);
+            dexpected.flush();
+            Ast2DotCache::save(dg, &dcache);
+            dcache.flush();
+
+            std::vector<uint64_t> daligned(dcache.data().size() / 8 + 1);
+            memcpy(daligned.data(), dcache.data().data(), dcache.data().size());
+            Ast2DotSymbols dsymbols;
+            Ast2DotGraph dloaded(dsymbols);
+
+            Ast2DotCache::load((const char*) daligned.data(), dcache.data().size(), dsymbols, dloaded);
+            EXPECT_EQ(Ast2DotEmitter(&dout).emit(dloaded), dg.size());
+            dout.flush();
+            EXPECT_EQ(dout.data(), dexpected.data());
+        }
+
+        /*
+         * Dump of top level functions, addresses from base
+         */
+        static std::string
+        incremental_dump(unsigned long base, int functions)
+        {
+            std::ostringstream dump;
+
+            dump << std::hex << "TranslationUnitDecl 0x" << base << " <<invalid sloc>> <invalid sloc>\n";
+            for (int n = 0; n < functions; n++)
+              {
+                const char* rel = n + 1 < functions ? "| " : "  ";
+                // Names without digits, for the cuts
+                std::string name(1, 'a' + n % 26);
+
+                name.push_back('a' + n / 26 % 26);
+
+                dump << (n + 1 < functions ? "|-" : "`-") << std::hex
+                     << "FunctionDecl 0x" << base + 0x40 * n + 0x10 << std::dec
+                     << " <a.c:" << n + 1 << ":1, col:20> col:5 f_" << name << " 'int (void)'\n"
+                     << rel << "`-CompoundStmt 0x" << std::hex << base + 0x40 * n + 0x20 << std::dec
+                     << " <col:16, col:20>\n"
+                     << rel << "  |-<<<NULL>>>\n"
+                     << rel << "  `-DeclRefExpr 0x" << std::hex << base + 0x40 * n + 0x30
+                     << " <col:17> 'int' lvalue Function 0x" << base + 0x10 << " 'f_aa' 'int (void)'\n";
+              }
+
+            return dump.str();
+        }
+
+        TEST_F(TestParser, Incremental)
+        {
+            std::string dump = incremental_dump(0x55d0c8a00000UL, 1000);
+            std::string shifted = incremental_dump(0x7f10c8a00000UL, 1000);
+            char dir[] = "/tmp/test_incremental.XXXXXX";
+            std::vector<size_t> starts;
+            std::vector<size_t> shifted_starts;
+
+            ASSERT_TRUE(::mkdtemp(dir) != NULL);
+
+            // Cuts do not depend on the addresses
+            ASSERT_GT(Ast2DotIncremental::split(dump.data(), dump.size(), starts), 1);
+            Ast2DotIncremental::split(shifted.data(), shifted.size(), shifted_starts);
+            EXPECT_EQ(starts, shifted_starts);
+
+            for (int run = 0; run < 3; run++)
+              {
+                std::string const& text = run < 2 ? dump : shifted;
+                Ast2DotMemoryInput in(text.data(), text.size());
+                Ast2DotParser p;
+                Ast2DotGraph g(p.symbols());
+                Ast2DotMemoryOutput expected;
+                Ast2DotMemoryOutput out;
+                Ast2DotIncremental chunks(dir);
+
+                ASSERT_EQ(p.read_graph(&in, g), 4001);
+                Ast2DotEmitter(&expected).emit(g);
+                expected.flush();
+
+                // Converted, then from the fragments, even with other addresses
+                EXPECT_EQ(chunks.convert(text.data(), text.size(), &out), 4001);
+                out.flush();
+                EXPECT_EQ(out.data(), expected.data());
+                EXPECT_EQ(chunks.chunks(), starts.size());
+                EXPECT_EQ(chunks.hits(), run == 0 ? 0 : starts.size());
+              }
+
+            EXPECT_EQ(std::system((std::string("rm -rf ") + dir).c_str()), 0);
+        }
+
+        TEST_F(TestParser, Batch)
+        {
+            const char dump[] =
+                "TranslationUnitDecl 0x1 <<invalid sloc>> <invalid sloc>\n"
+                "|-TypedefDecl 0x2 <<invalid sloc>> <invalid sloc> implicit __int128_t '__int128'\n"
+                "| `-BuiltinType 0x3 '__int128'\n"
+                "`-FunctionDecl 0x4 <a.c:1:1, line:3:1> line:1:5 main 'int (void)'\n"
+                "  `-CompoundStmt 0x5 <col:16, line:3:1>\n"
+                "    `-ReturnStmt 0x6 <line:2:3, col:10>\n"
+                "      `-<<<NULL>>>\n";
+            char dir[] = "/tmp/test_batch.XXXXXX";
+            std::vector<Ast2DotBatch::Item> items;
+            Ast2DotMemoryInput in(dump, sizeof(dump) - 1);
+            Ast2DotParser p;
+            Ast2DotGraph g(p.symbols());
+            Ast2DotMemoryOutput expected;
+
+            ASSERT_EQ(p.read_graph(&in, g), 7);
+            expected.write("digraph {\n");
+            Ast2DotEmitter(&expected).emit(g);
+            expected.write("}\n");
+            expected.flush();
+
+            ASSERT_TRUE(::mkdtemp(dir) != NULL);
+            for (int n = 0; n < 5; n++)
+              {
+                std::ofstream ofs(std::string(dir).append("/dump").append(std::to_string(n)).c_str());
+                ofs << dump;
+              }
+
+            // Dot files are not dumps
+            ASSERT_EQ(Ast2DotBatch::list(dir, "", items), 5);
+            EXPECT_EQ(items[0].output, std::string(dir).append("/dump0.dot"));
+
+            Ast2DotBatch batch(2);
+
+            EXPECT_EQ(batch.convert(items), 5);
+            EXPECT_EQ(batch.vertices(), 35);
+            EXPECT_EQ(batch.bytes_in(), 5 * (sizeof(dump) - 1));
+            for (size_t k = 0; k < items.size(); k++)
+              {
+                std::ifstream ifs(items[k].output.c_str());
+                std::stringstream dot;
+
+                dot << ifs.rdbuf();
+                EXPECT_EQ(dot.str(), expected.data());
+              }
+            EXPECT_EQ(Ast2DotBatch::list(dir, "", items), 5);
+
+            // Missing dumps fail alone
+            items.resize(1);
+            items[0].input.append(".missing");
+            EXPECT_EQ(batch.convert(items), 0);
+            EXPECT_EQ(batch.failed(), 1);
+            EXPECT_THROW(Ast2DotBatch::list(std::string(dir).append("/none"), "", items), Ast2DotBatch::ListException);
+
+            EXPECT_EQ(std::system((std::string("rm -rf ") + dir).c_str()), 0);
+        }
+
+        TEST_F(TestParser, Server)
+        {
+            const char dump[] =
+                "TranslationUnitDecl 0x1 <<invalid sloc>> <invalid sloc>\n"
+                "`-FunctionDecl 0x4 <a.c:1:1, line:3:1> line:1:5 main 'int (void)'\n"
+                "  `-CompoundStmt 0x5 <col:16, line:3:1>\n"
+                "    `-ReturnStmt 0x6 <line:2:3, col:10>\n"
+                "      `-<<<NULL>>>\n";
+            char dir[] = "/tmp/test_server.XXXXXX";
+            Ast2DotMemoryInput in(dump, sizeof(dump) - 1);
+            Ast2DotParser p;
+            Ast2DotGraph g(p.symbols());
+            Ast2DotMemoryOutput expected;
+            Ast2DotBatch settings(2);
+
+            ASSERT_EQ(settings.convert(&in, &expected, p, g), 5);
+            expected.flush();
+
+            ASSERT_TRUE(::mkdtemp(dir) != NULL);
+            std::string path = std::string(dir).append("/sock");
+            std::string input = std::string(dir).append("/dump");
+            std::string output = std::string(dir).append("/dot");
+            {
+                std::ofstream ofs(input.c_str());
+                ofs << dump;
+            }
+
+            Ast2DotServer server(path, settings);
+            std::thread serving(&Ast2DotServer::serve, &server);
+
+            // Not two servers on a socket
+            EXPECT_THROW(Ast2DotServer(path, settings), Ast2DotServer::SocketException);
+
+            // Requests served again with the warm workers
+            for (int n = 0; n < 3; n++)
+              {
+                int ifd = ::open(input.c_str(), O_RDONLY);
+                int ofd = ::open(output.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+                std::stringstream dot;
+
+                EXPECT_TRUE(Ast2DotServer::request(path, ifd, ofd));
+                ::close(ifd);
+                ::close(ofd);
+
+                std::ifstream ifs(output.c_str());
+                dot << ifs.rdbuf();
+                EXPECT_EQ(dot.str(), expected.data());
+              }
+
+            server.stop();
+            serving.join();
+            EXPECT_EQ(server.requests(), 3);
+            EXPECT_EQ(server.failed(), 0);
+
+            // Dumps over the max request size refused with an error line
+            {
+                std::string small_path = std::string(dir).append("/small");
+                Ast2DotServer small(small_path, settings, 16);
+                std::thread small_serving(&Ast2DotServer::serve, &small);
+                int ifd = ::open(input.c_str(), O_RDONLY);
+                int ofd = ::open(output.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+                std::stringstream dot;
+
+                EXPECT_FALSE(Ast2DotServer::request(small_path, ifd, ofd));
+                ::close(ifd);
+                ::close(ofd);
+
+                std::ifstream ifs(output.c_str());
+                dot << ifs.rdbuf();
+                EXPECT_EQ(dot.str(), "// Error: request over 16 bytes\n");
+
+                small.stop();
+                small_serving.join();
+                EXPECT_EQ(small.failed(), 1);
+            }
+
+            EXPECT_EQ(std::system((std::string("rm -rf ") + dir).c_str()), 0);
+        }
+
+#ifdef AST2DOT_WITH_ZLIB
+        /*
+         * Gzip member of a text
+         */
+        static std::string
+        gzip_member(std::string const& text)
+        {
+            std::string gz(compressBound(text.size()) + 64, '\0');
+            z_stream z;
+
+            memset(&z, 0, sizeof(z));
+            deflateInit2(&z, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+            z.next_in = (Bytef*) text.data();
+            z.avail_in = text.size();
+            z.next_out = (Bytef*) &gz[0];
+            z.avail_out = gz.size();
+            deflate(&z, Z_FINISH);
+            gz.resize(gz.size() - z.avail_out);
+            deflateEnd(&z);
+
+            return gz;
+        }
+
+        TEST_F(TestParser, Decompress)
+        {
+            // More than a few decompressed blocks
+            std::string dump = incremental_dump(0x55d0c8a00000UL, 20000);
+            // Two members
+            std::string gz = gzip_member(dump.substr(0, dump.size() / 3)) + gzip_member(dump.substr(dump.size() / 3));
+            Ast2DotMemoryInput in(dump.data(), dump.size());
+            Ast2DotParser p;
+            Ast2DotGraph g(p.symbols());
+            Ast2DotMemoryOutput expected;
+
+            ASSERT_GT(dump.size(), 2 * AST2DOT_DECOMPRESS_BLOCK_SIZE);
+            ASSERT_EQ(p.read_graph(&in, g), 80001);
+            Ast2DotEmitter(&expected).emit(g);
+            expected.flush();
+
+            EXPECT_EQ(Ast2DotDecompressInput::detect(gz.data(), gz.size()), Ast2DotDecompressInput::GZIP);
+            EXPECT_EQ(Ast2DotDecompressInput::detect(dump.data(), dump.size()), Ast2DotDecompressInput::NONE);
+            EXPECT_EQ(Ast2DotDecompressInput::detect("\x28\xb5\x2f\xfd", 4), Ast2DotDecompressInput::ZSTD);
+
+            // Plain dump streams, even starting with the first byte of a
+            // magic, read whole after the magic bytes
+            const char* plains[] = { "(A 0x1\n", "\x28\xb5\n", "", "(" };
+            for (size_t k = 0; k < sizeof(plains) / sizeof(plains[0]); k++)
+              {
+                std::istringstream is(plains[k]);
+                std::string magic;
+
+                EXPECT_EQ(Ast2DotDecompressInput::detect(&is, magic), Ast2DotDecompressInput::NONE) << k;
+                Ast2DotStreamInput sin(&is, magic);
+                std::string read;
+                for (int c = sin.get(); c != EOF; c = sin.get())
+                  read.push_back((char) c);
+                EXPECT_EQ(read, plains[k]) << k;
+              }
+
+            // From memory, then from a stream (magic read first)
+            for (int run = 0; run < 2; run++)
+              {
+                std::istringstream is(gz);
+                std::string magic;
+                Ast2DotDecompressInput::Format format = run ? Ast2DotDecompressInput::detect(&is, magic)
+                                                            : Ast2DotDecompressInput::GZIP;
+                Ast2DotDecompressInput zin(gz.data(), gz.size(), format);
+                Ast2DotDecompressInput zis(&is, format, magic);
+                Ast2DotParser zp;
+                Ast2DotGraph zg(zp.symbols());
+                Ast2DotMemoryOutput out;
+
+                ASSERT_EQ(format, Ast2DotDecompressInput::GZIP);
+                ASSERT_EQ(zp.read_graph(run ? (Ast2DotInput*) &zis : (Ast2DotInput*) &zin, zg), 80001);
+                Ast2DotEmitter(&out).emit(zg);
+                out.flush();
+                EXPECT_EQ(out.data(), expected.data());
+                EXPECT_EQ((run ? zis : zin).compressed(), gz.size());
+              }
+
+            // Truncated and corrupted dumps
+            {
+                Ast2DotDecompressInput zin(gz.data(), gz.size() - 16, Ast2DotDecompressInput::GZIP);
+                Ast2DotParser zp;
+                Ast2DotGraph zg(zp.symbols());
+
+                EXPECT_THROW(zp.read_graph(&zin, zg), Ast2DotDecompressInput::DecompressException);
+            }
+            {
+                std::string bad(gz);
+
+                // Checksum of the last member
+                bad[bad.size() - 8] ^= 0x55;
+
+                Ast2DotDecompressInput zin(bad.data(), bad.size(), Ast2DotDecompressInput::GZIP);
+                Ast2DotParser zp;
+                Ast2DotGraph zg(zp.symbols());
+
+                EXPECT_THROW(zp.read_graph(&zin, zg), Ast2DotDecompressInput::DecompressException);
+            }
+
+            // Stopped before the end of the dump
+            Ast2DotDecompressInput stopped(gz.data(), gz.size(), Ast2DotDecompressInput::GZIP);
+        }
+
+        TEST_F(TestParser, CompressOutput)
+        {
+            std::string dump = incremental_dump(0x55d0c8a00000UL, 5000);
+            Ast2DotMemoryInput in(dump.data(), dump.size());
+            Ast2DotParser p;
+            Ast2DotGraph g(p.symbols());
+            Ast2DotMemoryOutput expected;
+            char path[] = "/tmp/test_compress.XXXXXX";
+            int fd = ::mkstemp(path);
+
+            ASSERT_GE(fd, 0);
+            ASSERT_EQ(p.read_graph(&in, g), 20001);
+            Ast2DotEmitter(&expected).emit(g);
+            expected.flush();
+
+            EXPECT_EQ(Ast2DotCompressOutput::detect("a.dot.gz"), Ast2DotDecompressInput::GZIP);
+            EXPECT_EQ(Ast2DotCompressOutput::detect("a.dot.zst"), Ast2DotDecompressInput::ZSTD);
+            EXPECT_EQ(Ast2DotCompressOutput::detect("a.dot"), Ast2DotDecompressInput::NONE);
+
+            // Small buffer: many blocks ahead of the compression thread
+            {
+                Ast2DotCompressOutput out(fd, Ast2DotDecompressInput::GZIP, 4096);
+                std::ifstream ifs(path);
+                std::stringstream file;
+                std::string gz;
+                std::string dot;
+                int c;
+
+                Ast2DotEmitter(&out).emit(g);
+                out.finish();
+                EXPECT_EQ(out.bytes(), expected.data().size());
+                out.write("x", 1);
+                EXPECT_THROW(out.flush(), Ast2DotOutput::WriteException);
+
+                file << ifs.rdbuf();
+                gz = file.str();
+                EXPECT_EQ(out.compressed(), gz.size());
+                EXPECT_LT(gz.size(), expected.data().size() / 4);
+
+                Ast2DotDecompressInput zin(gz.data(), gz.size(), Ast2DotDecompressInput::GZIP);
+
+                while ((c = zin.get()) != EOF)
+                  dot.push_back(c);
+                EXPECT_EQ(dot, expected.data());
+            }
+
+            // Write errors surface on the next blocks, or when finished
+            {
+                Ast2DotCompressOutput out(-1, Ast2DotDecompressInput::GZIP, 4096);
+
+                EXPECT_THROW({
+                    Ast2DotEmitter(&out).emit(g);
+                    out.finish();
+                  }, Ast2DotOutput::WriteException);
+            }
+
+            // Reported if not finished before destruction
+            testing::internal::CaptureStderr();
+            {
+                Ast2DotCompressOutput out(-1, Ast2DotDecompressInput::GZIP, 4096);
+
+                out.write("x", 1);
+            }
+            EXPECT_NE(testing::internal::GetCapturedStderr().find("compressed output not finished"), std::string::npos);
+
+            ::close(fd);
+            ::unlink(path);
+        }
+#endif
+
+        TEST_F(TestParser, Stats)
+        {
+            const char dump[] =
+                "TranslationUnitDecl 0x1 <<invalid sloc>> <invalid sloc>\n"
+                "|-CXXRecordDecl 0x2 <a.cc:1:1, col:20> col:8 struct B definition\n"
+                "| `-public 'struct A'\n"
+                "`-FunctionDecl 0x4 <a.cc:2:1, line:4:1> line:2:5 main 'int (void)'\n"
+                "  `-CompoundStmt 0x5 <col:16, line:4:1>\n"
+                "    `-ReturnStmt 0x6 <line:3:3, col:10>\n"
+                "      `-<<<NULL>>>\n";
+            unsigned long long before[Ast2DotStats::COUNTERS];
+            unsigned long long written;
+            int fd = ::open("/dev/null", O_WRONLY);
+
+            ASSERT_GE(fd, 0);
+            Ast2DotStats::enable();
+            Ast2DotStats::merge();
+            for (int c = 0; c < Ast2DotStats::COUNTERS; c++)
+              before[c] = Ast2DotStats::total((Ast2DotStats::Counter) c);
+
+            {
+                Ast2DotMemoryInput in(dump, sizeof(dump) - 1);
+                Ast2DotParser p;
+                Ast2DotGraph g(p.symbols());
+                Ast2DotOutput out(fd);
+
+                EXPECT_EQ(p.read_graph(&in, g), 7);
+                Ast2DotEmitter(&out).emit(g);
+                out.flush();
+                written = out.bytes();
+            }
+
+            // Counted by this thread until merged
+            Ast2DotStats::merge();
+            EXPECT_EQ(Ast2DotStats::total(Ast2DotStats::LINES) - before[Ast2DotStats::LINES], 7);
+            EXPECT_EQ(Ast2DotStats::total(Ast2DotStats::NODES) - before[Ast2DotStats::NODES], 7);
+            EXPECT_EQ(Ast2DotStats::total(Ast2DotStats::NULL_NODES) - before[Ast2DotStats::NULL_NODES], 1);
+            EXPECT_EQ(Ast2DotStats::total(Ast2DotStats::PUBLIC_NODES) - before[Ast2DotStats::PUBLIC_NODES], 1);
+            EXPECT_EQ(Ast2DotStats::total(Ast2DotStats::BYTES_IN) - before[Ast2DotStats::BYTES_IN], sizeof(dump) - 1);
+            EXPECT_EQ(Ast2DotStats::total(Ast2DotStats::BYTES_OUT) - before[Ast2DotStats::BYTES_OUT], written);
+            EXPECT_EQ(Ast2DotStats::total(Ast2DotStats::EXCEPTIONS) - before[Ast2DotStats::EXCEPTIONS], 1);
+            EXPECT_GE(Ast2DotStats::max_depth(), 4);
+            EXPECT_GT(Ast2DotStats::seconds(Ast2DotStats::OUTPUT), 0.0);
+
+            std::ostringstream json;
+
+            Ast2DotStats::report(json, true);
+            EXPECT_EQ(json.str().find("{\"seconds\":"), 0);
+            EXPECT_NE(json.str().find("\"tokenize\":"), std::string::npos);
+            EXPECT_NE(json.str().find("\"null_nodes\":"), std::string::npos);
+            EXPECT_EQ(json.str().substr(json.str().size() - 3), "}}\n");
+
+            ::close(fd);
+        }
     }
 }
 